@@ -1,4 +1,5 @@
 #include <Arduino.h>
+#include <EEPROM.h>
 
 static const uint8_t kRowPins[] = {2, 3, 4, 5, 6, 7, 8};
 static const size_t kRowCount = sizeof(kRowPins) / sizeof(kRowPins[0]);
@@ -59,28 +60,133 @@ static const KeyDefinition kKeyMap[] = {
 
 static const size_t kKeyCount = sizeof(kKeyMap) / sizeof(kKeyMap[0]);
 
+// Reported by 'version'.
+static const char kFirmwareVersion[] = "1.2.0";
+
 // Serial command settings.
 static constexpr unsigned long kDefaultBaudRate = 115200;
 static constexpr unsigned long kDefaultPulseMs = 150;
 static constexpr unsigned long kSerialTimeoutMs = 25;  // For command parsing
 
+// Reserved single-byte emergency stop (ASCII ETX / Ctrl-C). It is acted on as
+// soon as it is read, even in the middle of a command line, and never reaches
+// the line parser.
+static constexpr char kEmergencyStopOpcode = 0x03;
+
+// If the microwave has not strobed the held key's row for this long, its
+// controller is not scanning the keypad and the press cannot register.
+static constexpr unsigned long kScanLostMs = 50;
+
 // Holds the currently active key press state.
 struct ActivePress {
   int16_t keyIndex = -1;               // Index into kKeyMap, -1 if idle
   unsigned long releaseDeadline = 0;   // 0 = hold until explicit release
+  bool quiet = false;                  // true = no "OK" when the press ends
+  unsigned long pressedMs = 0;
+  unsigned long lastStrobeMs = 0;      // last time the row was seen low
+  uint16_t strobes = 0;                // row strobes seen while pressed
+  bool rowLow = false;
+  bool announced = false;              // "down" event sent
+  bool scanLostReported = false;
+};
+
+// Board serial number, kept in EEPROM so the host can recognise the board
+// across ports and reboots: two marker bytes, then the number (little endian).
+// A blank EEPROM gets a random number on first boot.
+static constexpr int kSerialNumberAddress = 0;
+static constexpr uint8_t kSerialNumberMarker[2] = {'M', 'W'};
+static unsigned long g_serialNumber = 0;
+
+// Longest command line accepted; reported by 'caps'.
+static constexpr unsigned int kMaxCommandLength = 80;
+
+// Binary status frames streamed by 'telemetry <hz>':
+//   0x02, <payload length>, payload, <xor of length and payload bytes>
+// Text lines never start with 0x02, so the host can tell the two apart; a
+// frame is only ever written between lines.
+static constexpr uint8_t kTelemetryStart = 0x02;
+static constexpr uint8_t kTelemetryVersion = 1;
+static constexpr uint8_t kTelemetryPayloadLength = 15;
+static constexpr unsigned long kMaxTelemetryHz = 50;
+
+static constexpr uint8_t kTelemetryHeldUntilRelease = 0x01;
+static constexpr uint8_t kTelemetrySequenceRunning = 0x02;
+static constexpr uint8_t kTelemetryScanLost = 0x04;
+
+struct TelemetryState {
+  unsigned long periodMs = 0;          // 0 = off
+  unsigned long nextFrameMs = 0;
+  unsigned long loopCount = 0;         // loop passes since the last frame
+  unsigned long maxLoopUs = 0;         // slowest pass since the last frame
+};
+
+// Key-up event waiting for the end of the loop pass (see flushKeyEvents).
+struct PendingKeyUp {
+  int16_t keyIndex = -1;
+  unsigned long releasedMs = 0;
+  uint16_t strobes = 0;
+};
+
+// A 'scan' command: counts the strobes on every row for a while without
+// driving any key, so the host can tell how fast the oven scans its keypad.
+static constexpr unsigned long kDefaultScanMs = 200;
+static constexpr unsigned long kMaxScanMs = 2000;
+
+struct ScanWindow {
+  bool active = false;
+  unsigned long startedMs = 0;
+  unsigned long endMs = 0;
+  uint16_t strobes[kRowCount];
+  bool rowLow[kRowCount];
+};
+
+// A 'seq' command: several timed presses run back to back from one line, so
+// the host needs one exchange for a whole key sequence.
+static constexpr uint8_t kMaxSequenceSteps = 16;
+static constexpr unsigned long kDefaultGapMs = 150;
+
+struct SequenceStep {
+  int16_t keyIndex;
+  unsigned long holdMs;
+  unsigned long gapMs;                 // idle time after the release
+};
+
+struct ActiveSequence {
+  SequenceStep steps[kMaxSequenceSteps];
+  unsigned long startOffsetMs[kMaxSequenceSteps];
+  uint8_t count = 0;                   // 0 = no sequence running
+  uint8_t next = 0;                    // next step to start
+  unsigned long startedMs = 0;
+  unsigned long nextStartMs = 0;
 };
 
 static ActivePress g_activePress;
+static PendingKeyUp g_pendingKeyUp;
+static ActiveSequence g_sequence;
+static TelemetryState g_telemetry;
+static ScanWindow g_scan;
 static String g_commandBuffer;
+static int16_t g_stopKeyIndex = -1;
 
 // Forward declarations
 void processCommand(const String &line);
 void printHelp();
 void listKeys();
+void printCaps();
+void loadSerialNumber();
 int16_t findKeyIndex(const String &command);
-void startKeyPress(int16_t keyIndex, unsigned long holdMs);
+void startKeyPress(int16_t keyIndex, unsigned long holdMs, bool quiet = false);
+void emergencyStop(unsigned long receivedUs);
+void startSequence(const String &args);
+void maintainSequence();
+void cancelSequence();
 void maintainActivePress();
 void releaseActivePress();
+void beginEvent(unsigned long atMs, const __FlashStringHelper *name);
+void flushKeyEvents();
+void maintainTelemetry();
+void startScan(unsigned long durationMs);
+void maintainScan();
 void setColumnIdle(uint8_t columnIndex);
 void setAllIdle();
 
@@ -95,6 +201,8 @@ void setup() {
   // Put every pin into a known high-impedance state to match the passive
   // behaviour of the original keypad.
   setAllIdle();
+  g_stopKeyIndex = findKeyIndex(String(F("stop")));
+  loadSerialNumber();
 
   Serial.println(F("MD1001LB microwave keypad controller"));
   Serial.println(F("Type 'help' for a list of commands."));
@@ -102,9 +210,15 @@ void setup() {
 }
 
 void loop() {
+  unsigned long passStartUs = micros();
+
   // Serial command parsing (simple line based parser)
   while (Serial.available() > 0) {
     char c = static_cast<char>(Serial.read());
+    if (c == kEmergencyStopOpcode) {
+      emergencyStop(micros());
+      continue;
+    }
     if (c == '\r') {
       continue;  // ignore carriage return
     }
@@ -116,15 +230,28 @@ void loop() {
     } else {
       g_commandBuffer += c;
       // Prevent runaway buffers if a host forgets to send a newline.
-      if (g_commandBuffer.length() > 80) {
+      if (g_commandBuffer.length() > kMaxCommandLength) {
         g_commandBuffer = String();
-        Serial.println(F("ERR: command too long"));
+        beginEvent(millis(), F("error"));
+        Serial.println(F(" command too long"));
       }
     }
   }
 
   // Maintain any active key presses.
   maintainActivePress();
+  maintainSequence();
+  maintainScan();
+  flushKeyEvents();
+
+  if (g_telemetry.periodMs != 0) {
+    unsigned long passUs = micros() - passStartUs;
+    if (passUs > g_telemetry.maxLoopUs) {
+      g_telemetry.maxLoopUs = passUs;
+    }
+    ++g_telemetry.loopCount;
+    maintainTelemetry();
+  }
 }
 
 void processCommand(const String &line) {
@@ -134,6 +261,13 @@ void processCommand(const String &line) {
     return;
   }
 
+  // 'seq' takes any number of steps, so it bypasses the tokeniser.
+  if (trimmed.length() >= 3 && trimmed.substring(0, 3).equalsIgnoreCase(String(F("seq"))) &&
+      (trimmed.length() == 3 || trimmed[3] == ' ')) {
+    startSequence(trimmed.substring(3));
+    return;
+  }
+
   // Tokenise (supports at most three arguments)
   String tokens[4];
   uint8_t count = 0;
@@ -159,10 +293,18 @@ void processCommand(const String &line) {
   }
 
   const String &cmd = tokens[0];
+  if (cmd == F("press") || cmd == F("pulse") || cmd == F("hold") || cmd == F("release")) {
+    cancelSequence();  // a manual key command takes over the keypad
+  }
   if (cmd == F("help")) {
     printHelp();
   } else if (cmd == F("list")) {
     listKeys();
+  } else if (cmd == F("version")) {
+    Serial.print(F("Version: "));
+    Serial.println(kFirmwareVersion);
+  } else if (cmd == F("caps")) {
+    printCaps();
   } else if (cmd == F("press") || cmd == F("pulse")) {
     if (count < 2) {
       Serial.println(F("ERR: press <key> [duration_ms]"));
@@ -199,8 +341,36 @@ void processCommand(const String &line) {
       releaseActivePress();
       Serial.println(F("OK"));
     }
+  } else if (cmd == F("telemetry")) {
+    unsigned long hz = (count >= 2) ? tokens[1].toInt() : 0;
+    if (hz > kMaxTelemetryHz) {
+      Serial.println(F("ERR: telemetry <0-50 hz>"));
+      return;
+    }
+    g_telemetry.periodMs = (hz == 0) ? 0 : 1000 / hz;
+    g_telemetry.nextFrameMs = millis();
+    g_telemetry.loopCount = 0;
+    g_telemetry.maxLoopUs = 0;
+    Serial.print(F("OK: telemetry "));
+    Serial.println(hz);
+  } else if (cmd == F("scan")) {
+    unsigned long ms = (count >= 2) ? tokens[1].toInt() : kDefaultScanMs;
+    if (ms == 0 || ms > kMaxScanMs) {
+      Serial.println(F("ERR: scan <1-2000 ms>"));
+      return;
+    }
+    if (g_scan.active) {
+      Serial.println(F("ERR: scan running"));
+      return;
+    }
+    startScan(ms);
   } else if (cmd == F("status")) {
-    if (g_activePress.keyIndex < 0) {
+    if (g_sequence.count > 0) {
+      Serial.print(F("Status: sequence step "));
+      Serial.print(g_sequence.next);
+      Serial.print(F(" of "));
+      Serial.println(g_sequence.count);
+    } else if (g_activePress.keyIndex < 0) {
       Serial.println(F("Status: idle"));
     } else {
       Serial.print(F("Status: holding "));
@@ -224,16 +394,25 @@ void printHelp() {
   Serial.println(F("Available commands:"));
   Serial.println(F("  help                Show this help text"));
   Serial.println(F("  list                List all valid key names"));
+  Serial.println(F("  version             Print the firmware version"));
+  Serial.println(F("  caps                Print version, limits and protocol features"));
   Serial.println(F("  press <key> [ms]    Tap the key for N milliseconds"));
   Serial.println(F("  pulse <key> [ms]    Alias of 'press'"));
   Serial.println(F("  hold <key>          Hold the key until 'release'"));
   Serial.println(F("  release             Release the currently held key"));
   Serial.println(F("  status              Print the active key state"));
+  Serial.println(F("  seq <i>[:ms[:gap]]... Press keys by list index, one after another"));
+  Serial.println(F("  telemetry <hz>      Stream binary status frames (0 = off, max 50)"));
+  Serial.println(F("  scan [ms]           Count row strobes per key without pressing (default 200)"));
+  Serial.println(F("  <0x03>              Emergency stop (single byte, no newline)"));
+  Serial.println();
+  Serial.println(F("Unsolicited lines: EVT <ms> down|scan_lost <i>, up <i> <strobes>, seq_done, error <text>"));
   Serial.println();
   Serial.println(F("Examples:"));
   Serial.println(F("  press start"));
   Serial.println(F("  press 1 100"));
   Serial.println(F("  hold cook_time"));
+  Serial.println(F("  seq 0 21 13:150:0"));
 }
 
 void listKeys() {
@@ -245,6 +424,57 @@ void listKeys() {
     Serial.print(kKeyMap[i].label);
     Serial.println(F(")"));
   }
+  // Terminator, so a host knows the list is complete
+  Serial.print(F("OK: "));
+  Serial.print(static_cast<unsigned long>(kKeyCount));
+  Serial.println(F(" keys"));
+}
+
+// One line the host can parse to pick protocol features: "Caps: " followed
+// by space-separated key=value pairs. Unknown keys are to be ignored, so new
+// ones can be added freely.
+void printCaps() {
+  Serial.print(F("Caps: version="));
+  Serial.print(kFirmwareVersion);
+  Serial.print(F(" id="));
+  Serial.print(g_serialNumber);
+  Serial.print(F(" line="));
+  Serial.print(kMaxCommandLength);
+  Serial.print(F(" seq="));
+  Serial.print(static_cast<unsigned long>(kMaxSequenceSteps));
+  Serial.print(F(" telemetry="));
+  Serial.print(kMaxTelemetryHz);
+  Serial.print(F(" keys="));
+  Serial.print(static_cast<unsigned long>(kKeyCount));
+  Serial.print(F(" baud="));
+  Serial.print(kDefaultBaudRate);
+  Serial.println(F(" features=seq,telemetry,events,estop,list_end,scan"));
+}
+
+void loadSerialNumber() {
+  if (EEPROM.read(kSerialNumberAddress) == kSerialNumberMarker[0] &&
+      EEPROM.read(kSerialNumberAddress + 1) == kSerialNumberMarker[1]) {
+    for (uint8_t i = 0; i < 4; ++i) {
+      g_serialNumber |= static_cast<unsigned long>(EEPROM.read(kSerialNumberAddress + 2 + i)) << (8 * i);
+    }
+    return;
+  }
+
+  // The low bits of a floating analog input plus the boot time are noisy
+  // enough to tell a handful of boards apart.
+  unsigned long seed = micros();
+  for (uint8_t i = 0; i < 32; ++i) {
+    seed = seed * 31 + static_cast<unsigned long>(analogRead(A0));
+  }
+  g_serialNumber = (seed ^ (seed >> 16)) & 0x7FFFFFFFUL;
+  if (g_serialNumber == 0) {
+    g_serialNumber = 1;
+  }
+  for (uint8_t i = 0; i < 4; ++i) {
+    EEPROM.update(kSerialNumberAddress + 2 + i, static_cast<uint8_t>(g_serialNumber >> (8 * i)));
+  }
+  EEPROM.update(kSerialNumberAddress, kSerialNumberMarker[0]);
+  EEPROM.update(kSerialNumberAddress + 1, kSerialNumberMarker[1]);
 }
 
 int16_t findKeyIndex(const String &command) {
@@ -256,7 +486,7 @@ int16_t findKeyIndex(const String &command) {
   return -1;
 }
 
-void startKeyPress(int16_t keyIndex, unsigned long holdMs) {
+void startKeyPress(int16_t keyIndex, unsigned long holdMs, bool quiet) {
   if (keyIndex < 0 || keyIndex >= static_cast<int16_t>(kKeyCount)) {
     Serial.println(F("ERR: invalid key index"));
     return;
@@ -264,8 +494,14 @@ void startKeyPress(int16_t keyIndex, unsigned long holdMs) {
 
   releaseActivePress();
 
+  unsigned long now = millis();
   g_activePress.keyIndex = keyIndex;
-  g_activePress.releaseDeadline = (holdMs == 0) ? 0 : millis() + holdMs;
+  g_activePress.releaseDeadline = (holdMs == 0) ? 0 : now + holdMs;
+  g_activePress.quiet = quiet;
+  g_activePress.pressedMs = now;
+  g_activePress.lastStrobeMs = now;
+  g_activePress.announced = false;
+  g_activePress.scanLostReported = false;
 
   uint8_t rowIndex = kKeyMap[keyIndex].row;
   uint8_t columnIndex = kKeyMap[keyIndex].column;
@@ -286,9 +522,175 @@ void startKeyPress(int16_t keyIndex, unsigned long holdMs) {
   // Immediate sync so the first scan already sees the key.
   int state = digitalRead(kRowPins[rowIndex]);
   digitalWrite(kColumnPins[columnIndex], state);
+  g_activePress.rowLow = (state == LOW);
+  g_activePress.strobes = g_activePress.rowLow ? 1 : 0;
+
+  if (!quiet) {
+    Serial.print(F("OK: pressing "));
+    Serial.println(kKeyMap[keyIndex].label);
+  }
+}
+
+// Fast lane for the host's stop opcode: abandon whatever is in progress
+// (including a half-received command line) and press Stop right away. The
+// press is quiet so its release does not produce a stray "OK"; instead the
+// time from reading the opcode to driving the Stop column is reported as
+// "ESTOP <microseconds>".
+void emergencyStop(unsigned long receivedUs) {
+  g_commandBuffer = String();
+  cancelSequence();
+  g_scan.active = false;
+  releaseActivePress();
+  if (g_stopKeyIndex < 0) {
+    Serial.println(F("ERR: stop key missing"));
+    return;
+  }
+  startKeyPress(g_stopKeyIndex, kDefaultPulseMs, true);
+  unsigned long latencyUs = micros() - receivedUs;
+  Serial.print(F("ESTOP "));
+  Serial.println(latencyUs);
+}
+
+// Parses "<key>[:<hold_ms>[:<gap_ms>]] ..." where <key> is the key's index in
+// 'list' order. An empty or zero hold means the default pulse; an empty gap
+// means the default gap. Every step is checked before any key is pressed.
+// Replies "OK: seq <n>" now and "OK: seq done <t0> <t1> ..." (each step's
+// start in ms after the first) once the last gap has elapsed.
+void startSequence(const String &args) {
+  cancelSequence();
+  releaseActivePress();
+
+  uint8_t count = 0;
+  int pos = 0;
+  int length = args.length();
+  while (pos < length) {
+    while (pos < length && args[pos] == ' ') {
+      ++pos;
+    }
+    if (pos >= length) {
+      break;
+    }
+    int end = args.indexOf(' ', pos);
+    if (end < 0) {
+      end = length;
+    }
+    if (count >= kMaxSequenceSteps) {
+      Serial.println(F("ERR: too many steps"));
+      return;
+    }
+
+    String fields[3];
+    uint8_t fieldCount = 0;
+    int fieldStart = pos;
+    while (fieldCount < 3) {
+      int colon = args.indexOf(':', fieldStart);
+      if (colon < 0 || colon >= end) {
+        fields[fieldCount++] = args.substring(fieldStart, end);
+        break;
+      }
+      fields[fieldCount++] = args.substring(fieldStart, colon);
+      fieldStart = colon + 1;
+    }
+
+    long keyIndex = fields[0].toInt();
+    if (fields[0].length() == 0 || (keyIndex == 0 && fields[0][0] != '0') ||
+        keyIndex < 0 || keyIndex >= static_cast<long>(kKeyCount)) {
+      Serial.println(F("ERR: bad step"));
+      return;
+    }
+    SequenceStep &step = g_sequence.steps[count++];
+    step.keyIndex = static_cast<int16_t>(keyIndex);
+    step.holdMs = (fieldCount > 1) ? fields[1].toInt() : 0;
+    if (step.holdMs == 0) {
+      step.holdMs = kDefaultPulseMs;
+    }
+    step.gapMs = (fieldCount > 2 && fields[2].length() > 0) ? fields[2].toInt() : kDefaultGapMs;
+    pos = end;
+  }
+
+  if (count == 0) {
+    Serial.println(F("ERR: seq <key>[:ms[:gap]] ..."));
+    return;
+  }
+  g_sequence.count = count;
+  g_sequence.next = 0;
+  g_sequence.startedMs = millis();
+  g_sequence.nextStartMs = g_sequence.startedMs;
+  Serial.print(F("OK: seq "));
+  Serial.println(count);
+}
+
+void maintainSequence() {
+  if (g_sequence.count == 0 || g_activePress.keyIndex >= 0) {
+    return;
+  }
+  unsigned long now = millis();
+  if (static_cast<long>(now - g_sequence.nextStartMs) < 0) {
+    return;
+  }
+  if (g_sequence.next < g_sequence.count) {
+    const SequenceStep &step = g_sequence.steps[g_sequence.next];
+    g_sequence.startOffsetMs[g_sequence.next] = now - g_sequence.startedMs;
+    startKeyPress(step.keyIndex, step.holdMs, true);
+    g_sequence.nextStartMs = now + step.holdMs + step.gapMs;
+    ++g_sequence.next;
+    return;
+  }
+
+  flushKeyEvents();  // the last step's key-up comes first
+  Serial.print(F("OK: seq done"));
+  for (uint8_t i = 0; i < g_sequence.count; ++i) {
+    Serial.print(' ');
+    Serial.print(g_sequence.startOffsetMs[i]);
+  }
+  Serial.println();
+  g_sequence.count = 0;
+  beginEvent(now, F("seq_done"));
+  Serial.println();
+}
+
+void startScan(unsigned long durationMs) {
+  unsigned long now = millis();
+  g_scan.active = true;
+  g_scan.startedMs = now;
+  g_scan.endMs = now + durationMs;
+  for (size_t i = 0; i < kRowCount; ++i) {
+    g_scan.rowLow[i] = (digitalRead(kRowPins[i]) == LOW);
+    g_scan.strobes[i] = 0;
+  }
+}
+
+// Reply: "Scan: <elapsed ms> <n0> <n1> ...", the strobes of each key's row
+// in 'list' order. Sampled once per loop pass, like a held key.
+void maintainScan() {
+  if (!g_scan.active) {
+    return;
+  }
+  for (size_t i = 0; i < kRowCount; ++i) {
+    bool low = (digitalRead(kRowPins[i]) == LOW);
+    if (low && !g_scan.rowLow[i] && g_scan.strobes[i] < 0xFFFF) {
+      ++g_scan.strobes[i];
+    }
+    g_scan.rowLow[i] = low;
+  }
+  unsigned long now = millis();
+  if (static_cast<long>(now - g_scan.endMs) < 0) {
+    return;
+  }
+  g_scan.active = false;
+  Serial.print(F("Scan: "));
+  Serial.print(now - g_scan.startedMs);
+  for (size_t i = 0; i < kKeyCount; ++i) {
+    Serial.print(' ');
+    uint8_t row = kKeyMap[i].row;
+    Serial.print(row < kRowCount ? g_scan.strobes[row] : 0);
+  }
+  Serial.println();
+}
 
-  Serial.print(F("OK: pressing "));
-  Serial.println(kKeyMap[keyIndex].label);
+void cancelSequence() {
+  g_sequence.count = 0;
+  g_sequence.next = 0;
 }
 
 void maintainActivePress() {
@@ -301,16 +703,35 @@ void maintainActivePress() {
 
   if (rowIndex >= kRowCount || columnIndex >= kColumnCount) {
     releaseActivePress();
-    Serial.println(F("ERR: active key mapping out of range"));
+    beginEvent(millis(), F("error"));
+    Serial.println(F(" active key mapping out of range"));
     return;
   }
 
   int state = digitalRead(kRowPins[rowIndex]);
   digitalWrite(kColumnPins[columnIndex], state);
 
+  unsigned long now = millis();
+  if (state == LOW) {
+    g_activePress.lastStrobeMs = now;
+    if (!g_activePress.rowLow && g_activePress.strobes < 0xFFFF) {
+      ++g_activePress.strobes;  // the oven saw the key once more
+    }
+  }
+  g_activePress.rowLow = (state == LOW);
+  if (state != LOW && !g_activePress.scanLostReported && now - g_activePress.lastStrobeMs > kScanLostMs) {
+    g_activePress.scanLostReported = true;
+    beginEvent(now, F("scan_lost"));
+    Serial.print(' ');
+    Serial.println(g_activePress.keyIndex);
+  }
+
   if (g_activePress.releaseDeadline != 0 && millis() >= g_activePress.releaseDeadline) {
+    bool quiet = g_activePress.quiet;
     releaseActivePress();
-    Serial.println(F("OK"));
+    if (!quiet) {
+      Serial.println(F("OK"));
+    }
   }
 }
 
@@ -322,8 +743,14 @@ void releaseActivePress() {
   uint8_t columnIndex = kKeyMap[g_activePress.keyIndex].column;
   setColumnIdle(columnIndex);
 
+  if (g_activePress.announced) {
+    g_pendingKeyUp.keyIndex = g_activePress.keyIndex;
+    g_pendingKeyUp.releasedMs = millis();
+    g_pendingKeyUp.strobes = g_activePress.strobes;
+  }
   g_activePress.keyIndex = -1;
   g_activePress.releaseDeadline = 0;
+  g_activePress.quiet = false;
 }
 
 void setColumnIdle(uint8_t columnIndex) {
@@ -342,3 +769,99 @@ void setAllIdle() {
     setColumnIdle(i);
   }
 }
+
+// Unsolicited events are lines of the form "EVT <millis> <name>[ <detail>]",
+// so the host can always tell them apart from command replies. The caller
+// finishes the line.
+void beginEvent(unsigned long atMs, const __FlashStringHelper *name) {
+  Serial.print(F("EVT "));
+  Serial.print(atMs);
+  Serial.print(' ');
+  Serial.print(name);
+}
+
+// Key up/down events are printed at the end of the loop pass rather than
+// where the key changes, so they never delay driving the keypad (in
+// particular the emergency stop path).
+void flushKeyEvents() {
+  if (g_pendingKeyUp.keyIndex >= 0) {
+    beginEvent(g_pendingKeyUp.releasedMs, F("up"));
+    Serial.print(' ');
+    Serial.print(g_pendingKeyUp.keyIndex);
+    Serial.print(' ');
+    Serial.println(g_pendingKeyUp.strobes);
+    g_pendingKeyUp.keyIndex = -1;
+  }
+  if (g_activePress.keyIndex >= 0 && !g_activePress.announced) {
+    g_activePress.announced = true;
+    beginEvent(g_activePress.pressedMs, F("down"));
+    Serial.print(' ');
+    Serial.println(g_activePress.keyIndex);
+  }
+}
+
+static void putU16(uint8_t *out, unsigned long value) {
+  if (value > 0xFFFF) {
+    value = 0xFFFF;
+  }
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+// Payload (little endian): version, millis (u32), active key (i8, -1 idle),
+// flags, hold remaining ms (u16, saturated), sequence step, sequence length,
+// loop passes (u16) and slowest pass in us (u16) since the previous frame.
+void maintainTelemetry() {
+  unsigned long now = millis();
+  if (static_cast<long>(now - g_telemetry.nextFrameMs) < 0) {
+    return;
+  }
+  g_telemetry.nextFrameMs += g_telemetry.periodMs;
+  if (static_cast<long>(now - g_telemetry.nextFrameMs) >= 0) {
+    g_telemetry.nextFrameMs = now + g_telemetry.periodMs;  // fell behind; don't burst
+  }
+
+  uint8_t frame[kTelemetryPayloadLength + 3];
+  uint8_t *payload = frame + 2;
+  frame[0] = kTelemetryStart;
+  frame[1] = kTelemetryPayloadLength;
+
+  uint8_t flags = 0;
+  unsigned long remaining = 0;
+  if (g_activePress.keyIndex >= 0) {
+    if (g_activePress.releaseDeadline == 0) {
+      flags |= kTelemetryHeldUntilRelease;
+    } else if (static_cast<long>(g_activePress.releaseDeadline - now) > 0) {
+      remaining = g_activePress.releaseDeadline - now;
+    }
+    if (g_activePress.scanLostReported) {
+      flags |= kTelemetryScanLost;
+    }
+  }
+  if (g_sequence.count > 0) {
+    flags |= kTelemetrySequenceRunning;
+  }
+
+  payload[0] = kTelemetryVersion;
+  payload[1] = static_cast<uint8_t>(now);
+  payload[2] = static_cast<uint8_t>(now >> 8);
+  payload[3] = static_cast<uint8_t>(now >> 16);
+  payload[4] = static_cast<uint8_t>(now >> 24);
+  payload[5] = static_cast<uint8_t>(static_cast<int8_t>(g_activePress.keyIndex));
+  payload[6] = flags;
+  putU16(payload + 7, remaining);
+  payload[9] = g_sequence.next;
+  payload[10] = g_sequence.count;
+  putU16(payload + 11, g_telemetry.loopCount);
+  putU16(payload + 13, g_telemetry.maxLoopUs);
+
+  uint8_t check = frame[1];
+  for (uint8_t i = 0; i < kTelemetryPayloadLength; ++i) {
+    check ^= payload[i];
+  }
+  frame[kTelemetryPayloadLength + 2] = check;
+  Serial.write(frame, sizeof(frame));
+
+  g_telemetry.loopCount = 0;
+  g_telemetry.maxLoopUs = 0;
+}
@@ -4,19 +4,58 @@
 // dll functions implementations
 
 #include "arduino_link.h"
+#include "handle_table.h"
+#include "mpsc_queue.h"
+#include "link_log.h"
+#include "seqlock.h"
+#include "singleflight.h"
+#include "key_map.h"
+#include "device_registry.h"
+#include "duty_cycle.h"
+#include "fault_link.h"
+#include "key_timing.h"
+#include "keystroke_planner.h"
+#include "oven_shadow.h"
+#include "recipe.h"
+#include "serial_trace.h"
+#include "timing_wheel.h"
+#include "virtual_clock.h"
 
-#include <iostream>
 #include <istream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <chrono>
 #include <sstream>
 #include <vector>
 #include <stdexcept>
 #include <functional>
+#include <condition_variable>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #define ASIO_STANDALONE
 #include "lib/asio/include/asio.hpp"
+#include "lib/asio/include/asio/experimental/awaitable_operators.hpp"
+#include "microwave_controller.h"
+
+// Every library timer runs on the clock the emulator shares, so virtual time
+// (set_microwave_virtual_time) moves them all together
+using LinkTimer = asio::basic_waitable_timer<LinkClock, LinkWaitTraits>;
 
 
 
@@ -29,360 +68,4007 @@
 #define API_ERROR_BAD_POWER -5
 #define API_ERROR_ARDUINO_ERR -6
 #define API_ERROR_UNKNOWN -7
+#define API_ERROR_ABORTED -8
+#define API_ERROR_BAD_COMMAND -9
+#define API_ERROR_TIMEOUT -10
 
-//internal Session object
-//this is what MicrowaveHandle will point to
-struct MicrowaveSession {
+// Reserved single-byte stop opcode understood by the firmware's RX path.
+static const char kEmergencyStopOpcode = 0x03;
+
+// How long stop_microwave waits for the firmware's "ESTOP" acknowledgement.
+static constexpr std::chrono::milliseconds kEmergencyStopAckTimeout(500);
+
+// Firmware default press length and gap after a 'seq' step. Also the times
+// used for a key until it is calibrated (see KeyTimings).
+static constexpr uint32_t kDefaultPressMs = KeyTimings::kDefaultPressMs;
+static constexpr uint32_t kSettleMs = KeyTimings::kDefaultGapMs;
+
+// How long 'scan' counts strobes by default, and at most.
+static constexpr uint32_t kDefaultScanWindowMs = 200;
+static constexpr uint32_t kMaxScanWindowMs = 2000;
+
+// After an emergency stop the firmware holds Stop for its default pulse; keep
+// queued commands back until that press and the usual settle delay are over.
+static constexpr std::chrono::milliseconds kEmergencyStopHold(kDefaultPressMs + kSettleMs);
+
+// Getting back in step after a reply timeout: how long the probe waits when
+// the command behind it has no timeout, and how often it is resent while the
+// board is still finishing a press or sequence.
+static constexpr uint32_t kSyncTimeoutMs = 1000;
+static constexpr std::chrono::milliseconds kSyncRetryDelay(50);
+
+// Keypad rules used to track the oven and plan runs.
+static constexpr ApplianceModel kOvenModel{};
+
+// Telemetry frame: kTelemetryStart, payload length, payload, xor check byte.
+static constexpr uint8_t kTelemetryStart = 0x02;
+static constexpr uint8_t kTelemetryVersion = 1;
+static constexpr size_t kTelemetryPayloadLength = 15;
+
+// Probes sent while opening; old firmware may not answer them at all.
+static constexpr uint32_t kProbeTimeoutMs = 500;
+
+// Reopening a board from the device registry: instead of sleeping through
+// the reset, 'caps' is resent every kWarmProbeIntervalMs until the sketch
+// answers, for at most kWarmStartTimeoutMs.
+static constexpr uint32_t kWarmProbeIntervalMs = 100;
+static constexpr uint32_t kWarmStartTimeoutMs = 2500;
+
+// After a port failure: how long commands wait for the board to come back by
+// default, and how often its node is retried when no hot-plug event arrives.
+static constexpr uint32_t kDefaultReconnectTimeoutMs = 10000;
+static constexpr std::chrono::milliseconds kReconnectPollInterval(250);
+
+// A new node that opens but does not answer 'caps' (still resetting, or busy
+// with something else) is tried again after kSilentNodeRetry, doubling up to
+// kSilentNodeRetryMax; a hot-plug event on it retries it at once.
+static constexpr std::chrono::milliseconds kSilentNodeRetry(1000);
+static constexpr std::chrono::milliseconds kSilentNodeRetryMax(8000);
+
+// Read-only queries whose concurrent callers share one exchange.
+static const char* const kCoalescedQueries[] = {"status", "list", "version"};
+static constexpr size_t kCoalescedQueryCount = sizeof(kCoalescedQueries) / sizeof(kCoalescedQueries[0]);
+
+// Longest reply kept for a coalesced query ('list' is about 1 KB).
+static constexpr size_t kMaxQueryReply = 2048;
+
+// Largest recipe file read, and the longest a recipe sleeps between checks
+// for stop_microwave.
+static constexpr size_t kMaxRecipeBytes = 64 * 1024;
+static constexpr std::chrono::milliseconds kRecipeStopPoll(50);
+
+// Most steps the firmware accepts in one 'seq' line.
+static constexpr size_t kMaxSequenceSteps = 16;
+
+// Resolution of cook completion tracking.
+static constexpr uint64_t kCookTickMs = 10;
+
+// Firmware key names, indexed by MICROWAVE_KEY_*.
+static const char* const kKeyNames[MICROWAVE_KEY_COUNT] = {
+    "cook_time", "6", "clock_timer", "auto_cook",
+    "start", "5", "defrost", "veggie",
+    "stop", "4", "test11", "rice",
+    "test13", "3", "power", "potato",
+    "9", "2", "test24", "frz-entree",
+    "8", "1", "test26", "frz-pizza",
+    "7", "0", "soften-melt", "reheat",
+};
+
+// --- Shared I/O runtime ---
+//
+// Every session's serial port is bound to one io_context serviced by a single
+// background thread, instead of each session owning a private io_context.
+// Built with MD1001LB_USE_IO_URING that io_context is backed by io_uring, so
+// reads and writes started by different sessions are submitted to the kernel
+// together rather than costing a syscall per port.
+//
+// The thread is started by the first open and joined by the last close; it is
+// never touched from static constructors/destructors so loading or unloading
+// the DLL stays trivial.
+struct LinkRuntime {
+    std::mutex mutex;
+    size_t users = 0;
     asio::io_context io;
-    asio::serial_port port;
+    std::unique_ptr<asio::executor_work_guard<asio::io_context::executor_type>> work;
+    std::thread thread;
+
+    // Expected cook completions of every session, in kCookTickMs ticks of
+    // the steady clock (runtime thread only). The timer is armed only while
+    // the wheel holds something, so the thread can still run out of work.
+    TimingWheel cooks;
+    std::unique_ptr<LinkTimer> cook_timer;
+    uint64_t cook_timer_tick = TimingWheel::kNever;
 
-    MicrowaveSession() : io(), port(io) {}
+    // In virtual time, tells the shared clock every kVirtualPoll whether
+    // the library is idle (runtime thread only). The one timer on the real
+    // clock: it has to run while virtual time stands still.
+    std::unique_ptr<asio::steady_timer> clock_pump;
+    bool pumping = false;
 };
 
-// --- Internal Helper Functions ---
+static LinkRuntime& link_runtime() {
+    // Intentionally leaked: a process that exits with handles still open must
+    // not destroy the io_context underneath a running thread.
+    static LinkRuntime* runtime = new LinkRuntime();
+    return *runtime;
+}
+
+static void start_clock_pump(LinkRuntime& rt);
+static void stop_clock_pump(LinkRuntime& rt);
+
+static asio::io_context& acquire_link_runtime() {
+    LinkRuntime& rt = link_runtime();
+    std::lock_guard<std::mutex> lock(rt.mutex);
+    if (rt.users++ == 0) {
+        link_log_start();
+        rt.io.restart();
+        rt.work.reset(new asio::executor_work_guard<asio::io_context::executor_type>(rt.io.get_executor()));
+        rt.thread = std::thread([&rt]() { rt.io.run(); });
+        start_clock_pump(rt);
+    }
+    return rt.io;
+}
+
+static void release_link_runtime() {
+    LinkRuntime& rt = link_runtime();
+    std::lock_guard<std::mutex> lock(rt.mutex);
+    if (rt.users == 0 || --rt.users != 0) {
+        return;
+    }
+    stop_clock_pump(rt);
+    rt.work.reset();
+    if (rt.thread.joinable()) {
+        rt.thread.join();
+    }
+    link_log_stop();
+}
+
+// Longest command line the firmware buffers (excluding the newline).
+static constexpr size_t kMaxCommandLength = 80;
 
 /**
- * @brief The core function to send any raw command string to the Arduino.
+ * @brief A command queued on (or being executed by) a session.
  *
- * This function blocks until the Arduino has fully acknowledged the
- * command (including waiting for the *second* "OK" on a 'press' command).
- *
- * @param session The active session pointer.
- * @param full_command The complete string to send (e.g., "press 1").
- * @return API_SUCCESS on success, error code on failure.
+ * Lives with the caller (on its stack, or in its coroutine frame) for the
+ * duration of the call, so queueing a command never allocates. The I/O
+ * strand fills in result and calls complete once the matching reply (plus
+ * the settle delay) is in.
  */
-static int32_t send_raw_command(MicrowaveSession* session, const std::string& full_command) {
-    if (!session || !session->port.is_open()) {
-        return API_ERROR_BAD_HANDLE;
-    }
+struct PendingCommand : MpscNode {
+    enum class Reply : uint8_t {
+        kFirst,         // first "OK..." or "Status:" line
+        kPressDone,     // press/pulse: "OK: pressing ..." then "OK"
+        kSequenceDone,  // seq: "OK: seq <n>" then "OK: seq done ..." (or "ERR: ...")
+        kScan,          // scan: "Scan: ..." once the window has passed
+        kSync           // the session's sync probe: only its own echo (see SyncCommand)
+    };
 
-    try {
-        // Send the command with a newline
-        asio::write(session->port, asio::buffer(full_command + "\n"));
+    char text[kMaxCommandLength + 1]; // command line including the trailing '\n'
+    size_t length = 0;
+    Reply reply = Reply::kFirst;
+    bool read_only = false;           // status/list/version/caps: does not change device state
+    uint32_t timeout_ms = 0;          // fail with API_ERROR_TIMEOUT if no reply by then (0 = wait)
+    uint32_t stop_epoch = 0;          // session stop count when queued
+    int32_t result = API_SUCCESS;
 
-        asio::streambuf response_buf;
-        std::string response_line;
+    // Optional: receives every line of the reply, '\n'-separated and
+    // NUL-terminated (truncated to fit)
+    char* reply_text = nullptr;
+    size_t reply_capacity = 0;
+    size_t reply_length = 0;
 
-        // Check if this is a command that sends two "OK" responses
-        bool is_press_or_pulse = (full_command.find("press") == 0 ||
-                                  full_command.find("pulse") == 0);
+    // Runs on the strand once result is set. The command belongs to its
+    // caller and may be gone as soon as this returns.
+    void (*complete)(PendingCommand*) = nullptr;
+};
 
-        while (true) {
-            // Read one line from the serial port (blocks until \n)
-            asio::read_until(session->port, response_buf, '\n');
-            std::istream is(&response_buf);
-            std::getline(is, response_line);
+/**
+ * @brief Command whose caller blocks its own thread until completion.
+ */
+struct BlockingCommand : PendingCommand {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
 
-            // Clean up trailing \r
-            if (!response_line.empty() && response_line.back() == '\r') {
-                response_line.pop_back();
-            }
-            if (response_line.empty()) {
-                continue;
-            }
+    BlockingCommand() { complete = &BlockingCommand::on_complete; }
 
-            // Check for an error from the Arduino itself
-            // if (response_line.find("ERR:") == 0) {
-            //     std::cerr << "Arduino Error: " << response_line  << std::endl;
-            //     return API_ERROR_ARDUINO_ERR;
-            // }
+    static void on_complete(PendingCommand* base) {
+        BlockingCommand* self = static_cast<BlockingCommand*>(base);
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->done = true;
+        self->cv.notify_one();
+    }
 
-            if (is_press_or_pulse) {
-                // For 'press', we must wait for the *second* "OK".
-                // The first is "OK: pressing..."
-                // The second is just "OK"
-                if (response_line == "OK") {
-                    break; // This is the final "OK" we need
-                }
-            } else {
-                // For other commands (e.g., "hold", "status"),
-                // the first "OK" or "Status" response is enough.
-                if (response_line.find("OK") == 0 || response_line.find("Status:") == 0) {
-                    break;
-                }
-            }
-        }
-    } catch (const asio::system_error& e) {
-        std::cerr << "Serial communication error: " << e.what() << std::endl;
-        return API_ERROR_SERIAL_FAIL;
-    } catch (const std::exception& e) {
-        std::cerr << "Unknown error in send_raw_command: " << e.what() << std::endl;
-        return API_ERROR_UNKNOWN;
+    int32_t wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return done; });
+        return result;
     }
+};
 
-    // Short delay to let the microwave's own controller process the key press
-    std::this_thread::sleep_for(std::chrono::milliseconds(150));
-    return API_SUCCESS;
-}
+/**
+ * @brief Command awaited by a coroutine; completion resumes it on its own executor.
+ */
+struct AsyncCommand : PendingCommand {
+    asio::any_completion_handler<void(int32_t)> handler;
+    asio::any_io_executor handler_executor;
+
+    AsyncCommand() { complete = &AsyncCommand::on_complete; }
+
+    template <typename Handler>
+    void set_handler(Handler&& h, const asio::any_io_executor& fallback) {
+        handler_executor = asio::get_associated_executor(h, fallback);
+        handler = std::forward<Handler>(h);
+    }
+
+    static void on_complete(PendingCommand* base) {
+        AsyncCommand* self = static_cast<AsyncCommand*>(base);
+        // Never resume the awaiting coroutine inline on the I/O strand
+        asio::post(self->handler_executor, asio::append(std::move(self->handler), self->result));
+    }
+};
+
+struct MicrowaveSession;
+class TimedWait;
 
 /**
- * @brief Parses "MM:SS" time string into a string of digits "MMSS".
- * @param time_str Input string (e.g., "01:30")
- * @param out_digits Output string (e.g., "130")
- * @return true on success, false on invalid format.
+ * @brief The session's own command for resyncing after a reconnect: 'status',
+ *        then 'telemetry <hz>' if telemetry was on.
  */
-static bool parse_time_to_digits(const std::string& time_str, std::string& out_digits) {
-    try {
-        size_t colon_pos = time_str.find(':');
-        if (colon_pos == std::string::npos || colon_pos == 0 || colon_pos + 1 == time_str.length()) {
-            return false; // Invalid format (e.g., ":30", "1:", "130")
-        }
+struct ResyncCommand : PendingCommand {
+    MicrowaveSession* session = nullptr;
+    bool restore_telemetry = false;
+    char reply_buffer[256];
+};
 
-        std::string min_str = time_str.substr(0, colon_pos);
-        std::string sec_str = time_str.substr(colon_pos + 1);
+/**
+ * @brief The session's own probe for getting back in step after a reply
+ *        timeout: 'status' and a numbered word no firmware knows, in one write.
+ *
+ * Every firmware answers the word with "ERR: unknown command '<word>'", so
+ * that line marks the end of everything owed to earlier commands; whatever
+ * comes before it is dropped. The 'status' reply just before it tells
+ * whether a press or sequence is still due to report.
+ */
+struct SyncCommand : PendingCommand {
+    MicrowaveSession* session = nullptr;
+    char echo[48];           // the reply that ends the exchange
+    bool board_busy = true;  // from the last "Status:" line seen
+};
 
-        if (sec_str.length() != 2) {
-             return false; // Seconds must be two digits (e.g., "05")
-        }
+//internal Session object
+//this is what MicrowaveHandle will point to
+struct MicrowaveSession {
+    using Executor = asio::strand<asio::io_context::executor_type>;
+    using Timer = asio::basic_waitable_timer<LinkClock, LinkWaitTraits, Executor>;
 
-        // Test conversion
-        int minutes = std::stoi(min_str);
-        int seconds = std::stoi(sec_str);
+    // Every handler touching the port runs on this strand, so reads, writes
+    // and the command queue consumer never race each other. The port passes
+    // everything straight through unless set_microwave_fault_profile is on.
+    Executor strand;
+    FaultyStream<asio::basic_serial_port<Executor>> port;
+    Timer settle_timer;
+    Timer reply_timer;
+    Timer stop_timer;        // ESTOP acknowledgement timeout, then the hold-off
+    Timer reconnect_timer;   // between reconnect attempts
 
-        if (minutes < 0 || seconds < 0 || seconds > 59) {
-            return false; // Invalid time range
-        }
+    char rx_buf[256];        // raw bytes from async_read_some
+    std::string rx_line;     // partial line accumulated across reads
 
-        // Combine into one string for the keypad
-        // e.g., "1" + "30" -> "130"
-        // e.g., "01" + "30" -> "0130"
-        out_digits = min_str + sec_str;
-        return true;
+    // Any thread pushes; only the strand pops. draining is true while a
+    // consumer run is scheduled or a command is in flight.
+    MpscQueue<PendingCommand> queue;
+    std::atomic<bool> draining{false};
 
-    } catch (...) {
-        return false; // stoi failed (e.g., "a:30")
-    }
-}
+    // Bumped by every stop_microwave call; commands queued under an older
+    // value are aborted instead of sent.
+    std::atomic<uint32_t> stop_epoch{0};
+    std::atomic<uint32_t> last_stop_latency_us{0};
 
-// --- C-API Implementation ---
+    // Strand-only state
+    PendingCommand* inflight = nullptr;
+    uint64_t inflight_serial = 0;        // bumped per command sent, for stale timer checks
+    PendingCommand* deferred = nullptr;  // popped during a stop hold-off or reconnect, sent next
+    PendingCommand* priority = nullptr;  // sent before anything else (resync)
+    bool settling = false;   // reply received, waiting out the settle delay
+    bool stop_hold = false;  // emergency stop in progress; queue is paused
+    bool stop_acked = true;  // "ESTOP" line seen for the latest opcode
+    std::vector<PendingCommand*> stop_waiters;
+    bool link_failed = false;
+    bool out_of_sync = false;    // a reply timed out and may still arrive; sync before the next command
+    bool sync_holdoff = false;   // board still busy; the probe is resent after kSyncRetryDelay
+    uint32_t sync_nonce = 0;
+    SyncCommand sync;
 
-// This block ensures C-style function names
-#ifdef __cplusplus
-extern "C" {
-#endif
+    bool reader_running = false;
+    uint32_t reader_generation = 0;      // bumped when the port is replaced
+    std::promise<void> reader_stopped;
 
-DLL_EXPORT MicrowaveHandle open_microwave_controller(const char* port_name, uint32_t baud_rate) {
-    std::string port_str = port_name;
+    // Reconnecting after a port failure (strand only, except the settings)
+    std::atomic<int32_t> reconnect_policy{MICROWAVE_RECONNECT_FAIL_INFLIGHT};
+    std::atomic<uint32_t> reconnect_timeout_ms{kDefaultReconnectTimeoutMs};
+    uint32_t baud_rate = 0;
+    bool reconnecting = false;
+    bool closing = false;
+    LinkClock::time_point link_lost_at;
+    uint32_t telemetry_hz = 0;           // last rate sent, restored after a reconnect
+    ResyncCommand resync;
 
-    // On Windows, Asio needs the \\.\ prefix for COM ports
-    #ifdef _WIN32
-        if (port_str.find("COM") == 0) {
-            port_str = "\\\\.\\" + port_str;
-        }
-    #endif
+    microwave_event_callback event_callback = nullptr;
+    void* event_user_data = nullptr;
 
-    // Create a new session object on the heap
-    MicrowaveSession* session = new (std::nothrow) MicrowaveSession();
-    if (!session) {
-        return 0; // Out of memory
-    }
+    // Telemetry frame being received (strand only); frame_expected == 0 while
+    // reading text lines
+    uint8_t frame[2 + 255 + 1];
+    size_t frame_length = 0;
+    size_t frame_expected = 0;
 
-    try {
-        session->port.open(port_str);
-        session->port.set_option(asio::serial_port_base::baud_rate(baud_rate));
-        session->port.set_option(asio::serial_port_base::character_size(8));
-        session->port.set_option(asio::serial_port_base::parity(asio::serial_port_base::parity::none));
-        session->port.set_option(asio::serial_port_base::stop_bits(asio::serial_port_base::stop_bits::one));
+    // Coalescing of kCoalescedQueries. command_epoch counts every command
+    // that may change device state, so results never outlive such a command.
+    SingleFlight queries[kCoalescedQueryCount];
+    std::atomic<uint32_t> command_epoch{0};
+    std::atomic<uint32_t> query_ttl_ms{0};
 
-    } catch (const asio::system_error& e) {
-        std::cerr << "Failed to open port " << port_str << ": " << e.what() << std::endl;
-        delete session;
-        return 0; // Return NULL handle on failure
-    }
+    std::atomic<uint32_t> command_timeout_ms{0}; // for commands without their own (0 = wait)
 
-    // Wait for the Arduino to reset after connection
-    std::this_thread::sleep_for(std::chrono::seconds(2));
+    // Learned while opening, read-only afterwards (features may only lose
+    // bits, when the firmware turns out not to support one)
+    microwave_caps caps{};
+    std::atomic<uint32_t> features{0};
+    std::string port_name;      // as passed to open, for the device registry
+    KeyMap keys;
 
-    // Clear any startup text from the Arduino
-    try {
-        // Drain any startup/banner noise and partial tokens without blocking the app,
-        // using async read with two timers: a max-total time and a quiet window.
-        auto start = std::chrono::steady_clock::now();
-        auto last_data = start;
-        const auto max_total = std::chrono::milliseconds(400);
-        const auto quiet_window = std::chrono::milliseconds(120);
-
-        asio::steady_timer max_timer(session->io);
-        asio::steady_timer quiet_timer(session->io);
-        bool done = false;
+    // Published for get_microwave_status; age_ms holds the receive time in
+    // steady-clock milliseconds until it is read
+    Seqlock<microwave_status> status;
 
-        // Start the max total timer
-        max_timer.expires_after(max_total);
-        max_timer.async_wait([&](const asio::error_code& /*ec*/) {
-            if (!done) {
-                done = true;
-                asio::error_code ignore_ec;
-                session->port.cancel(ignore_ec);
-            }
-        });
+    // What the oven is doing, as far as the keys this session pressed tell;
+    // updated on the strand, read by planners and get_microwave_oven_state
+    Seqlock<OvenShadow> oven;
 
-        // Function to (re)arm the quiet timer (recursive lambda needs std::function)
-        std::function<void()> arm_quiet;
-        arm_quiet = [&]() {
-            quiet_timer.expires_after(quiet_window);
-            quiet_timer.async_wait([&](const asio::error_code& /*ec*/) {
-                auto now = std::chrono::steady_clock::now();
-                if (done) return;
-                if (now - last_data >= quiet_window) {
-                    done = true;
-                    asio::error_code ignore_ec;
-                    session->port.cancel(ignore_ec);
-                } else {
-                    // Not quiet long enough; re-arm
-                    arm_quiet();
-                }
-            });
-        };
-        arm_quiet();
+    // Per-key press and gap times; updated on the strand from 'scan' and
+    // key-up events, read by whoever builds a command
+    Seqlock<KeyTimings> timings;
+    uint32_t key_down_ms[MICROWAVE_KEY_COUNT] = {}; // board time of each key's last "down" (strand only)
+    int32_t held_key = -1;                          // key of the last 'hold' (strand only)
 
-        // Start continuous async drain
-        static char drain_buf[256];
-        std::function<void()> do_read;
-        do_read = [&]() {
-            if (done) return;
-            session->port.async_read_some(asio::buffer(drain_buf, sizeof(drain_buf)),
-                [&](const asio::error_code& ec, std::size_t n) {
-                    if (done) return;
-                    if (!ec && n > 0) {
-                        last_data = std::chrono::steady_clock::now();
-                        // keep draining
-                        do_read();
-                    } else if (ec == asio::error::operation_aborted) {
-                        // canceled due to timers -> finish
-                    } else if (ec) {
-                        // unexpected error; stop
-                        done = true;
-                        asio::error_code ignore_ec;
-                        session->port.cancel(ignore_ec);
-                    } else {
-                        // zero bytes without error: schedule another read
-                        do_read();
-                    }
-                });
-        };
-        do_read();
+    Seqlock<microwave_recipe_report> recipe_report; // last run_microwave_recipe (strand writes)
+
+    // The cook in progress, on the runtime's wheel (strand only). Every cook
+    // that ends, finished or not, bumps cooks_ended under done_mutex.
+    TimerNode cook_timer;
+    bool cook_pending = false;       // scheduled, or expired and not yet reported
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    uint64_t cooks_ended = 0;
+    bool last_cook_done = false;     // the last one ran to the end
+    std::vector<TimedWait*> done_waits; // wait_microwave_done callers, released by the end
+
+    LinkLogContext log;      // handle + port stamped on this session's log records
 
-        session->io.restart();
-        session->io.run(); // runs until timers cancel pending read(s)
+    std::unique_ptr<TraceWriter> trace;  // every byte on the port, while recording (strand only)
 
-        // Send a newline to ensure the Arduino parser finalizes any partial token.
-        asio::error_code ec;
-        asio::write(session->port, asio::buffer("\n", 1), ec);
-        (void)ec;
-    } catch(...) {
-        // Ignore errors; best-effort drain only
+    explicit MicrowaveSession(asio::io_context& io)
+        : strand(asio::make_strand(io)), port(strand), settle_timer(strand), reply_timer(strand),
+          stop_timer(strand), reconnect_timer(strand) {
+        microwave_status initial{};
+        initial.active_key = -1;
+        status.store(initial);
+        cook_timer.owner = this;
     }
+};
+
+// Open sessions live in a preallocated slot map; a MicrowaveHandle encodes
+// the slot index plus a generation so stale handles are detected, not
+// dereferenced. 2^10 slots comfortably covers a station's worth of ports.
+using SessionTable = HandleTable<MicrowaveSession, 10>;
+static SessionTable g_sessions;
+
+// Longest line kept while waiting for a newline; anything beyond is dropped.
+static constexpr size_t kMaxLineLength = 1024;
+
+// --- Virtual time ---
+//
+// With set_microwave_virtual_time the library is one participant of a
+// shared LinkClock (virtual_clock.h). It is idle while every caller driving
+// the simulation is blocked in a timed wait (sleep_microwave,
+// wait_microwave_done, a recipe or a power profile), no recipe or profile
+// is between two of its sleeps, and no session has a command queued, in
+// flight or held back by a stop or reconnect. It is idle until the earliest
+// deadline those waits, sleeps and the cook wheel have. Other blocking calls
+// are not timed waits: while they use the link the clock runs in real time.
+struct VirtualTime {
+    std::atomic<bool> enabled{false};
+    std::atomic<int> slot{-1};                  // in the shared clock
+    std::mutex mutex;
+    uint32_t callers = 1;                       // threads driving the simulation
+    uint32_t waiting = 0;                       // ... blocked in timed waits now
+    int32_t active = 0;                         // recipes and profiles not sleeping
+    std::multiset<LinkClock::time_point> deadlines;
+    std::vector<MicrowaveSession*> sessions;    // open ones; their state is read on the runtime thread
+};
 
-    // Return the session pointer cast to our integer handle type
-    return reinterpret_cast<MicrowaveHandle>(session);
+static VirtualTime& virtual_time() {
+    static VirtualTime* state = new VirtualTime(); // leaked, like the runtime
+    return *state;
 }
 
-DLL_EXPORT int32_t close_microwave_controller(MicrowaveHandle handle) {
-    if (handle == 0) {
-        return API_ERROR_BAD_HANDLE;
+/**
+ * @brief Counts the calling thread as blocked in a timed wait while it
+ *        exists (virtual time only).
+ *
+ * Whoever ends the wait early releases it before waking the caller, so the
+ * clock cannot jump between the wake-up and the caller running again. The
+ * deadline stays registered until destruction: once passed, it holds the
+ * clock until the waiter has seen it.
+ */
+class TimedWait {
+public:
+    explicit TimedWait(LinkClock::time_point deadline = LinkClock::time_point::max()) {
+        VirtualTime& vt = virtual_time();
+        if (!vt.enabled.load()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(vt.mutex);
+        counted_ = true;
+        ++vt.waiting;
+        if (deadline != LinkClock::time_point::max()) {
+            deadline_ = vt.deadlines.insert(deadline);
+            has_deadline_ = true;
+        }
+    }
+    ~TimedWait() {
+        release();
+        if (has_deadline_) {
+            VirtualTime& vt = virtual_time();
+            std::lock_guard<std::mutex> lock(vt.mutex);
+            vt.deadlines.erase(deadline_);
+        }
     }
-    // Cast the handle back to a pointer
-    MicrowaveSession* session = reinterpret_cast<MicrowaveSession*>(handle);
+    TimedWait(const TimedWait&) = delete;
+    TimedWait& operator=(const TimedWait&) = delete;
 
-    try {
-        if (session->port.is_open()) {
-            session->port.close();
+    /**
+     * @brief Stops counting the caller as waiting; any thread, once.
+     */
+    void release() {
+        if (counted_ && !released_.exchange(true)) {
+            VirtualTime& vt = virtual_time();
+            std::lock_guard<std::mutex> lock(vt.mutex);
+            --vt.waiting;
         }
-    } catch (const asio::system_error& e) {
-        std::cerr << "Error on port close: " << e.what() << std::endl;
-        // Continue to delete, as we can't recover
     }
 
-    delete session; // Free the memory
-    return API_SUCCESS;
-}
+private:
+    bool counted_ = false;
+    std::atomic<bool> released_{false};
+    bool has_deadline_ = false;
+    std::multiset<LinkClock::time_point>::iterator deadline_;
+};
 
 /**
- * @brief Sends a raw command string to the Arduino.
- *
- * NOTE: This function sends the command *verbatim*. The caller is
- * responsible for formatting it correctly (e.g., "press start",
- * "hold 1", "release").
+ * @brief Counts a recipe or profile as active (delta 1), or as asleep until
+ *        deadline (delta -1), for the scope (virtual time only).
  */
-DLL_EXPORT int32_t send_microwave_command(MicrowaveHandle handle, const char* command) {
-    if (handle == 0) {
-        return API_ERROR_BAD_HANDLE;
+class VirtualActivity {
+public:
+    explicit VirtualActivity(int32_t delta, LinkClock::time_point deadline = LinkClock::time_point::max())
+        : delta_(delta) {
+        VirtualTime& vt = virtual_time();
+        if (!vt.enabled.load()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(vt.mutex);
+        counted_ = true;
+        vt.active += delta_;
+        if (deadline != LinkClock::time_point::max()) {
+            deadline_ = vt.deadlines.insert(deadline);
+            has_deadline_ = true;
+        }
     }
-    MicrowaveSession* session = reinterpret_cast<MicrowaveSession*>(handle);
-    if (!command) {
-        return API_ERROR_UNKNOWN;
+    ~VirtualActivity() {
+        if (!counted_) {
+            return;
+        }
+        VirtualTime& vt = virtual_time();
+        std::lock_guard<std::mutex> lock(vt.mutex);
+        vt.active -= delta_;
+        if (has_deadline_) {
+            vt.deadlines.erase(deadline_);
+        }
     }
+    VirtualActivity(const VirtualActivity&) = delete;
+    VirtualActivity& operator=(const VirtualActivity&) = delete;
 
-    // Pass the command string directly to the raw helper
-    return send_raw_command(session, std::string(command));
-}
+private:
+    int32_t delta_;
+    bool counted_ = false;
+    bool has_deadline_ = false;
+    std::multiset<LinkClock::time_point>::iterator deadline_;
+};
 
-DLL_EXPORT int32_t run_microwave(MicrowaveHandle handle, const char* time_str, uint8_t power_level) {
-    if (handle == 0) {
-        return API_ERROR_BAD_HANDLE;
-    }
-    MicrowaveSession* session = reinterpret_cast<MicrowaveSession*>(handle);
-    if (!time_str) {
-        return API_ERROR_BAD_TIME_STR;
+/**
+ * @brief Sleeps the calling thread until deadline on the LinkClock, in
+ *        kVirtualPoll slices while the clock may jump.
+ */
+static void sleep_until_link(LinkClock::time_point deadline) {
+    for (LinkClock::time_point now = LinkClock::now(); now < deadline; now = LinkClock::now()) {
+        LinkClock::duration left = deadline - now;
+        if (virtual_time().enabled.load()) {
+            left = std::min<LinkClock::duration>(left, LinkWaitTraits::kVirtualPoll);
+        }
+        std::this_thread::sleep_for(left);
     }
+}
 
-    // 1. Parse time
-    std::string time_digits;
-    if (!parse_time_to_digits(std::string(time_str), time_digits)) {
-        return API_ERROR_BAD_TIME_STR;
+// --- Internal Helper Functions ---
+
+static void drain_command_queue(MicrowaveSession* session);
+static void forget_device(std::string_view port);
+static void start_reconnect(MicrowaveSession* session, const asio::error_code& ec);
+static void update_cook_timer(MicrowaveSession* session);
+
+/**
+ * @brief LinkClock milliseconds, the oven shadow's time base.
+ */
+static uint64_t steady_ms() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        LinkClock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief LinkClock microseconds, the trace's time base.
+ */
+static uint64_t steady_us() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        LinkClock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief Appends bytes that crossed the port to the session's trace, if
+ *        recording (strand only).
+ */
+static void trace_bytes(MicrowaveSession* session, TraceDirection direction, const void* data, size_t length) {
+    if (session->trace &&
+        !session->trace->append(direction, steady_us(), static_cast<const uint8_t*>(data), length)) {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Serial trace stopped: the file could not grow");
+        session->trace.reset();
     }
+}
 
-    // 2. Calculate power presses
-    // Logic: 100% (or invalid) -> 0 presses
-    //        90% -> (100-90)/10 = 1 press
-    //        10% -> (100-10)/10 = 9 presses
-    int num_power_presses = 0;
-    if (power_level > 100 || power_level < 10 || (power_level % 10 != 0)) {
-        num_power_presses = 0; // Default to 100% (0 presses)
-    } else if (power_level == 100) {
-        num_power_presses = 0;
-    } else {
-        num_power_presses = (100 - power_level) / 10 + 1;
+/**
+ * @brief Resolves a key name the way the firmware does (case-insensitive).
+ */
+static int32_t key_index(const MicrowaveSession* session, std::string_view name) {
+    if (!session->keys.empty()) {
+        return session->keys.find(name);
+    }
+    for (int32_t i = 0; i < MICROWAVE_KEY_COUNT; ++i) {
+        std::string_view candidate = kKeyNames[i];
+        if (candidate.size() == name.size() &&
+            std::equal(candidate.begin(), candidate.end(), name.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return i;
+        }
     }
+    return -1;
+}
 
-    // 3. Execute the full command sequence
-    int32_t result = API_SUCCESS;
+/**
+ * @brief Applies a key press to the oven shadow (strand only).
+ */
+static void track_key(MicrowaveSession* session, int32_t key) {
+    OvenShadow shadow = session->oven.load();
+    shadow.key_pressed(key, steady_ms(), kOvenModel);
+    session->oven.store(shadow);
+    update_cook_timer(session);
+}
 
-    // Use goto for a clean, single-exit-point C-style API
+/**
+ * @brief Marks the oven state unknown (strand only).
+ */
+static void lose_oven_state(MicrowaveSession* session) {
+    OvenShadow shadow = session->oven.load();
+    shadow.lost();
+    session->oven.store(shadow);
+    update_cook_timer(session);
+}
 
-    //NOTE: does not auto clear assumes clean state
+/**
+ * @brief The keys a key command (press, pulse, hold, release, seq) acts on.
+ */
+struct CommandKeys {
+    enum class Verb : uint8_t { kNone, kPress, kHold, kRelease, kSequence };
 
-    // Press "Cook Time"
-    result = send_raw_command(session, "press cook_time");
-    if (result != API_SUCCESS) goto cleanup;
+    Verb verb = Verb::kNone;
+    int32_t keys[kMaxSequenceSteps];
+    size_t count = 0;
+    bool resolved = true;   // every key name was recognised
+};
 
-    // Press the digits
-    for (char const &digit : time_digits) {
-        result = send_raw_command(session, std::string("press ") + digit);
-        if (result != API_SUCCESS) goto cleanup;
+static CommandKeys parse_command_keys(const MicrowaveSession* session, const PendingCommand& cmd) {
+    CommandKeys parsed;
+    std::string_view line(cmd.text, cmd.length > 0 ? cmd.length - 1 : 0);
+    size_t space = line.find(' ');
+    std::string_view verb = line.substr(0, space);
+    if (verb == "press" || verb == "pulse") {
+        parsed.verb = CommandKeys::Verb::kPress;
+    } else if (verb == "hold") {
+        parsed.verb = CommandKeys::Verb::kHold;
+    } else if (verb == "release") {
+        parsed.verb = CommandKeys::Verb::kRelease;
+        return parsed;
+    } else if (verb == "seq") {
+        parsed.verb = CommandKeys::Verb::kSequence;
+    } else {
+        return parsed;
     }
-
-    // Press "Power" N times
-    for (int i = 0; i < num_power_presses; ++i) {
-        result = send_raw_command(session, "press power");
-        if (result != API_SUCCESS) goto cleanup;
+    while (space != std::string_view::npos && parsed.count < kMaxSequenceSteps) {
+        size_t start = line.find_first_not_of(' ', space);
+        if (start == std::string_view::npos) {
+            break;
+        }
+        space = line.find(' ', start);
+        std::string_view token = line.substr(start, space - start);
+        int32_t key = parsed.verb == CommandKeys::Verb::kSequence
+                          ? static_cast<int32_t>(std::strtol(token.data(), nullptr, 10))
+                          : key_index(session, token);
+        if (key < 0 || key >= MICROWAVE_KEY_COUNT) {
+            parsed.resolved = false;
+            break;
+        }
+        parsed.keys[parsed.count++] = key;
+        if (parsed.verb != CommandKeys::Verb::kSequence) {
+            break; // the rest are press/pulse timings
+        }
     }
+    return parsed;
+}
 
-cleanup:
-    return result;
+/**
+ * @brief Feeds a finished command's key presses to the oven shadow (strand only).
+ *
+ * A press that failed may or may not have reached the oven, so it makes the
+ * state unknown; only a press the firmware rejected outright did nothing.
+ */
+static void track_command_keys(MicrowaveSession* session, const PendingCommand& cmd, int32_t result) {
+    const CommandKeys parsed = parse_command_keys(session, cmd);
+    if (parsed.verb == CommandKeys::Verb::kNone || parsed.verb == CommandKeys::Verb::kRelease) {
+        return;
+    }
+    const bool sequence = parsed.verb == CommandKeys::Verb::kSequence;
+    if (result != API_SUCCESS) {
+        if (result != API_ERROR_ARDUINO_ERR || sequence) {
+            lose_oven_state(session); // a 'seq' may fail part way through
+        }
+        return;
+    }
+    if (parsed.verb == CommandKeys::Verb::kHold && parsed.count > 0) {
+        session->held_key = parsed.keys[0];
+    }
+    for (size_t i = 0; i < parsed.count; ++i) {
+        track_key(session, parsed.keys[i]);
+    }
+    if (!parsed.resolved) {
+        lose_oven_state(session);
+    }
 }
 
-DLL_EXPORT int32_t stop_microwave(MicrowaveHandle handle) {
-    if (handle == 0) {
-        return API_ERROR_BAD_HANDLE;
+/**
+ * @brief How long to leave the keypad alone after a command (strand only).
+ *
+ * The oven has to see the last key released (or, after 'hold', pressed)
+ * for a few scans before the next key; commands that touch no key need
+ * no pause.
+ */
+static uint32_t settle_ms_after(MicrowaveSession* session, const PendingCommand& cmd) {
+    const CommandKeys parsed = parse_command_keys(session, cmd);
+    const KeyTimings timings = session->timings.load();
+    switch (parsed.verb) {
+    case CommandKeys::Verb::kPress:
+    case CommandKeys::Verb::kSequence:
+        return parsed.count > 0 ? timings.gap_ms(parsed.keys[parsed.count - 1]) : timings.max_gap_ms();
+    case CommandKeys::Verb::kHold:
+        return parsed.count > 0 ? timings.press_ms(parsed.keys[0]) : kDefaultPressMs;
+    case CommandKeys::Verb::kRelease:
+        return session->held_key >= 0 ? timings.gap_ms(session->held_key) : timings.max_gap_ms();
+    default:
+        return 0;
     }
-    MicrowaveSession* session = reinterpret_cast<MicrowaveSession*>(handle);
+}
 
-    // This is a simple wrapper for a single raw command
-    return send_raw_command(session, "press stop");
+/**
+ * @brief Hands a result back to whoever is waiting on a command.
+ *
+ * Nothing may touch the command afterwards.
+ */
+static void signal_command(PendingCommand* cmd, int32_t result) {
+    cmd->result = result;
+    cmd->complete(cmd);
 }
 
+/**
+ * @brief Finishes the in-flight command and starts the next one (strand only).
+ */
+static void complete_inflight(MicrowaveSession* session, int32_t result) {
+    PendingCommand* cmd = session->inflight;
+    session->inflight = nullptr;
+    session->settling = false;
+    if (cmd) {
+        session->reply_timer.cancel();
+    }
+    if (cmd) {
+        if (!cmd->read_only) {
+            track_command_keys(session, *cmd, result);
+        }
+        signal_command(cmd, result);
+    }
+    drain_command_queue(session);
+}
 
-#ifdef __cplusplus
-} // extern "C"
-#endif
\ No newline at end of file
+/**
+ * @brief Marks the link dead and fails the in-flight command (strand only).
+ *
+ * Commands still queued are failed by drain_command_queue as it reaches them.
+ */
+static void on_link_error(MicrowaveSession* session, const asio::error_code& ec) {
+    if (session->reconnecting) {
+        return; // the reconnect loop owns the port now
+    }
+    if (ec != asio::error::operation_aborted && !session->closing &&
+        session->reconnect_policy.load() != MICROWAVE_RECONNECT_OFF && session->caps.device_id[0] != '\0') {
+        start_reconnect(session, ec);
+        return;
+    }
+    if (!session->link_failed && ec != asio::error::operation_aborted) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Serial communication error: %s", ec.message().c_str());
+    }
+    session->link_failed = true;
+    if (session->inflight && !session->settling) {
+        complete_inflight(session, API_ERROR_SERIAL_FAIL);
+    }
+}
+
+/**
+ * @brief Stops using a protocol feature the firmware turned out not to have.
+ *
+ * Also drops the port's registry record, so the next open probes again.
+ */
+static void drop_feature(MicrowaveSession* session, uint32_t feature, const char* name) {
+    if (!(session->features.fetch_and(~feature) & feature)) {
+        return;
+    }
+    LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Firmware does not support %s; falling back", name);
+    forget_device(session->port_name);
+}
+
+/**
+ * @brief Ends an emergency stop: answers every stop_microwave caller, then
+ *        keeps the queue paused for kEmergencyStopHold (strand only).
+ */
+static void finish_emergency_stop(MicrowaveSession* session, int32_t result) {
+    session->stop_acked = true;
+    for (PendingCommand* waiter : session->stop_waiters) {
+        signal_command(waiter, result);
+    }
+    session->stop_waiters.clear();
+
+    session->stop_timer.expires_after(kEmergencyStopHold);
+    session->stop_timer.async_wait([session](const asio::error_code& ec) {
+        if (ec) {
+            return; // superseded by another stop
+        }
+        session->stop_hold = false;
+        drain_command_queue(session);
+    });
+}
+
+static void send_emergency_stop(MicrowaveSession* session);
+
+/**
+ * @brief The stop fast lane (strand only).
+ *
+ * Runs ahead of the command queue: the opcode is written immediately, the
+ * in-flight command is abandoned and the queue is paused until the firmware
+ * has finished pressing Stop. While reconnecting, the stop waits for the
+ * board instead.
+ */
+static void start_emergency_stop(MicrowaveSession* session, PendingCommand* waiter) {
+    if (session->link_failed) {
+        signal_command(waiter, API_ERROR_SERIAL_FAIL);
+        return;
+    }
+    session->stop_waiters.push_back(waiter);
+    session->stop_hold = true;
+    session->stop_acked = false;
+    if (!session->reconnecting) {
+        send_emergency_stop(session); // else sent once the board is back
+    }
+}
+
+/**
+ * @brief Writes the stop opcode for the waiting stop_microwave calls (strand only).
+ */
+static void send_emergency_stop(MicrowaveSession* session) {
+    trace_bytes(session, TraceDirection::kTx, &kEmergencyStopOpcode, 1);
+    asio::async_write(session->port, asio::buffer(&kEmergencyStopOpcode, 1),
+        [session](const asio::error_code& ec, std::size_t /*n*/) {
+            if (ec) {
+                on_link_error(session, ec);
+                if (!session->reconnecting) {
+                    finish_emergency_stop(session, API_ERROR_SERIAL_FAIL);
+                }
+            }
+        });
+
+    // The firmware drops the interrupted press without its final "OK"
+    if (session->inflight && !session->settling) {
+        complete_inflight(session, API_ERROR_ABORTED);
+    }
+
+    session->stop_timer.expires_after(kEmergencyStopAckTimeout);
+    session->stop_timer.async_wait([session](const asio::error_code& ec) {
+        if (!ec && !session->stop_acked) {
+            LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Emergency stop was not acknowledged");
+            drop_feature(session, MICROWAVE_FEATURE_ESTOP, "the stop opcode");
+            finish_emergency_stop(session, API_ERROR_SERIAL_FAIL);
+        }
+    });
+}
+
+/**
+ * @brief Checks whether a reply line completes the given command.
+ */
+static bool reply_completes(const PendingCommand& cmd, const std::string& response_line) {
+    // Check for an error from the Arduino itself
+    // if (response_line.find("ERR:") == 0) {
+    //     std::cerr << "Arduino Error: " << response_line  << std::endl;
+    //     return API_ERROR_ARDUINO_ERR;
+    // }
+
+    if (cmd.reply == PendingCommand::Reply::kPressDone) {
+        // For 'press', we must wait for the *second* "OK".
+        // The first is "OK: pressing..."
+        // The second is just "OK"
+        return response_line == "OK"; // This is the final "OK" we need
+    }
+    if (cmd.reply == PendingCommand::Reply::kSequenceDone) {
+        return response_line.compare(0, 12, "OK: seq done") == 0;
+    }
+    if (cmd.reply == PendingCommand::Reply::kScan) {
+        return response_line.compare(0, 5, "Scan:") == 0;
+    }
+    // For other commands (e.g., "hold", "status"),
+    // the first "OK" or "Status" response is enough.
+    return response_line.find("OK") == 0 || response_line.find("Status:") == 0 ||
+           response_line.find("Version:") == 0 || response_line.find("Caps:") == 0;
+}
+
+/**
+ * @brief Learns key timing from a key event (strand only).
+ *
+ * A key-up carries the strobes the press saw; with the matching key-down
+ * that gives the scan period and whether the oven could have registered it.
+ */
+static void observe_key_event(MicrowaveSession* session, const microwave_event& event) {
+    if (event.type == MICROWAVE_EVENT_KEY_DOWN) {
+        session->key_down_ms[event.key] = event.timestamp_ms;
+        return;
+    }
+    KeyTimings timings = session->timings.load();
+    if (event.type == MICROWAVE_EVENT_SCAN_LOST) {
+        timings.press_failed(event.key);
+    } else if (event.type == MICROWAVE_EVENT_KEY_UP && event.detail[0] != '\0') {
+        uint32_t strobes = static_cast<uint32_t>(std::strtoul(event.detail, nullptr, 10));
+        uint32_t held_ms = event.timestamp_ms - session->key_down_ms[event.key];
+        if (!timings.observe_press(event.key, held_ms, strobes)) {
+            LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Key %d saw %u strobes in %u ms; lengthening its press",
+                     static_cast<int>(event.key), static_cast<unsigned>(strobes), static_cast<unsigned>(held_ms));
+            lose_oven_state(session); // the oven may have missed it
+        }
+    } else {
+        return;
+    }
+    session->timings.store(timings);
+}
+
+/**
+ * @brief Decodes an "EVT <ms> <name>[ <detail>]" line and hands it to the
+ *        session's event callback (strand only).
+ */
+static void dispatch_event(MicrowaveSession* session, const std::string& line) {
+    struct EventName { const char* name; int32_t type; bool has_key; };
+    static const EventName kEventNames[] = {
+        {"down", MICROWAVE_EVENT_KEY_DOWN, true},
+        {"up", MICROWAVE_EVENT_KEY_UP, true},
+        {"seq_done", MICROWAVE_EVENT_SEQUENCE_DONE, false},
+        {"error", MICROWAVE_EVENT_ERROR, false},
+        {"scan_lost", MICROWAVE_EVENT_SCAN_LOST, true},
+    };
+
+    char* p = nullptr;
+    microwave_event event{-1, -1, 0, ""};
+    event.timestamp_ms = static_cast<uint32_t>(std::strtoul(line.c_str() + 4, &p, 10));
+    while (*p == ' ') ++p;
+    const char* name = p;
+    while (*p && *p != ' ') ++p;
+    std::string_view name_view(name, static_cast<size_t>(p - name));
+    while (*p == ' ') ++p;
+
+    for (const EventName& candidate : kEventNames) {
+        if (name_view == candidate.name) {
+            event.type = candidate.type;
+            if (candidate.has_key) {
+                event.key = static_cast<int32_t>(std::strtol(p, &p, 10));
+                while (*p == ' ') ++p;
+            }
+            event.detail = p;
+            break;
+        }
+    }
+    if (event.type < 0) {
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Ignoring unknown event: %s", line.c_str());
+        return;
+    }
+    if (event.type == MICROWAVE_EVENT_ERROR || event.type == MICROWAVE_EVENT_SCAN_LOST) {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Firmware reported: %s", line.c_str() + 4);
+        lose_oven_state(session); // a press may not have registered
+    }
+    if (event.key >= 0 && event.key < MICROWAVE_KEY_COUNT) {
+        observe_key_event(session, event);
+    }
+    if (session->event_callback) {
+        session->event_callback(session->log.handle, &event, session->event_user_data);
+    }
+}
+
+/**
+ * @brief Routes one complete line from the Arduino (strand only).
+ *
+ * Lines that arrive while no command is waiting (or that do not complete the
+ * current one) are discarded rather than being mistaken for the next reply.
+ */
+static void handle_line(MicrowaveSession* session, const std::string& response_line) {
+    // "ESTOP <us>": the firmware has pressed Stop in response to the opcode
+    if (response_line.compare(0, 6, "ESTOP ") == 0) {
+        session->last_stop_latency_us.store(
+            static_cast<uint32_t>(std::strtoul(response_line.c_str() + 6, nullptr, 10)));
+        track_key(session, MICROWAVE_KEY_STOP);
+        if (!session->stop_acked) {
+            finish_emergency_stop(session, API_SUCCESS);
+        }
+        return;
+    }
+    // "EVT ...": unsolicited, never a reply to the in-flight command
+    if (response_line.compare(0, 4, "EVT ") == 0) {
+        dispatch_event(session, response_line);
+        return;
+    }
+    if (response_line.empty() || !session->inflight || session->settling) {
+        return;
+    }
+    PendingCommand* cmd = session->inflight;
+    if (cmd->reply == PendingCommand::Reply::kSync) {
+        // Until the echo, every line belongs to a command that timed out
+        SyncCommand* sync = static_cast<SyncCommand*>(cmd);
+        if (response_line.compare(0, 7, "Status:") == 0) {
+            sync->board_busy = response_line != "Status: idle" &&
+                               response_line.find("(until release)") == std::string::npos;
+        } else if (response_line == sync->echo) {
+            complete_inflight(session, API_SUCCESS);
+        }
+        return;
+    }
+    // A scan abandoned by a stop or a timeout still reports when its window
+    // ends; only a scan that is waiting takes the result
+    if (response_line.compare(0, 5, "Scan:") == 0 && cmd->reply != PendingCommand::Reply::kScan) {
+        return;
+    }
+    if (cmd->reply_text && cmd->reply_length + 1 < cmd->reply_capacity) {
+        if (cmd->reply_length > 0) {
+            cmd->reply_text[cmd->reply_length++] = '\n';
+        }
+        cmd->reply_length += response_line.copy(cmd->reply_text + cmd->reply_length,
+                                                cmd->reply_capacity - 1 - cmd->reply_length);
+        cmd->reply_text[cmd->reply_length] = '\0';
+    }
+    if (response_line.compare(0, 4, "ERR:") == 0) {
+        // Unsolicited errors arrive as events, so this one answers the
+        // command. A rejected command did nothing, so there is nothing to settle.
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Command rejected: %s", response_line.c_str());
+        if (cmd->reply == PendingCommand::Reply::kSequenceDone &&
+            response_line.find("unknown command") != std::string::npos) {
+            drop_feature(session, MICROWAVE_FEATURE_SEQ, "'seq'");
+        }
+        complete_inflight(session, API_ERROR_ARDUINO_ERR);
+        return;
+    }
+    if (!reply_completes(*cmd, response_line)) {
+        return;
+    }
+    if (cmd->read_only) {
+        complete_inflight(session, API_SUCCESS); // no key was pressed
+        return;
+    }
+
+    // Short delay to let the microwave's own controller process the key press.
+    // The next queued command is held back until it expires.
+    const uint32_t settle_ms = settle_ms_after(session, *cmd);
+    if (settle_ms == 0) {
+        complete_inflight(session, API_SUCCESS);
+        return;
+    }
+    session->settling = true;
+    session->settle_timer.expires_after(std::chrono::milliseconds(settle_ms));
+    session->settle_timer.async_wait([session](const asio::error_code& /*ec*/) {
+        complete_inflight(session, API_SUCCESS);
+    });
+}
+
+/**
+ * @brief Decodes a complete telemetry frame and publishes it (strand only).
+ */
+static void handle_telemetry_frame(MicrowaveSession* session) {
+    const uint8_t* frame = session->frame;
+    const size_t payload_length = frame[1];
+    uint8_t check = frame[1];
+    for (size_t i = 0; i < payload_length; ++i) {
+        check ^= frame[2 + i];
+    }
+    const uint8_t* p = frame + 2;
+    if (check != frame[2 + payload_length] || payload_length < kTelemetryPayloadLength ||
+        p[0] != kTelemetryVersion) {
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Dropping bad telemetry frame");
+        return;
+    }
+    auto u16 = [p](size_t at) { return static_cast<uint32_t>(p[at] | (p[at + 1] << 8)); };
+
+    microwave_status status = session->status.load();
+    status.frame_count += 1;
+    status.age_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        LinkClock::now().time_since_epoch()).count());
+    status.board_time_ms = u16(1) | (u16(3) << 16);
+    status.active_key = static_cast<int8_t>(p[5]);
+    status.flags = p[6];
+    status.hold_remaining_ms = u16(7);
+    status.sequence_step = p[9];
+    status.sequence_length = p[10];
+    status.loop_count = u16(11);
+    status.max_loop_us = u16(13);
+    session->status.store(status);
+}
+
+/**
+ * @brief Continuous read loop that splits incoming bytes into lines (strand only).
+ *
+ * A kTelemetryStart byte at the start of a line begins a binary frame, which
+ * is collected by length (it may contain '\n') instead of as text.
+ */
+static void read_serial(MicrowaveSession* session) {
+    const uint32_t generation = session->reader_generation;
+    session->port.async_read_some(asio::buffer(session->rx_buf, sizeof(session->rx_buf)),
+        [session, generation](const asio::error_code& ec, std::size_t n) {
+            if (generation != session->reader_generation) {
+                return; // the port was replaced by a reconnect; a new reader runs
+            }
+            if (ec) {
+                on_link_error(session, ec);
+                if (!session->reconnecting) {
+                    session->reader_stopped.set_value();
+                }
+                return;
+            }
+            trace_bytes(session, TraceDirection::kRx, session->rx_buf, n);
+            for (std::size_t i = 0; i < n; ++i) {
+                char c = session->rx_buf[i];
+                if (session->frame_expected > 0) {
+                    session->frame[session->frame_length++] = static_cast<uint8_t>(c);
+                    if (session->frame_length == 2) {
+                        session->frame_expected = 2 + session->frame[1] + 1;
+                    }
+                    if (session->frame_length == session->frame_expected) {
+                        handle_telemetry_frame(session);
+                        session->frame_expected = 0;
+                    }
+                } else if (c == static_cast<char>(kTelemetryStart) && session->rx_line.empty()) {
+                    session->frame[0] = kTelemetryStart;
+                    session->frame_length = 1;
+                    session->frame_expected = 2; // until the length byte is in
+                } else if (c == '\n') {
+                    LINK_LOG(MICROWAVE_LOG_TRACE, &session->log, "rx: %s", session->rx_line.c_str());
+                    handle_line(session, session->rx_line);
+                    session->rx_line.clear();
+                } else if (c != '\r' && session->rx_line.size() < kMaxLineLength) {
+                    session->rx_line += c;
+                }
+            }
+            read_serial(session);
+        });
+}
+
+/**
+ * @brief Numbers the session's sync probe and sizes its timeout for the
+ *        command waiting behind it (strand only).
+ */
+static PendingCommand* prepare_sync(MicrowaveSession* session, const PendingCommand& waiting) {
+    SyncCommand& sync = session->sync;
+    const uint32_t nonce = ++session->sync_nonce;
+    int length = std::snprintf(sync.text, sizeof(sync.text), "status\nsync-%u\n", static_cast<unsigned>(nonce));
+    sync.length = static_cast<size_t>(length);
+    std::snprintf(sync.echo, sizeof(sync.echo), "ERR: unknown command 'sync-%u'", static_cast<unsigned>(nonce));
+    sync.reply = PendingCommand::Reply::kSync;
+    sync.read_only = true;
+    sync.board_busy = true;
+    const uint32_t timeout_ms = waiting.timeout_ms ? waiting.timeout_ms : session->command_timeout_ms.load();
+    sync.timeout_ms = timeout_ms ? timeout_ms : kSyncTimeoutMs;
+    sync.stop_epoch = session->stop_epoch.load();
+    return &sync;
+}
+
+/**
+ * @brief Starts queued commands one at a time (strand only).
+ */
+static void drain_command_queue(MicrowaveSession* session) {
+    while (!session->inflight) {
+        PendingCommand* cmd = session->priority;
+        session->priority = nullptr;
+        if (!cmd) {
+            cmd = session->deferred;
+            session->deferred = nullptr;
+        }
+        if (!cmd) {
+            cmd = session->queue.pop();
+        }
+        if (!cmd) {
+            // Go idle, then re-check: a producer that pushed after our pop but
+            // saw draining == true is relying on us to pick its command up.
+            session->draining.store(false);
+            if (session->queue.might_have_items() && !session->draining.exchange(true)) {
+                asio::post(session->strand, [session]() { drain_command_queue(session); });
+            }
+            return;
+        }
+        if (session->link_failed) {
+            signal_command(cmd, API_ERROR_SERIAL_FAIL);
+            continue;
+        }
+        if (cmd->stop_epoch != session->stop_epoch.load()) {
+            signal_command(cmd, API_ERROR_ABORTED); // queued before a stop
+            continue;
+        }
+        if (session->stop_hold || session->reconnecting || session->sync_holdoff) {
+            // Leave draining set; the hold-off timer or the reconnect resumes from here
+            (cmd == &session->resync ? session->priority : session->deferred) = cmd;
+            return;
+        }
+        if (session->out_of_sync) {
+            // A late reply must not be taken for this command's; it goes
+            // once the probe's echo is in
+            session->deferred = cmd;
+            cmd = prepare_sync(session, *cmd);
+        }
+
+        session->inflight = cmd;
+        ++session->inflight_serial;
+        if (cmd->reply_text && cmd->reply_capacity > 0) {
+            cmd->reply_length = 0;
+            cmd->reply_text[0] = '\0';
+        }
+        LINK_LOG(MICROWAVE_LOG_TRACE, &session->log, "tx: %.*s",
+                 static_cast<int>(cmd->length - 1), cmd->text);
+        if (std::string_view(cmd->text, cmd->length).compare(0, 10, "telemetry ") == 0) {
+            session->telemetry_hz = static_cast<uint32_t>(std::strtoul(cmd->text + 10, nullptr, 10));
+        }
+        trace_bytes(session, TraceDirection::kTx, cmd->text, cmd->length);
+        asio::async_write(session->port, asio::buffer(cmd->text, cmd->length),
+            [session](const asio::error_code& ec, std::size_t /*n*/) {
+                if (ec) {
+                    on_link_error(session, ec);
+                }
+            });
+        const uint32_t timeout_ms = cmd->timeout_ms ? cmd->timeout_ms : session->command_timeout_ms.load();
+        if (timeout_ms) {
+            session->reply_timer.expires_after(std::chrono::milliseconds(timeout_ms));
+            uint64_t serial = session->inflight_serial;
+            session->reply_timer.async_wait([session, serial](const asio::error_code& ec) {
+                if (!ec && session->inflight && session->inflight_serial == serial && !session->settling) {
+                    session->out_of_sync = true; // its reply may still be on the way
+                    complete_inflight(session, API_ERROR_TIMEOUT);
+                }
+            });
+        }
+    }
+}
+
+/**
+ * @brief Index of command in kCoalescedQueries, or -1.
+ */
+static int find_coalesced_query(std::string_view command) {
+    for (size_t i = 0; i < kCoalescedQueryCount; ++i) {
+        if (command == kCoalescedQueries[i]) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Fills in a command's line and reply expectations.
+ *
+ * @return false if the command is empty or longer than the firmware accepts.
+ */
+static bool prepare_command(PendingCommand& cmd, std::string_view command) {
+    if (command.empty() || command.size() > kMaxCommandLength) {
+        return false;
+    }
+    command.copy(cmd.text, command.size());
+    cmd.text[command.size()] = '\n';
+    cmd.length = command.size() + 1;
+    // Check if this is a command that sends two "OK" responses
+    if (command.compare(0, 5, "press") == 0 || command.compare(0, 5, "pulse") == 0) {
+        cmd.reply = PendingCommand::Reply::kPressDone;
+    } else if (command.compare(0, 4, "seq ") == 0) {
+        cmd.reply = PendingCommand::Reply::kSequenceDone;
+    } else if (command == "scan" || command.compare(0, 5, "scan ") == 0) {
+        cmd.reply = PendingCommand::Reply::kScan;
+    } else {
+        cmd.reply = PendingCommand::Reply::kFirst;
+    }
+    cmd.read_only = find_coalesced_query(command) >= 0 || command == "caps" || command.compare(0, 4, "scan") == 0;
+    return true;
+}
+
+/**
+ * @brief Rejects press/pulse/hold commands that name a key the firmware lacks.
+ *
+ * Costs no device round trip once the key map is known; without one every
+ * command is let through and the firmware decides.
+ */
+static bool key_command_is_valid(MicrowaveSession* session, std::string_view command) {
+    if (session->keys.empty()) {
+        return true;
+    }
+    size_t space = command.find(' ');
+    std::string_view verb = command.substr(0, space);
+    if (space == std::string_view::npos || (verb != "press" && verb != "pulse" && verb != "hold")) {
+        return true;
+    }
+    size_t start = command.find_first_not_of(' ', space);
+    if (start == std::string_view::npos) {
+        return true; // the firmware prints the usage
+    }
+    std::string_view key = command.substr(start, command.find(' ', start) - start);
+    if (session->keys.find(key) >= 0) {
+        return true;
+    }
+    LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Unknown key '%.*s'", static_cast<int>(key.size()), key.data());
+    return false;
+}
+
+/**
+ * @brief Queues a command on the session.
+ *
+ * Safe to call from any number of threads at once: commands are written one
+ * at a time by the session's strand and every caller gets the reply that
+ * belongs to its own command.
+ */
+static void enqueue_command(MicrowaveSession* session, PendingCommand& cmd) {
+    cmd.stop_epoch = session->stop_epoch.load();
+    if (!cmd.read_only) {
+        session->command_epoch.fetch_add(1);
+    }
+    session->queue.push(&cmd);
+    if (!session->draining.exchange(true)) {
+        asio::post(session->strand, [session]() { drain_command_queue(session); });
+    }
+}
+
+/**
+ * @brief Asynchronous form of send_raw_command for coroutines.
+ *
+ * The caller keeps cmd alive (typically in its coroutine frame) until the
+ * completion handler has run.
+ */
+template <typename CompletionToken>
+auto async_execute_command(MicrowaveSession* session, AsyncCommand& cmd, CompletionToken&& token) {
+    return asio::async_initiate<CompletionToken, void(int32_t)>(
+        [session, &cmd](auto handler) {
+            cmd.set_handler(std::move(handler), session->strand.get_inner_executor());
+            enqueue_command(session, cmd);
+        },
+        token);
+}
+
+/**
+ * @brief The core function to send any raw command string to the Arduino.
+ *
+ * This function blocks until the Arduino has fully acknowledged the
+ * command (including waiting for the *second* "OK" on a 'press' command).
+ *
+ * @param session The active session pointer.
+ * @param full_command The complete string to send (e.g., "press 1").
+ * @return API_SUCCESS on success, error code on failure.
+ */
+static int32_t send_raw_command(MicrowaveSession* session, std::string_view full_command) {
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+
+    BlockingCommand cmd;
+    if (!prepare_command(cmd, full_command) || !key_command_is_valid(session, full_command)) {
+        return API_ERROR_BAD_COMMAND;
+    }
+    try {
+        enqueue_command(session, cmd);
+    } catch (const std::exception& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in send_raw_command: %s", e.what());
+        return API_ERROR_UNKNOWN;
+    }
+    return cmd.wait();
+}
+
+/**
+ * @brief Runs one of kCoalescedQueries, sharing the exchange with every
+ *        concurrent (or, within the TTL, recent) caller of the same query.
+ *
+ * @param reply Receives the reply lines, '\n'-separated (may be nullptr).
+ */
+static int32_t send_coalesced_query(MicrowaveSession* session, int query, std::string* reply) {
+    uint32_t epoch = session->command_epoch.load();
+    std::chrono::milliseconds ttl(session->query_ttl_ms.load());
+    return session->queries[query].run(epoch, ttl, reply, [session, query](std::string& text) {
+        char buffer[kMaxQueryReply];
+        BlockingCommand cmd;
+        prepare_command(cmd, kCoalescedQueries[query]);
+        cmd.reply_text = buffer;
+        cmd.reply_capacity = sizeof(buffer);
+        try {
+            enqueue_command(session, cmd);
+        } catch (const std::exception& e) {
+            LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in send_coalesced_query: %s", e.what());
+            return API_ERROR_UNKNOWN;
+        }
+        int32_t result = cmd.wait();
+        text.assign(buffer, cmd.reply_length);
+        return result;
+    });
+}
+
+/**
+ * @brief Starts an emergency stop on behalf of waiter (any thread).
+ *
+ * Everything queued before this point is aborted rather than sent, and the
+ * stop itself bypasses the command queue by going straight to the strand.
+ * Firmware without the stop opcode gets an ordinary 'press stop' instead,
+ * sent as soon as the command in flight has finished.
+ */
+static void begin_emergency_stop(MicrowaveSession* session, PendingCommand& waiter) {
+    session->stop_epoch.fetch_add(1);
+    session->command_epoch.fetch_add(1);
+    if (!(session->features.load() & MICROWAVE_FEATURE_ESTOP)) {
+        prepare_command(waiter, "press stop");
+        enqueue_command(session, waiter);
+        return;
+    }
+    asio::post(session->strand, [session, &waiter]() { start_emergency_stop(session, &waiter); });
+}
+
+/**
+ * @brief Asynchronous form of begin_emergency_stop for coroutines.
+ */
+template <typename CompletionToken>
+auto async_emergency_stop(MicrowaveSession* session, AsyncCommand& waiter, CompletionToken&& token) {
+    return asio::async_initiate<CompletionToken, void(int32_t)>(
+        [session, &waiter](auto handler) {
+            waiter.set_handler(std::move(handler), session->strand.get_inner_executor());
+            begin_emergency_stop(session, waiter);
+        },
+        token);
+}
+
+/**
+ * @brief Drains any startup/banner noise and partial tokens from the port.
+ *
+ * Runs on the runtime thread with two timers: a max-total time and a quiet
+ * window. The calling thread blocks until every pending operation has
+ * finished, so the session can be used (or deleted) as soon as this returns.
+ *
+ * @param session The freshly opened session.
+ */
+static void drain_startup_banner(MicrowaveSession* session) {
+    struct BannerDrain {
+        MicrowaveSession* session;
+        LinkTimer max_timer;
+        LinkTimer quiet_timer;
+        LinkClock::time_point last_data;
+        std::chrono::milliseconds quiet_window{120};
+        int pending = 0;
+        bool done = false;
+        std::promise<void> finished;
+
+        explicit BannerDrain(MicrowaveSession* s)
+            : session(s), max_timer(s->port.get_executor()), quiet_timer(s->port.get_executor()),
+              last_data(LinkClock::now()) {}
+
+        void start() {
+            // Start the max total timer
+            ++pending;
+            max_timer.expires_after(std::chrono::milliseconds(400));
+            max_timer.async_wait([this](const asio::error_code& /*ec*/) {
+                finish();
+                op_done();
+            });
+            arm_quiet();
+            do_read();
+        }
+
+        // (Re)arm the quiet timer
+        void arm_quiet() {
+            ++pending;
+            quiet_timer.expires_after(quiet_window);
+            quiet_timer.async_wait([this](const asio::error_code& ec) {
+                if (!done && !ec) {
+                    if (LinkClock::now() - last_data >= quiet_window) {
+                        finish();
+                    } else {
+                        // Not quiet long enough; re-arm
+                        arm_quiet();
+                    }
+                }
+                op_done();
+            });
+        }
+
+        void do_read() {
+            ++pending;
+            session->port.async_read_some(asio::buffer(session->rx_buf, sizeof(session->rx_buf)),
+                [this](const asio::error_code& ec, std::size_t n) {
+                    if (!done) {
+                        if (!ec) {
+                            if (n > 0) {
+                                last_data = LinkClock::now();
+                            }
+                            // keep draining
+                            do_read();
+                        } else if (ec != asio::error::operation_aborted) {
+                            // unexpected error; stop
+                            finish();
+                        }
+                    }
+                    op_done();
+                });
+        }
+
+        void finish() {
+            if (done) return;
+            done = true;
+            asio::error_code ignore_ec;
+            session->port.cancel(ignore_ec);
+            max_timer.cancel();
+            quiet_timer.cancel();
+        }
+
+        void op_done() {
+            if (--pending == 0) {
+                finished.set_value();
+            }
+        }
+    };
+
+    BannerDrain drain(session);
+    std::future<void> finished = drain.finished.get_future();
+    asio::post(session->port.get_executor(), [&drain]() { drain.start(); });
+    finished.wait();
+}
+
+/**
+ * @brief Parses an "MM:SS" time string into seconds.
+ * @param time_str Input string (e.g., "01:30")
+ * @param out_seconds Output seconds (e.g., 90)
+ * @return true on success, false on invalid format or a time over 99:59.
+ */
+static bool parse_time_to_seconds(const std::string& time_str, uint32_t& out_seconds) {
+    try {
+        size_t colon_pos = time_str.find(':');
+        if (colon_pos == std::string::npos || colon_pos == 0 || colon_pos + 1 == time_str.length()) {
+            return false; // Invalid format (e.g., ":30", "1:", "130")
+        }
+
+        std::string min_str = time_str.substr(0, colon_pos);
+        std::string sec_str = time_str.substr(colon_pos + 1);
+
+        if (sec_str.length() != 2) {
+             return false; // Seconds must be two digits (e.g., "05")
+        }
+
+        // Test conversion
+        int minutes = std::stoi(min_str);
+        int seconds = std::stoi(sec_str);
+
+        if (minutes < 0 || minutes > 99 || seconds < 0 || seconds > 59) {
+            return false; // Invalid time range
+        }
+
+        out_seconds = static_cast<uint32_t>(minutes * 60 + seconds);
+        return true;
+
+    } catch (...) {
+        return false; // stoi failed (e.g., "a:30")
+    }
+}
+
+/**
+ * @brief Plans the keys for a timed run from the session's oven state and
+ *        key timings, or from idle with default timings without a session.
+ *
+ * @param start Whether to end with Start pressed; run_microwave does not.
+ * @param at_ms Plan for the oven as it will be then (steady-clock ms, 0 = now).
+ */
+static bool plan_run_for(const MicrowaveSession* session, uint32_t seconds, uint8_t power_level, bool start,
+                         KeystrokePlan& plan, uint64_t at_ms = 0) {
+    OvenState from;
+    from.mode = OvenMode::kIdle;
+    KeyTimings timings;
+    if (session) {
+        from = session->oven.load().state(at_ms ? at_ms : steady_ms(), kOvenModel);
+        timings = session->timings.load();
+    }
+    return plan_run(seconds, power_level, start, from, kOvenModel, timings, plan);
+}
+
+/**
+ * @brief Sends one command and resumes the awaiting coroutine with its result.
+ */
+static asio::awaitable<int32_t> async_send_command(MicrowaveSession* session, std::string_view command) {
+    AsyncCommand cmd;
+    if (!prepare_command(cmd, command) || !key_command_is_valid(session, command)) {
+        co_return API_ERROR_BAD_COMMAND;
+    }
+    co_return co_await async_execute_command(session, cmd, asio::use_awaitable);
+}
+
+/**
+ * @brief Presses one key by name ("start", "5", "cook_time", ...) for its
+ *        calibrated press length.
+ */
+static asio::awaitable<int32_t> async_press_key(MicrowaveSession* session, std::string_view key) {
+    AsyncCommand cmd;
+    if (key.empty() || key.size() > kMaxCommandLength || (!session->keys.empty() && session->keys.find(key) < 0)) {
+        co_return API_ERROR_BAD_COMMAND;
+    }
+    char line[kMaxCommandLength + 1];
+    const uint32_t press_ms = session->timings.load().press_ms(key_index(session, key));
+    int length = std::snprintf(line, sizeof(line), "press %.*s %u", static_cast<int>(key.size()), key.data(),
+                               static_cast<unsigned>(press_ms));
+    if (length < 0 || static_cast<size_t>(length) > kMaxCommandLength) {
+        co_return API_ERROR_BAD_COMMAND;
+    }
+    prepare_command(cmd, std::string_view(line, length));
+    co_return co_await async_execute_command(session, cmd, asio::use_awaitable);
+}
+
+/**
+ * @brief Checks every op of a batch before anything is sent.
+ *
+ * @return The index of the first invalid op, or count if all are valid.
+ */
+static size_t find_invalid_op(const microwave_op* ops, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const microwave_op& op = ops[i];
+        bool needs_key = op.opcode == MICROWAVE_OP_PRESS || op.opcode == MICROWAVE_OP_HOLD;
+        if (op.opcode < MICROWAVE_OP_PRESS || op.opcode > MICROWAVE_OP_WAIT ||
+            (needs_key && (op.key < 0 || op.key >= MICROWAVE_KEY_COUNT))) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Appends one 'seq' step, leaving out fields that match the firmware defaults.
+ */
+static int format_sequence_step(char* out, size_t capacity, int32_t key, uint32_t hold_ms, uint32_t gap_ms) {
+    if (gap_ms != kSettleMs) {
+        return std::snprintf(out, capacity, " %d:%u:%u", static_cast<int>(key), static_cast<unsigned>(hold_ms),
+                             static_cast<unsigned>(gap_ms));
+    }
+    if (hold_ms != kDefaultPressMs) {
+        return std::snprintf(out, capacity, " %d:%u", static_cast<int>(key), static_cast<unsigned>(hold_ms));
+    }
+    return std::snprintf(out, capacity, " %d", static_cast<int>(key));
+}
+
+/**
+ * @brief Runs a validated batch on the session (see execute_microwave_batch).
+ *
+ * A run of presses, with any waits between them, becomes one 'seq' line:
+ * the firmware spaces the steps itself, so the whole run costs one exchange
+ * instead of one round trip plus settle delay per key. Holds, releases and
+ * waits that do not follow a press are executed one at a time, as are
+ * presses when the firmware has no 'seq'.
+ */
+static asio::awaitable<int32_t> async_execute_batch(MicrowaveSession* session, const microwave_op* ops,
+                                                    size_t count, microwave_result* results) {
+    using Clock = LinkClock;
+    const Clock::time_point batch_start = Clock::now();
+    const uint32_t stop_epoch = session->stop_epoch.load();
+    auto offset_ms = [batch_start](Clock::time_point t) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(t - batch_start).count());
+    };
+    auto set_result = [results](size_t index, int32_t status, uint32_t start_ms, uint32_t elapsed_ms) {
+        if (results) {
+            results[index] = microwave_result{status, start_ms, elapsed_ms};
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        set_result(i, API_ERROR_ABORTED, 0, 0);
+    }
+
+    LinkTimer wait_timer(co_await asio::this_coro::executor);
+    AsyncCommand cmd;
+    char reply[256];
+    cmd.reply_text = reply;
+    cmd.reply_capacity = sizeof(reply);
+
+    size_t i = 0;
+    while (i < count) {
+        const microwave_op& op = ops[i];
+        const Clock::time_point started = Clock::now();
+        int32_t status = API_SUCCESS;
+
+        const uint32_t max_steps =
+            session->caps.seq_steps ? std::min<uint32_t>(session->caps.seq_steps, kMaxSequenceSteps) : kMaxSequenceSteps;
+        const KeyTimings timings = session->timings.load();
+        if (op.opcode == MICROWAVE_OP_PRESS && (session->features.load() & MICROWAVE_FEATURE_SEQ)) {
+            // Collect steps: each press absorbs the waits that follow it
+            struct Step { size_t op; size_t end; int32_t key; uint32_t hold_ms; uint32_t wait_ms; };
+            Step steps[kMaxSequenceSteps];
+            size_t step_count = 0;
+            size_t line_length = 3; // "seq"
+            size_t next = i;
+            char field[40];
+            while (next < count && ops[next].opcode == MICROWAVE_OP_PRESS && step_count < max_steps) {
+                Step step{next, next + 1, ops[next].key,
+                          ops[next].duration_ms ? ops[next].duration_ms : timings.press_ms(ops[next].key),
+                          ops[next].wait_ms};
+                while (step.end < count && ops[step.end].opcode == MICROWAVE_OP_WAIT) {
+                    step.wait_ms += ops[step.end].wait_ms;
+                    ++step.end;
+                }
+                // The step must fit in the firmware's line even as the last one
+                int as_last = format_sequence_step(field, sizeof(field), step.key, step.hold_ms, step.wait_ms);
+                if (line_length + as_last > kMaxCommandLength) {
+                    break;
+                }
+                line_length += format_sequence_step(field, sizeof(field), step.key, step.hold_ms,
+                                                    timings.gap_ms(step.key) + step.wait_ms);
+                steps[step_count++] = step;
+                next = step.end;
+            }
+
+            // The last step's gap is covered by the host's settle delay
+            char line[kMaxCommandLength + 1];
+            int length = std::snprintf(line, sizeof(line), "seq");
+            for (size_t k = 0; k < step_count; ++k) {
+                bool last = k + 1 == step_count;
+                length += format_sequence_step(line + length, sizeof(line) - length, steps[k].key, steps[k].hold_ms,
+                                               last ? steps[k].wait_ms : timings.gap_ms(steps[k].key) + steps[k].wait_ms);
+            }
+            prepare_command(cmd, std::string_view(line, length));
+            status = co_await async_execute_command(session, cmd, asio::use_awaitable);
+            const Clock::time_point finished = Clock::now();
+
+            // "OK: seq done <t0> <t1> ...": each step's start after the first
+            uint32_t step_start[kMaxSequenceSteps] = {};
+            if (status == API_SUCCESS) {
+                const char* done = std::strstr(reply, "OK: seq done");
+                const char* p = done ? done + 12 : "";
+                for (size_t k = 0; k < step_count; ++k) {
+                    char* end = nullptr;
+                    step_start[k] = static_cast<uint32_t>(std::strtoul(p, &end, 10));
+                    p = end;
+                }
+            }
+            for (size_t k = 0; k < step_count; ++k) {
+                uint32_t start = offset_ms(started) + step_start[k];
+                uint32_t step_end = (k + 1 < step_count) ? offset_ms(started) + step_start[k + 1]
+                                                         : offset_ms(finished);
+                uint32_t elapsed = step_end > start ? step_end - start : 0;
+                // Absorbed waits are reported separately, at the end of the step
+                uint32_t absorbed = steps[k].wait_ms - ops[steps[k].op].wait_ms;
+                set_result(steps[k].op, status, start, elapsed > absorbed ? elapsed - absorbed : 0);
+                uint32_t wait_start = step_end - std::min(absorbed, elapsed);
+                for (size_t w = steps[k].op + 1; w < steps[k].end; ++w) {
+                    set_result(w, status, wait_start, ops[w].wait_ms);
+                    wait_start += ops[w].wait_ms;
+                }
+            }
+            if (status == API_ERROR_ARDUINO_ERR && !(session->features.load() & MICROWAVE_FEATURE_SEQ)) {
+                continue; // the firmware has no 'seq' after all; nothing was pressed, so resend key by key
+            }
+            if (status != API_SUCCESS) {
+                co_return status;
+            }
+            i = next;
+            continue;
+        }
+
+        if (op.opcode == MICROWAVE_OP_PRESS) {
+            char line[kMaxCommandLength + 1];
+            const char* name = session->keys.name(op.key);
+            int length = std::snprintf(line, sizeof(line), "press %s %u", name ? name : kKeyNames[op.key],
+                                       static_cast<unsigned>(op.duration_ms ? op.duration_ms : timings.press_ms(op.key)));
+            prepare_command(cmd, std::string_view(line, length));
+            status = co_await async_execute_command(session, cmd, asio::use_awaitable);
+        } else if (op.opcode == MICROWAVE_OP_HOLD) {
+            char line[kMaxCommandLength + 1];
+            const char* name = session->keys.name(op.key);
+            int length = std::snprintf(line, sizeof(line), "hold %s", name ? name : kKeyNames[op.key]);
+            prepare_command(cmd, std::string_view(line, length));
+            status = co_await async_execute_command(session, cmd, asio::use_awaitable);
+        } else if (op.opcode == MICROWAVE_OP_RELEASE) {
+            prepare_command(cmd, "release");
+            status = co_await async_execute_command(session, cmd, asio::use_awaitable);
+        }
+        if (status == API_SUCCESS && op.wait_ms > 0) {
+            wait_timer.expires_after(std::chrono::milliseconds(op.wait_ms));
+            co_await wait_timer.async_wait(asio::as_tuple(asio::use_awaitable));
+            if (session->stop_epoch.load() != stop_epoch) {
+                status = API_ERROR_ABORTED; // stop_microwave during a host-side wait
+            }
+        }
+        set_result(i, status, offset_ms(started), offset_ms(Clock::now()) - offset_ms(started));
+        if (status != API_SUCCESS) {
+            co_return status;
+        }
+        ++i;
+    }
+    co_return API_SUCCESS;
+}
+
+/**
+ * @brief Sends a planned key sequence as a single batch.
+ */
+static asio::awaitable<int32_t> async_send_plan(MicrowaveSession* session, const KeystrokePlan& plan) {
+    if (plan.count == 0) {
+        co_return API_SUCCESS;
+    }
+    microwave_op ops[KeystrokePlan::kMaxKeys];
+    for (size_t i = 0; i < plan.count; ++i) {
+        ops[i] = microwave_op{MICROWAVE_OP_PRESS, plan.keys[i], 0, 0};
+    }
+    co_return co_await async_execute_batch(session, ops, plan.count, nullptr);
+}
+
+/**
+ * @brief Plans a run from the oven's current state and sends it.
+ *
+ * Shared by run_microwave and MicrowaveController::run. Only the keys needed
+ * from where the oven is are sent: none when the same run is already
+ * entered, a single Stop to clear a previous entry.
+ */
+static asio::awaitable<int32_t> async_run_sequence(MicrowaveSession* session, uint32_t seconds,
+                                                   uint8_t power_level) {
+    KeystrokePlan plan;
+    if (!plan_run_for(session, seconds, power_level, false, plan)) {
+        co_return API_ERROR_BAD_TIME_STR;
+    }
+    co_return co_await async_send_plan(session, plan);
+}
+
+/**
+ * @brief Sleeps until deadline, in slices so that a stop_microwave (a new
+ *        stop epoch) is noticed within kRecipeStopPoll.
+ */
+static asio::awaitable<int32_t> async_sleep_until(MicrowaveSession* session, LinkTimer& timer,
+                                                  LinkClock::time_point deadline,
+                                                  uint32_t stop_epoch) {
+    using Clock = LinkClock;
+    VirtualActivity asleep(-1, deadline);
+    while (Clock::now() < deadline) {
+        timer.expires_at(std::min(deadline, Clock::now() + kRecipeStopPoll));
+        co_await timer.async_wait(asio::as_tuple(asio::use_awaitable));
+        if (session->stop_epoch.load() != stop_epoch) {
+            co_return API_ERROR_ABORTED;
+        }
+    }
+    co_return API_SUCCESS;
+}
+
+/**
+ * @brief Executes a compiled recipe against absolute deadlines (see
+ *        run_microwave_recipe), filling in report.
+ *
+ * Deadlines are LinkClock (CLOCK_MONOTONIC) time points and the timer
+ * is armed with expires_at, so on Linux the wait ends on the reactor's
+ * timerfd at the deadline itself rather than after a relative sleep.
+ */
+static asio::awaitable<int32_t> async_run_recipe(MicrowaveSession* session, const std::vector<RecipeOp>& code,
+                                                 microwave_recipe_report& report) {
+    using Clock = LinkClock;
+    LinkTimer timer(co_await asio::this_coro::executor);
+    uint32_t stop_epoch = session->stop_epoch.load();
+    const Clock::time_point started = Clock::now();
+    Clock::time_point deadline = started;
+    uint64_t jitter_total_us = 0;
+    int32_t status = API_SUCCESS;
+    uint32_t last_line = 0;
+
+    for (const RecipeOp& op : code) {
+        last_line = op.line;
+        if (op.opcode == RecipeOpcode::kWait) {
+            deadline += std::chrono::milliseconds(op.arg);
+            continue;
+        }
+        if (op.opcode == RecipeOpcode::kAt) {
+            deadline = started + std::chrono::milliseconds(op.arg);
+            continue;
+        }
+
+        status = co_await async_sleep_until(session, timer, deadline, stop_epoch);
+        if (status != API_SUCCESS) {
+            report.error_line = op.line;
+            break;
+        }
+
+        const Clock::time_point began = Clock::now();
+        const uint32_t jitter_us = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(began - deadline).count());
+        uint32_t expected_ms = 0;
+        if (op.opcode == RecipeOpcode::kRun || op.opcode == RecipeOpcode::kEnter) {
+            KeystrokePlan plan;
+            if (!plan_run_for(session, op.arg, op.power_level, op.opcode == RecipeOpcode::kRun, plan)) {
+                status = API_ERROR_BAD_TIME_STR;
+            } else {
+                expected_ms = plan.predicted_ms;
+                status = co_await async_send_plan(session, plan);
+            }
+        } else if (op.opcode == RecipeOpcode::kPress) {
+            const int32_t key = static_cast<int32_t>(op.arg);
+            const KeyTimings timings = session->timings.load();
+            const char* name = session->keys.empty() ? kKeyNames[key] : session->keys.name(key);
+            expected_ms = timings.press_ms(key) + timings.gap_ms(key);
+            status = co_await async_press_key(session, name);
+        } else if (op.opcode == RecipeOpcode::kStop) {
+            AsyncCommand waiter;
+            status = co_await async_emergency_stop(session, waiter, asio::use_awaitable);
+            stop_epoch = session->stop_epoch.load(); // our own stop does not end the recipe
+        }
+
+        ++report.steps_run;
+        report.max_jitter_us = std::max(report.max_jitter_us, jitter_us);
+        jitter_total_us += jitter_us;
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Recipe line %u started %u us late, status %d",
+                 static_cast<unsigned>(op.line), static_cast<unsigned>(jitter_us), static_cast<int>(status));
+        if (status != API_SUCCESS) {
+            report.error_line = op.line;
+            break;
+        }
+        deadline += std::chrono::milliseconds(expected_ms);
+    }
+
+    // A trailing wait keeps the call blocked until its end
+    if (status == API_SUCCESS && !code.empty() &&
+        (code.back().opcode == RecipeOpcode::kWait || code.back().opcode == RecipeOpcode::kAt)) {
+        status = co_await async_sleep_until(session, timer, deadline, stop_epoch);
+        if (status != API_SUCCESS) {
+            report.error_line = last_line;
+        }
+    }
+
+    report.status = status;
+    report.duration_ms = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - started).count());
+    report.mean_jitter_us = report.steps_run ? static_cast<uint32_t>(jitter_total_us / report.steps_run) : 0;
+    co_return status;
+}
+
+/**
+ * @brief Sends a duty-cycle plan's actions on time (see
+ *        run_microwave_power_profile).
+ *
+ * Profile time 0 is when the first action takes effect. Each action is
+ * sent its lead ahead of its deadline: the press time for a pause or
+ * resume, and for a run the keys planned from the oven's state at that
+ * moment, which may take more Stops than the duty-cycle plan assumed.
+ * effect_ms receives when each sent action actually took effect (its
+ * completion less the pause after the key), for measuring what was
+ * delivered.
+ */
+static asio::awaitable<int32_t> async_run_duty_cycle(MicrowaveSession* session, const DutyPlan& plan,
+                                                     std::vector<uint32_t>& effect_ms) {
+    using Clock = LinkClock;
+    LinkTimer timer(co_await asio::this_coro::executor);
+    const uint32_t stop_epoch = session->stop_epoch.load();
+    // How long before its effect an action has to be sent, if sent at
+    // steady-clock send_ms
+    auto lead_of = [session](const DutyAction& action, uint64_t send_ms) -> uint32_t {
+        KeystrokePlan keys;
+        if (action.kind != DutyActionKind::kRun ||
+            !plan_run_for(session, action.seconds, action.power_level, true, keys, send_ms)) {
+            return action.lead_ms;
+        }
+        return keys.predicted_ms - session->timings.load().gap_ms(MICROWAVE_KEY_START);
+    };
+    uint32_t head_start = 0;
+    if (!plan.actions.empty()) {
+        const uint32_t lead_ms = lead_of(plan.actions[0], steady_ms());
+        head_start = lead_ms > plan.actions[0].at_ms ? lead_ms - plan.actions[0].at_ms : 0;
+    }
+    const Clock::time_point origin = Clock::now() + std::chrono::milliseconds(head_start);
+    const uint64_t origin_ms = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(origin.time_since_epoch()).count());
+
+    int32_t status = API_SUCCESS;
+    effect_ms.clear();
+    for (const DutyAction& action : plan.actions) {
+        const uint32_t lead_ms = lead_of(action, origin_ms + action.at_ms - action.lead_ms);
+        const Clock::time_point send_at =
+            origin + std::chrono::milliseconds(action.at_ms) - std::chrono::milliseconds(lead_ms);
+        status = co_await async_sleep_until(session, timer, send_at, stop_epoch);
+        if (status != API_SUCCESS) {
+            break;
+        }
+        const int32_t key = action.kind == DutyActionKind::kPause ? MICROWAVE_KEY_STOP : MICROWAVE_KEY_START;
+        if (action.kind == DutyActionKind::kRun) {
+            KeystrokePlan keys;
+            status = plan_run_for(session, action.seconds, action.power_level, true, keys)
+                         ? co_await async_send_plan(session, keys)
+                         : API_ERROR_BAD_POWER;
+        } else {
+            const char* name = session->keys.name(key);
+            status = co_await async_press_key(session, name ? name : kKeyNames[key]);
+        }
+        const Clock::time_point took_effect =
+            Clock::now() - std::chrono::milliseconds(session->timings.load().gap_ms(key));
+        effect_ms.push_back(took_effect > origin
+                                ? static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      took_effect - origin).count())
+                                : 0);
+        if (status != API_SUCCESS) {
+            break;
+        }
+    }
+    if (status == API_SUCCESS) {
+        status = co_await async_sleep_until(session, timer, origin + std::chrono::milliseconds(plan.total_ms),
+                                            stop_epoch);
+    }
+    if (status != API_SUCCESS && status != API_ERROR_ABORTED) {
+        // Do not leave the magnetron on a schedule that is no longer kept
+        AsyncCommand waiter;
+        co_await async_emergency_stop(session, waiter, asio::use_awaitable);
+    }
+    co_return status;
+}
+
+// --- Device discovery ---
+
+// Where per-firmware caches live. Empty means caching is off.
+static std::mutex g_cache_dir_mutex;
+static bool g_cache_dir_overridden = false;
+static std::filesystem::path g_cache_dir;
+
+/**
+ * @brief The cache directory: set_microwave_cache_dir, else $MD1001LB_CACHE_DIR,
+ *        else the user's cache directory.
+ */
+static std::filesystem::path cache_directory() {
+    std::lock_guard<std::mutex> lock(g_cache_dir_mutex);
+    if (g_cache_dir_overridden) {
+        return g_cache_dir;
+    }
+    if (const char* dir = std::getenv("MD1001LB_CACHE_DIR")) {
+        return dir;
+    }
+#ifdef _WIN32
+    if (const char* local = std::getenv("LOCALAPPDATA")) {
+        return std::filesystem::path(local) / "md1001lb";
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        return std::filesystem::path(xdg) / "md1001lb";
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return std::filesystem::path(home) / ".cache" / "md1001lb";
+    }
+#endif
+    return {};
+}
+
+/**
+ * @brief Cache file name for a firmware version or port: prefix plus the
+ *        value with unsafe characters replaced (empty if caching is off).
+ */
+static std::filesystem::path cache_file_path(const char* prefix, const char* value) {
+    std::filesystem::path dir = cache_directory();
+    if (dir.empty()) {
+        return {};
+    }
+    std::string file = prefix;
+    for (const char* c = value; *c; ++c) {
+        bool safe = std::isalnum(static_cast<unsigned char>(*c)) || *c == '.' || *c == '-' || *c == '_';
+        file += safe ? *c : '_';
+    }
+    return dir / (file + ".txt");
+}
+
+/**
+ * @brief Writes a cache file, creating the directory if needed (best effort).
+ */
+static void write_cache_file(const std::filesystem::path& path, const std::string& text) {
+    if (path.empty()) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << text;
+}
+
+/**
+ * @brief Reads a whole cache file ("" if it is missing or caching is off).
+ */
+static std::string read_cache_file(const std::filesystem::path& path) {
+    if (path.empty()) {
+        return {};
+    }
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Parses "Caps: version=1.1.0 line=80 ... features=seq,telemetry".
+ *
+ * Unknown keys and feature names are ignored, so newer firmware can add them.
+ *
+ * @return false if the text is not a caps reply.
+ */
+static bool parse_caps(std::string_view text, microwave_caps& caps) {
+    if (text.compare(0, 6, "Caps: ") != 0) {
+        return false;
+    }
+    caps = microwave_caps{};
+    text.remove_prefix(6);
+    text = text.substr(0, text.find('\n'));
+    while (!text.empty()) {
+        size_t end = text.find(' ');
+        std::string_view token = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+
+        size_t eq = token.find('=');
+        if (eq == std::string_view::npos) {
+            continue;
+        }
+        std::string_view key = token.substr(0, eq);
+        std::string value(token.substr(eq + 1));
+        uint32_t number = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        if (key == "version") {
+            std::snprintf(caps.firmware_version, sizeof(caps.firmware_version), "%s", value.c_str());
+        } else if (key == "id") {
+            std::snprintf(caps.device_id, sizeof(caps.device_id), "%s", value.c_str());
+        } else if (key == "line") {
+            caps.max_line = number;
+        } else if (key == "seq") {
+            caps.seq_steps = number;
+        } else if (key == "telemetry") {
+            caps.telemetry_max_hz = number;
+        } else if (key == "keys") {
+            caps.key_count = number;
+        } else if (key == "baud") {
+            caps.max_baud = number;
+        } else if (key == "features") {
+            static constexpr struct { const char* name; uint32_t bit; } kFeatures[] = {
+                {"seq", MICROWAVE_FEATURE_SEQ},       {"telemetry", MICROWAVE_FEATURE_TELEMETRY},
+                {"events", MICROWAVE_FEATURE_EVENTS}, {"estop", MICROWAVE_FEATURE_ESTOP},
+                {"list_end", MICROWAVE_FEATURE_LIST_END},
+                {"scan", MICROWAVE_FEATURE_SCAN},
+            };
+            std::string_view names = token.substr(eq + 1);
+            while (!names.empty()) {
+                size_t comma = names.find(',');
+                std::string_view name = names.substr(0, comma);
+                names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+                for (const auto& feature : kFeatures) {
+                    if (name == feature.name) {
+                        caps.features |= feature.bit;
+                    }
+                }
+            }
+        }
+    }
+    return caps.firmware_version[0] != '\0';
+}
+
+// Process-wide view of the registry file in the current cache directory.
+static std::mutex g_registry_mutex;
+static DeviceRegistry g_registry;
+
+/**
+ * @brief Runs fn(DeviceRegistry&) with the registry mapped, unless caching is off.
+ */
+template <typename Fn>
+static void with_registry(Fn&& fn) {
+    std::filesystem::path dir = cache_directory();
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    if (dir.empty()) {
+        g_registry.close();
+        return;
+    }
+    std::filesystem::path file = dir / "devices.bin";
+    if (g_registry.path() != file && !g_registry.open(file)) {
+        return;
+    }
+    fn(g_registry);
+}
+
+static void forget_device(std::string_view port) {
+    with_registry([port](DeviceRegistry& registry) { registry.forget(port); });
+}
+
+/**
+ * @brief Sends a probe on a session that is not published yet.
+ *
+ * @return The command status; reply holds the reply lines even on timeout.
+ */
+static int32_t send_probe(MicrowaveSession* session, std::string_view command, std::string& reply,
+                          uint32_t timeout_ms = kProbeTimeoutMs) {
+    char buffer[kMaxQueryReply];
+    BlockingCommand cmd;
+    prepare_command(cmd, command);
+    cmd.timeout_ms = timeout_ms;
+    cmd.reply_text = buffer;
+    cmd.reply_capacity = sizeof(buffer);
+    enqueue_command(session, cmd);
+    int32_t result = cmd.wait();
+    reply.assign(buffer, cmd.reply_length);
+    return result;
+}
+
+/**
+ * @brief Changes a session's key timings on its strand and waits (not on the
+ *        runtime thread), so the strand stays their only writer.
+ */
+template <typename Fn>
+static void update_timings(MicrowaveSession* session, Fn&& fn) {
+    std::promise<void> done;
+    asio::post(session->strand, [session, &fn, &done]() {
+        KeyTimings timings = session->timings.load();
+        fn(timings);
+        session->timings.store(timings);
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+/**
+ * @brief Publishes a recipe report from the session's strand, its only
+ *        writer, so concurrent recipes on one handle cannot tear it.
+ */
+static void store_recipe_report(MicrowaveSession* session, const microwave_recipe_report& report) {
+    if (session->strand.running_in_this_thread()) {
+        session->recipe_report.store(report);
+        return;
+    }
+    std::promise<void> done;
+    asio::post(session->strand, [session, &report, &done]() {
+        session->recipe_report.store(report);
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+/**
+ * @brief Runs a 'scan' and derives the key timings from it.
+ *
+ * Reply: "Scan: <elapsed ms> <strobes of key 0's row> <key 1's> ...".
+ */
+static int32_t calibrate_timings(MicrowaveSession* session, uint32_t window_ms) {
+    std::string reply;
+    char command[24];
+    std::snprintf(command, sizeof(command), "scan %u", static_cast<unsigned>(window_ms));
+    int32_t result = send_probe(session, command, reply, window_ms + kProbeTimeoutMs);
+    size_t at = reply.find("Scan:");
+    if (result != API_SUCCESS || at == std::string::npos) {
+        return result != API_SUCCESS ? result : API_ERROR_ARDUINO_ERR;
+    }
+    char* p = nullptr;
+    uint32_t elapsed_ms = static_cast<uint32_t>(std::strtoul(reply.c_str() + at + 5, &p, 10));
+    uint32_t strobes[MICROWAVE_KEY_COUNT] = {};
+    size_t count = 0;
+    while (count < MICROWAVE_KEY_COUNT && *p == ' ') {
+        strobes[count++] = static_cast<uint32_t>(std::strtoul(p, &p, 10));
+    }
+    update_timings(session, [&](KeyTimings& timings) { timings.calibrate(strobes, count, elapsed_ms); });
+    KeyTimings timings = session->timings.load();
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Calibrated key timing: press %u ms, gap %u ms (key 0)",
+             static_cast<unsigned>(timings.press_ms(0)), static_cast<unsigned>(timings.gap_ms(0)));
+    return API_SUCCESS;
+}
+
+/**
+ * @brief Stores a session's current key timings in its registry record.
+ */
+static void save_timings(MicrowaveSession* session) {
+    if (session->caps.device_id[0] == '\0') {
+        return;
+    }
+    KeyTimings timings = session->timings.load();
+    with_registry([session, &timings](DeviceRegistry& registry) {
+        DeviceRecord record;
+        if (registry.find(session->port_name, session->baud_rate, record) &&
+            std::strcmp(record.caps.device_id, session->caps.device_id) == 0) {
+            timings.save(record.press_ms, record.gap_ms, KeyTimings::kMaxKeys);
+            registry.store(record);
+        }
+    });
+}
+
+/**
+ * @brief Waits out a board reset by polling 'caps' (see kWarmStartTimeoutMs).
+ *
+ * @return true with the reply once the sketch answers.
+ */
+static bool probe_caps_until_ready(MicrowaveSession* session, std::string& reply) {
+    const auto deadline = LinkClock::now() + std::chrono::milliseconds(kWarmStartTimeoutMs);
+    do {
+        const auto sent = LinkClock::now();
+        if (send_probe(session, "caps", reply, kWarmProbeIntervalMs) == API_SUCCESS) {
+            return true;
+        }
+        // An answer to a garbled command (the sketch drops input while it boots) comes back at once
+        std::this_thread::sleep_until(sent + std::chrono::milliseconds(kWarmProbeIntervalMs));
+    } while (LinkClock::now() < deadline);
+    return false;
+}
+
+/**
+ * @brief Negotiates the protocol right after open.
+ *
+ * For a board in the device registry (known), one 'caps' exchange confirms
+ * that the same board with the same firmware is still on the port, and the
+ * rest comes from the record. Otherwise, or if the serial number or firmware
+ * version changed, the board is probed with 'caps' and 'list' and recorded.
+ * Firmware without 'caps' gets the plain text protocol: key by key presses,
+ * 'press stop' for stop_microwave and unchecked key names. The key table
+ * comes from the cache file for the firmware version, else from 'list'.
+ *
+ * @return false if a known board did not answer (the caller then falls back
+ *         to a cold start).
+ */
+static bool discover_device(MicrowaveSession* session, uint32_t baud_rate, const DeviceRecord* known) {
+    std::string reply;
+    if (known) {
+        if (!probe_caps_until_ready(session, reply)) {
+            LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Known board did not answer; starting cold");
+            return false;
+        }
+        if (!parse_caps(reply, session->caps) ||
+            std::strcmp(session->caps.device_id, known->caps.device_id) != 0 ||
+            std::strcmp(session->caps.firmware_version, known->caps.firmware_version) != 0) {
+            LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Board or firmware changed since last seen; probing again");
+            forget_device(session->port_name);
+            known = nullptr;
+        }
+    } else if (send_probe(session, "caps", reply) != API_SUCCESS) {
+        reply.clear();
+    }
+
+    if (!known && !parse_caps(reply, session->caps)) {
+        session->caps = microwave_caps{};
+        LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Firmware has no 'caps'; using the text protocol");
+        return true;
+    }
+    session->features = session->caps.features;
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Firmware %s on board %s, features 0x%02x",
+             session->caps.firmware_version, session->caps.device_id, static_cast<unsigned>(session->caps.features));
+
+    std::filesystem::path cache = cache_file_path("keymap-", session->caps.firmware_version);
+    if (session->keys.parse_list(read_cache_file(cache)) &&
+        (!known || session->keys.content_hash() == known->key_map_hash)) {
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Key map (%zu keys) loaded from %s",
+                 session->keys.size(), cache.string().c_str());
+    } else if (send_probe(session, "list", reply) == API_SUCCESS && session->keys.parse_list(reply)) {
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Key map (%zu keys) read from the firmware",
+                 session->keys.size());
+        write_cache_file(cache, reply);
+    } else {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Could not read the key list; key names are not checked");
+    }
+
+    // Key timing: as learned last time, else measured now
+    if (known) {
+        update_timings(session, [known](KeyTimings& timings) {
+            timings.load(known->press_ms, known->gap_ms, KeyTimings::kMaxKeys);
+        });
+    } else if ((session->features.load() & MICROWAVE_FEATURE_SCAN) &&
+               calibrate_timings(session, kDefaultScanWindowMs) != API_SUCCESS) {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Key timing calibration failed; using default timing");
+    }
+
+    DeviceRecord record{};
+    record.baud = baud_rate;
+    std::snprintf(record.port, sizeof(record.port), "%s", session->port_name.c_str());
+    record.caps = session->caps;
+    record.key_map_hash = session->keys.content_hash();
+    session->timings.load().save(record.press_ms, record.gap_ms, KeyTimings::kMaxKeys);
+    with_registry([&record](DeviceRegistry& registry) { registry.store(record); });
+    return true;
+}
+
+// --- Port Discovery ---
+
+// Ports open in this process: discovery reports them from the session
+// instead of probing them, which would steal their replies.
+struct OpenPort {
+    std::string port;
+    microwave_caps caps;
+};
+static std::mutex g_open_ports_mutex;
+static std::vector<OpenPort> g_open_ports;
+
+static void set_open_port(const std::string& port, const microwave_caps& caps) {
+    std::lock_guard<std::mutex> lock(g_open_ports_mutex);
+    for (OpenPort& open : g_open_ports) {
+        if (open.port == port) {
+            open.caps = caps;
+            return;
+        }
+    }
+    g_open_ports.push_back(OpenPort{port, caps});
+}
+
+static void clear_open_port(const std::string& port) {
+    std::lock_guard<std::mutex> lock(g_open_ports_mutex);
+    g_open_ports.erase(std::remove_if(g_open_ports.begin(), g_open_ports.end(),
+                                      [&port](const OpenPort& open) { return open.port == port; }),
+                       g_open_ports.end());
+}
+
+/**
+ * @brief The name asio needs to open a port.
+ */
+static std::string native_port_name(const std::string& port_name) {
+    // On Windows, Asio needs the \\.\ prefix for COM ports
+#ifdef _WIN32
+    if (port_name.find("COM") == 0) {
+        return "\\\\.\\" + port_name;
+    }
+#endif
+    return port_name;
+}
+
+/**
+ * @brief Ports a controller is likely to be on, sorted by name.
+ */
+static std::vector<std::string> candidate_ports() {
+    std::vector<std::string> ports;
+#ifdef _WIN32
+    char target[256];
+    for (int i = 1; i <= 256; ++i) {
+        std::string name = "COM" + std::to_string(i);
+        if (QueryDosDeviceA(name.c_str(), target, sizeof(target)) != 0) {
+            ports.push_back(name);
+        }
+    }
+#else
+#ifdef __APPLE__
+    static const char* const kPrefixes[] = {"cu.usbmodem", "cu.usbserial"};
+#else
+    static const char* const kPrefixes[] = {"ttyUSB", "ttyACM"};
+#endif
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/dev", ec)) {
+        std::string name = entry.path().filename().string();
+        for (const char* prefix : kPrefixes) {
+            if (name.compare(0, std::strlen(prefix), prefix) == 0) {
+                ports.push_back(entry.path().string());
+            }
+        }
+    }
+    std::sort(ports.begin(), ports.end());
+#endif
+    return ports;
+}
+
+/**
+ * @brief Opens a port with the link's framing (8N1 at baud_rate).
+ */
+template <typename SerialPort>
+static void open_serial_port(SerialPort& port, const std::string& port_name, uint32_t baud_rate,
+                             asio::error_code& ec) {
+    port.open(native_port_name(port_name), ec);
+    if (!ec) {
+        port.set_option(asio::serial_port_base::baud_rate(baud_rate), ec);
+    }
+    if (!ec) {
+        port.set_option(asio::serial_port_base::character_size(8), ec);
+        port.set_option(asio::serial_port_base::parity(asio::serial_port_base::parity::none), ec);
+        port.set_option(asio::serial_port_base::stop_bits(asio::serial_port_base::stop_bits::one), ec);
+    }
+    if (ec && port.is_open()) {
+        asio::error_code ignored;
+        port.close(ignored);
+    }
+}
+
+/**
+ * @brief Sends 'caps' on an open port until it answers or the deadline passes.
+ */
+template <typename SerialPort>
+static asio::awaitable<bool> probe_caps(SerialPort& port, LinkClock::time_point deadline,
+                                        microwave_caps* caps) {
+    using namespace asio::experimental::awaitable_operators;
+    LinkTimer timer(co_await asio::this_coro::executor);
+    char buffer[256];
+    std::string line;
+    auto next_probe = LinkClock::now();
+    while (LinkClock::now() < deadline) {
+        if (LinkClock::now() >= next_probe) {
+            // The leading newline ends whatever a booting sketch half-read
+            auto [write_ec, written] =
+                co_await asio::async_write(port, asio::buffer("\ncaps\n", 6), asio::as_tuple(asio::use_awaitable));
+            (void)written;
+            if (write_ec) {
+                co_return false;
+            }
+            next_probe += std::chrono::milliseconds(kWarmProbeIntervalMs);
+        }
+        timer.expires_at(std::min(next_probe, deadline));
+        auto outcome = co_await (port.async_read_some(asio::buffer(buffer), asio::as_tuple(asio::use_awaitable)) ||
+                                 timer.async_wait(asio::as_tuple(asio::use_awaitable)));
+        if (outcome.index() != 0) {
+            continue; // time to probe again
+        }
+        auto [read_ec, n] = std::get<0>(outcome);
+        if (read_ec) {
+            co_return false;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (buffer[i] == '\n') {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (parse_caps(line, *caps)) {
+                    co_return true;
+                }
+                line.clear();
+            } else if (line.size() < kMaxLineLength) {
+                line += buffer[i];
+            }
+        }
+    }
+    co_return false;
+}
+
+/**
+ * @brief Opens one port and probes it with 'caps'.
+ *
+ * Runs as one of many concurrent coroutines on the runtime thread; each has
+ * its own port and buffers.
+ */
+static asio::awaitable<bool> probe_port(std::string port_name, uint32_t baud_rate,
+                                        LinkClock::time_point deadline, microwave_caps* caps) {
+    asio::serial_port port(co_await asio::this_coro::executor);
+    asio::error_code ec;
+    open_serial_port(port, port_name, baud_rate, ec);
+    if (ec) {
+        co_return false; // missing, busy or not a serial port
+    }
+    co_return co_await probe_caps(port, deadline, caps);
+}
+
+// --- Reconnect ---
+
+/**
+ * @brief Reports a link event to the session's event callback (strand only).
+ */
+static void emit_link_event(MicrowaveSession* session, int32_t type, const char* detail) {
+    if (session->event_callback) {
+        microwave_event event{type, -1, 0, detail};
+        session->event_callback(session->log.handle, &event, session->event_user_data);
+    }
+}
+
+// --- Cook completion ---
+
+/**
+ * @brief Ends the cook being tracked (strand only): wakes wait_microwave_done
+ *        and, if it ran to the end, raises MICROWAVE_EVENT_COOK_DONE.
+ */
+static void end_cook(MicrowaveSession* session, bool done) {
+    session->cook_pending = false;
+    {
+        std::lock_guard<std::mutex> lock(session->done_mutex);
+        ++session->cooks_ended;
+        session->last_cook_done = done;
+        for (TimedWait* wait : session->done_waits) {
+            wait->release();
+        }
+        session->done_waits.clear();
+    }
+    session->done_cv.notify_all();
+    if (done) {
+        emit_link_event(session, MICROWAVE_EVENT_COOK_DONE, "");
+    }
+}
+
+/**
+ * @brief Reports a cook the wheel expired (strand only), unless a key has
+ *        since rescheduled or interrupted it.
+ */
+static void finish_cook(MicrowaveSession* session) {
+    if (session->cook_pending && !session->cook_timer.linked()) {
+        end_cook(session, true);
+    }
+}
+
+static void arm_cook_timer(LinkRuntime& rt);
+
+/**
+ * @brief Brings the wheel up to now and hands expired cooks to their
+ *        sessions' strands (runtime thread).
+ */
+static void advance_cooks(LinkRuntime& rt) {
+    TimerNode* node = rt.cooks.advance(steady_ms() / kCookTickMs);
+    while (node) {
+        TimerNode* next = node->next;
+        MicrowaveSession* session = static_cast<MicrowaveSession*>(node->owner);
+        asio::post(session->strand, [session]() { finish_cook(session); });
+        node = next;
+    }
+}
+
+/**
+ * @brief Points the runtime's timer at the wheel's next expiry, or cancels
+ *        it once the wheel is empty (runtime thread).
+ */
+static void arm_cook_timer(LinkRuntime& rt) {
+    const uint64_t tick = rt.cooks.next_expiry();
+    if (tick == rt.cook_timer_tick) {
+        return;
+    }
+    rt.cook_timer_tick = tick;
+    if (!rt.cook_timer) {
+        rt.cook_timer = std::make_unique<LinkTimer>(rt.io);
+    }
+    if (tick == TimingWheel::kNever) {
+        rt.cook_timer->cancel();
+        return;
+    }
+    rt.cook_timer->expires_at(LinkClock::time_point(std::chrono::milliseconds(tick * kCookTickMs)));
+    rt.cook_timer->async_wait([&rt](const asio::error_code& ec) {
+        if (ec == asio::error::operation_aborted) {
+            return;
+        }
+        rt.cook_timer_tick = TimingWheel::kNever;
+        advance_cooks(rt);
+        arm_cook_timer(rt);
+    });
+}
+
+/**
+ * @brief Follows the oven shadow with the session's wheel entry (strand
+ *        only): a cook that starts or resumes is scheduled for its end, one
+ *        that is paused, stopped or lost ends unfinished.
+ */
+static void update_cook_timer(MicrowaveSession* session) {
+    LinkRuntime& rt = link_runtime();
+    const uint64_t ends_ms = session->oven.load().cook_ends_ms();
+    if (ends_ms != 0 && !session->closing) {
+        advance_cooks(rt); // keeps an idle wheel from starting far behind
+        rt.cooks.schedule(&session->cook_timer, (ends_ms + kCookTickMs - 1) / kCookTickMs);
+        session->cook_pending = true;
+    } else if (session->cook_pending) {
+        rt.cooks.cancel(&session->cook_timer);
+        end_cook(session, false);
+    }
+    arm_cook_timer(rt);
+}
+
+/**
+ * @brief Chains the resync commands after a reconnect (strand only).
+ */
+static void on_resync_complete(PendingCommand* base) {
+    ResyncCommand* cmd = static_cast<ResyncCommand*>(base);
+    MicrowaveSession* session = cmd->session;
+    if (!cmd->restore_telemetry) {
+        // 'status': a replugged board has reset, so anything else is worth a warning
+        if (cmd->result == API_SUCCESS && std::strncmp(cmd->reply_buffer, "Status: idle", 12) != 0) {
+            LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Board was busy after reconnecting: %s", cmd->reply_buffer);
+        } else if (cmd->result == API_SUCCESS) {
+            microwave_status idle = session->status.load();
+            idle.active_key = -1;
+            idle.flags = 0;
+            idle.sequence_step = 0;
+            idle.sequence_length = 0;
+            session->status.store(idle);
+        }
+        if (session->telemetry_hz == 0) {
+            return;
+        }
+        char line[32];
+        int length = std::snprintf(line, sizeof(line), "telemetry %u", static_cast<unsigned>(session->telemetry_hz));
+        prepare_command(*cmd, std::string_view(line, length));
+        cmd->restore_telemetry = true;
+        cmd->stop_epoch = session->stop_epoch.load();
+        session->priority = cmd;
+        asio::post(session->strand, [session]() { drain_command_queue(session); });
+        return;
+    }
+    if (cmd->result != API_SUCCESS) {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Could not restore telemetry after reconnecting");
+    }
+}
+
+/**
+ * @brief Ends a sync probe: back in step, try again shortly, or give up on
+ *        the command that was waiting for it (strand only).
+ */
+static void on_sync_complete(PendingCommand* base) {
+    SyncCommand* sync = static_cast<SyncCommand*>(base);
+    MicrowaveSession* session = sync->session;
+    if (sync->result == API_SUCCESS && !sync->board_busy) {
+        session->out_of_sync = false;
+        LINK_LOG(MICROWAVE_LOG_DEBUG, &session->log, "Back in step after a reply timeout");
+        return;
+    }
+    if (sync->result == API_SUCCESS) {
+        // A press or sequence has yet to send its last line
+        session->sync_holdoff = true;
+        session->settle_timer.expires_after(kSyncRetryDelay);
+        session->settle_timer.async_wait([session](const asio::error_code& /*ec*/) {
+            session->sync_holdoff = false;
+            drain_command_queue(session);
+        });
+        return;
+    }
+    if (sync->result == API_ERROR_TIMEOUT && session->deferred) {
+        // No echo either: the board is not answering, so neither would it
+        PendingCommand* waiting = session->deferred;
+        session->deferred = nullptr;
+        signal_command(waiting, API_ERROR_TIMEOUT);
+    }
+}
+
+/**
+ * @brief Puts a rebound session back in service (strand only).
+ */
+static void finish_reconnect(MicrowaveSession* session, const std::string& port_name) {
+    const auto outage = LinkClock::now() - session->link_lost_at;
+    session->reconnecting = false;
+    session->link_failed = false;
+    session->out_of_sync = false; // nothing sent before the reset will answer
+    if (port_name != session->port_name) {
+        LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Board moved to %s", port_name.c_str());
+        clear_open_port(session->port_name);
+        session->port_name = port_name;
+        std::snprintf(session->log.port, sizeof(session->log.port), "%s", port_name.c_str());
+        set_open_port(session->port_name, session->caps);
+
+        DeviceRecord record{};
+        record.baud = session->baud_rate;
+        std::snprintf(record.port, sizeof(record.port), "%s", port_name.c_str());
+        record.caps = session->caps;
+        record.key_map_hash = session->keys.content_hash();
+        session->timings.load().save(record.press_ms, record.gap_ms, KeyTimings::kMaxKeys);
+        with_registry([&record](DeviceRegistry& registry) { registry.store(record); });
+    }
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Reconnected after %lld ms",
+             static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(outage).count()));
+
+    session->rx_line.clear();
+    session->frame_expected = 0;
+    read_serial(session);
+    emit_link_event(session, MICROWAVE_EVENT_RECONNECTED, session->port_name.c_str());
+
+    if (!session->stop_waiters.empty()) {
+        send_emergency_stop(session);
+    }
+    // Cached query replies describe the board before it reset
+    session->command_epoch.fetch_add(1);
+    ResyncCommand& resync = session->resync;
+    prepare_command(resync, "status");
+    resync.restore_telemetry = false;
+    resync.stop_epoch = session->stop_epoch.load();
+    resync.reply_text = resync.reply_buffer;
+    resync.reply_capacity = sizeof(resync.reply_buffer);
+    session->priority = &resync;
+    session->draining.store(true);
+    asio::post(session->strand, [session]() { drain_command_queue(session); });
+}
+
+/**
+ * @brief Fails everything waiting for the reconnect once the policy's timeout
+ *        has passed; later commands fail at once until the board is back (strand only).
+ */
+static void give_up_waiting(MicrowaveSession* session) {
+    LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Board did not come back; failing commands until it does");
+    session->link_failed = true;
+    if (!session->stop_waiters.empty()) {
+        finish_emergency_stop(session, API_ERROR_SERIAL_FAIL);
+    }
+    asio::post(session->strand, [session]() { drain_command_queue(session); });
+}
+
+// Why try_rebind did not get the board back on a path
+enum class RebindMiss : uint8_t {
+    kNotThere,   // could not be opened (yet)
+    kSilent,     // opened, but nothing answered 'caps' in time
+    kOtherBoard  // answered with another device_id
+};
+
+/**
+ * @brief Reopens the port on one path and checks that it is the same board.
+ */
+static asio::awaitable<bool> try_rebind(MicrowaveSession* session, const std::string& port_name, RebindMiss& miss) {
+    miss = RebindMiss::kNotThere;
+    asio::error_code ec;
+    open_serial_port(session->port, port_name, session->baud_rate, ec);
+    if (ec) {
+        co_return false; // not there (yet)
+    }
+    microwave_caps caps{};
+    const auto deadline = LinkClock::now() + std::chrono::milliseconds(kWarmStartTimeoutMs);
+    bool answered = co_await probe_caps(session->port, deadline, &caps);
+    if (session->closing) {
+        co_return false;
+    }
+    if (!answered || std::strcmp(caps.device_id, session->caps.device_id) != 0) {
+        miss = answered ? RebindMiss::kOtherBoard : RebindMiss::kSilent;
+        session->port.close(ec);
+        co_return false;
+    }
+    if (std::strcmp(caps.firmware_version, session->caps.firmware_version) != 0) {
+        LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Board came back with firmware %s (was %s)",
+                 caps.firmware_version, session->caps.firmware_version);
+    }
+    co_return true;
+}
+
+/**
+ * @brief Waits for the board to reappear and rebinds the session to it.
+ *
+ * Tries the port's own path, then every port node that appeared since the
+ * link was lost: on Linux, inotify on /dev and the port's directory wakes the
+ * loop as soon as a node is created; elsewhere new nodes are found by polling.
+ * Only a node that answers as another board is given up on; one that stays
+ * silent is retried with backoff, or at once on its next hot-plug event.
+ * Ends when the board is back or the session closes.
+ */
+static asio::awaitable<void> reconnect_session(MicrowaveSession* session) {
+    using namespace asio::experimental::awaitable_operators;
+    struct SilentNode {
+        std::string path;
+        LinkClock::time_point retry_at;
+        LinkClock::duration backoff;
+    };
+    std::vector<std::string> appeared;   // new nodes not yet tried, not openable yet, or silent
+    std::vector<SilentNode> silent;      // appeared nodes that did not answer, and when to try again
+    std::vector<std::string> foreign;    // nodes that answered as another board
+    auto find_silent = [&](const std::string& path) {
+        return std::find_if(silent.begin(), silent.end(), [&](const SilentNode& node) { return node.path == path; });
+    };
+    auto remember = [&](const std::string& path) {
+        auto quiet = find_silent(path);
+        if (quiet != silent.end()) {
+            silent.erase(quiet); // something happened on it; try it again now
+        }
+        if (path != session->port_name && std::find(appeared.begin(), appeared.end(), path) == appeared.end() &&
+            std::find(foreign.begin(), foreign.end(), path) == foreign.end()) {
+            appeared.push_back(path);
+        }
+    };
+
+#ifdef __linux__
+    asio::posix::stream_descriptor watch(co_await asio::this_coro::executor);
+    std::vector<std::pair<int, std::string>> watched;
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd >= 0) {
+        watch.assign(inotify_fd);
+        std::filesystem::path own_dir = std::filesystem::path(session->port_name).parent_path();
+        for (const std::string& dir : {std::string("/dev"), own_dir.string()}) {
+            int wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_CREATE | IN_ATTRIB);
+            if (wd >= 0) {
+                watched.emplace_back(wd, dir);
+            }
+        }
+    }
+    alignas(inotify_event) char events[4096];
+#else
+    std::vector<std::string> known = candidate_ports();
+#endif
+
+    while (!session->closing) {
+        if (!session->link_failed && LinkClock::now() - session->link_lost_at >=
+                                         std::chrono::milliseconds(session->reconnect_timeout_ms.load())) {
+            give_up_waiting(session);
+        }
+
+        std::vector<std::string> candidates{session->port_name};
+        candidates.insert(candidates.end(), appeared.begin(), appeared.end());
+        for (const std::string& path : candidates) {
+            auto quiet = find_silent(path);
+            if (quiet != silent.end() && LinkClock::now() < quiet->retry_at) {
+                continue;
+            }
+            RebindMiss miss = RebindMiss::kNotThere;
+            if (co_await try_rebind(session, path, miss)) {
+                finish_reconnect(session, path);
+                co_return;
+            }
+            if (session->closing) {
+                break;
+            }
+            if (path == session->port_name) {
+                continue; // always tried again
+            }
+            if (miss == RebindMiss::kOtherBoard) {
+                appeared.erase(std::find(appeared.begin(), appeared.end(), path));
+                foreign.push_back(path);
+            } else if (miss == RebindMiss::kSilent) {
+                quiet = find_silent(path);
+                if (quiet == silent.end()) {
+                    silent.push_back({path, {}, kSilentNodeRetry});
+                    quiet = silent.end() - 1;
+                } else {
+                    quiet->backoff = std::min<LinkClock::duration>(quiet->backoff * 2, kSilentNodeRetryMax);
+                }
+                quiet->retry_at = LinkClock::now() + quiet->backoff;
+            }
+        }
+        if (session->closing) {
+            break;
+        }
+
+        session->reconnect_timer.expires_after(kReconnectPollInterval);
+#ifdef __linux__
+        if (watch.is_open()) {
+            auto outcome = co_await (watch.async_read_some(asio::buffer(events), asio::as_tuple(asio::use_awaitable)) ||
+                                     session->reconnect_timer.async_wait(asio::as_tuple(asio::use_awaitable)));
+            if (outcome.index() == 0) {
+                auto [read_ec, n] = std::get<0>(outcome);
+                for (size_t at = 0; !read_ec && at + sizeof(inotify_event) <= n;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(events + at);
+                    for (const auto& [wd, dir] : watched) {
+                        if (wd == event->wd && event->len > 0) {
+                            remember((std::filesystem::path(dir) / event->name).string());
+                        }
+                    }
+                    at += sizeof(inotify_event) + event->len;
+                }
+            }
+            continue;
+        }
+#endif
+        co_await session->reconnect_timer.async_wait(asio::as_tuple(asio::use_awaitable));
+#ifndef __linux__
+        std::vector<std::string> now_present = candidate_ports();
+        for (const std::string& path : now_present) {
+            if (std::find(known.begin(), known.end(), path) == known.end()) {
+                remember(path);
+            }
+        }
+        known = std::move(now_present);
+#endif
+    }
+    session->reader_stopped.set_value();
+}
+
+/**
+ * @brief Takes a failed session offline and starts reconnect_session (strand only).
+ */
+static void start_reconnect(MicrowaveSession* session, const asio::error_code& ec) {
+    LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Serial link lost (%s); waiting for the board to come back",
+             ec.message().c_str());
+    session->reconnecting = true;
+    session->link_lost_at = LinkClock::now();
+    lose_oven_state(session);
+    ++session->reader_generation;
+    asio::error_code ignored;
+    session->port.close(ignored);
+
+    if (session->inflight && !session->settling) {
+        if (session->reconnect_policy.load() == MICROWAVE_RECONNECT_REPLAY_INFLIGHT && !session->deferred &&
+            session->inflight != &session->resync && session->inflight != &session->sync) {
+            // Sent again once the board is back, ahead of the queue
+            session->deferred = session->inflight;
+            session->inflight = nullptr;
+            ++session->inflight_serial; // disarms its reply timer
+        } else {
+            complete_inflight(session, API_ERROR_SERIAL_FAIL);
+        }
+    }
+    if (!session->stop_acked) {
+        session->stop_timer.cancel(); // the stop is resent after the reconnect
+    }
+    emit_link_event(session, MICROWAVE_EVENT_DISCONNECTED, ec.message().c_str());
+    asio::co_spawn(session->strand, reconnect_session(session), asio::detached);
+}
+
+// --- Virtual time ---
+
+/**
+ * @brief Whether the library is idle, and until when (runtime thread, which
+ *        is also where every session's strand runs).
+ */
+static bool library_idle(LinkRuntime& rt, LinkClock::time_point& until) {
+    VirtualTime& vt = virtual_time();
+    std::lock_guard<std::mutex> lock(vt.mutex);
+    if (vt.waiting < vt.callers || vt.active > 0) {
+        return false;
+    }
+    for (const MicrowaveSession* session : vt.sessions) {
+        if (session->inflight || session->stop_hold || session->reconnecting || session->draining.load()) {
+            return false;
+        }
+    }
+    until = vt.deadlines.empty() ? LinkClock::time_point::max() : *vt.deadlines.begin();
+    if (rt.cook_timer_tick != TimingWheel::kNever) {
+        until = std::min(until, LinkClock::time_point(std::chrono::milliseconds(rt.cook_timer_tick * kCookTickMs)));
+    }
+    return true;
+}
+
+static bool publish_virtual_state(LinkRuntime& rt) {
+    LinkClock::time_point until;
+    const bool idle = library_idle(rt, until);
+    if (idle) {
+        virtual_clock_idle(virtual_time().slot.load(), until);
+    } else {
+        virtual_clock_busy(virtual_time().slot.load());
+    }
+    return idle;
+}
+
+static void arm_clock_pump(LinkRuntime& rt) {
+    rt.clock_pump->expires_after(LinkWaitTraits::kVirtualPoll);
+    rt.clock_pump->async_wait([&rt](const asio::error_code& ec) {
+        if (ec || !rt.pumping) {
+            return;
+        }
+        // Decide behind whatever is already queued (a cook that ended, a
+        // recipe waking up), which may make the library busy again
+        asio::post(rt.io, [&rt]() {
+            if (!rt.pumping) {
+                return;
+            }
+            if (publish_virtual_state(rt)) {
+                advance_virtual_clock();
+            }
+            arm_clock_pump(rt);
+        });
+    });
+}
+
+/**
+ * @brief Starts publishing the library's state to the virtual clock, if
+ *        virtual time is on (runtime started, rt.mutex held).
+ */
+static void start_clock_pump(LinkRuntime& rt) {
+    if (!virtual_time().enabled.load()) {
+        return;
+    }
+    asio::post(rt.io, [&rt]() {
+        if (rt.pumping) {
+            return;
+        }
+        rt.pumping = true;
+        if (!rt.clock_pump) {
+            rt.clock_pump = std::make_unique<asio::steady_timer>(rt.io);
+        }
+        arm_clock_pump(rt);
+    });
+}
+
+/**
+ * @brief Stops the pump before the runtime winds down (rt.mutex held).
+ */
+static void stop_clock_pump(LinkRuntime& rt) {
+    asio::post(rt.io, [&rt]() {
+        rt.pumping = false;
+        if (rt.clock_pump) {
+            rt.clock_pump->cancel();
+        }
+    });
+    // Nobody publishes the callers' deadlines any more: hold the clock
+    virtual_clock_busy(virtual_time().slot.load());
+}
+
+static void add_virtual_session(MicrowaveSession* session) {
+    VirtualTime& vt = virtual_time();
+    std::lock_guard<std::mutex> lock(vt.mutex);
+    vt.sessions.push_back(session);
+}
+
+static void remove_virtual_session(MicrowaveSession* session) {
+    VirtualTime& vt = virtual_time();
+    std::lock_guard<std::mutex> lock(vt.mutex);
+    std::erase(vt.sessions, session);
+}
+
+/**
+ * @brief Runs a recipe or power profile (start() makes its coroutine) on
+ *        the session's strand and waits for it: a timed wait for the
+ *        caller, and activity for the library except while it sleeps.
+ */
+template <typename Start>
+static int32_t run_timed(MicrowaveSession* session, Start start) {
+    TimedWait wait;
+    std::future<int32_t> done = asio::co_spawn(
+        session->strand.get_inner_executor(),
+        [&wait, start]() -> asio::awaitable<int32_t> {
+            int32_t result;
+            {
+                VirtualActivity running(1);
+                result = co_await start();
+            }
+            wait.release(); // the caller is about to run again
+            co_return result;
+        },
+        asio::use_future);
+    return done.get();
+}
+
+// --- Serial trace ---
+
+/**
+ * @brief Creates a trace file for a session.
+ *
+ * @return nullptr (logged) if the file cannot be created.
+ */
+static std::unique_ptr<TraceWriter> open_trace(MicrowaveSession* session, const std::string& path) {
+    auto trace = std::make_unique<TraceWriter>();
+    if (!trace->open(path, steady_us())) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Cannot create serial trace %s", path.c_str());
+        return nullptr;
+    }
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Recording serial trace to %s", path.c_str());
+    return trace;
+}
+
+/**
+ * @brief Where $MD1001LB_TRACE_DIR records a port opened now: the port's
+ *        file name and the Unix time, e.g. "ttyUSB0-1760000000.mwtrace".
+ */
+static std::string env_trace_path(const char* dir, const std::string& port_name) {
+    std::string name = std::filesystem::path(port_name).filename().string();
+    if (name.empty()) {
+        name = "port";
+    }
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return (std::filesystem::path(dir) / (name + "-" + std::to_string(seconds) + ".mwtrace")).string();
+}
+
+// --- C-API Implementation ---
+
+// This block ensures C-style function names
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+DLL_EXPORT MicrowaveHandle open_microwave_controller(const char* port_name, uint32_t baud_rate) {
+    if (!port_name) {
+        return 0;
+    }
+    std::string port_str = native_port_name(port_name);
+
+    // Virtual time without code changes, for a single driving thread
+    if (const char* clock = std::getenv("MD1001LB_VIRTUAL_CLOCK"); clock && !virtual_time().enabled.load()) {
+        set_microwave_virtual_time(clock, 1);
+    }
+
+    // Claim a slot from the session pool, bound to the shared runtime
+    MicrowaveHandle handle = g_sessions.create(acquire_link_runtime());
+    if (handle == 0) {
+        release_link_runtime();
+        return 0; // Every slot is in use
+    }
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    session->log.handle = handle;
+    std::snprintf(session->log.port, sizeof(session->log.port), "%s", port_name);
+    session->port_name = port_name;
+    session->baud_rate = baud_rate;
+    session->resync.session = session.get();
+    session->resync.complete = &on_resync_complete;
+    session->sync.session = session.get();
+    session->sync.complete = &on_sync_complete;
+
+    DeviceRecord known{};
+    bool warm = false;
+    with_registry([&](DeviceRegistry& registry) { warm = registry.find(port_name, baud_rate, known); });
+
+    try {
+        session->port.open(port_str);
+        session->port.set_option(asio::serial_port_base::baud_rate(baud_rate));
+        session->port.set_option(asio::serial_port_base::character_size(8));
+        session->port.set_option(asio::serial_port_base::parity(asio::serial_port_base::parity::none));
+        session->port.set_option(asio::serial_port_base::stop_bits(asio::serial_port_base::stop_bits::one));
+        set_open_port(session->port_name, microwave_caps{});
+
+    } catch (const asio::system_error& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Failed to open port %s: %s", port_str.c_str(), e.what());
+        clear_open_port(session->port_name);
+        session = SessionTable::Ref();
+        g_sessions.destroy(handle, [](MicrowaveSession&) {});
+        release_link_runtime();
+        return 0; // Return NULL handle on failure
+    }
+
+    // A board from the registry is polled until it answers instead
+    if (!warm) {
+        // Wait for the Arduino to reset after connection
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+
+        // Clear any startup text from the Arduino
+        try {
+            drain_startup_banner(session.get());
+        } catch(...) {
+            // Ignore errors; best-effort drain only
+        }
+    }
+
+    // Field installations record without code changes; before the reader
+    // starts, this thread still owns the session
+    if (const char* trace_dir = std::getenv("MD1001LB_TRACE_DIR")) {
+        session->trace = open_trace(session.get(), env_trace_path(trace_dir, session->port_name));
+    }
+
+    // Fault testing without code changes, like the trace above
+    if (const char* faults = std::getenv("MD1001LB_FAULTS")) {
+        microwave_fault_profile profile{};
+        if (parse_fault_profile(faults, profile)) {
+            session->port.set_faults(profile);
+        } else {
+            LINK_LOG(MICROWAVE_LOG_WARN, &session->log, "Ignoring malformed MD1001LB_FAULTS \"%s\"", faults);
+        }
+    }
+
+    // Send a newline to ensure the Arduino parser finalizes any partial token.
+    asio::error_code newline_ec;
+    asio::write(session->port, asio::buffer("\n", 1), newline_ec);
+    trace_bytes(session.get(), TraceDirection::kTx, "\n", 1);
+
+    // From here on every byte from the Arduino goes through the session reader
+    session->reader_running = true;
+    MicrowaveSession* raw_session = session.get();
+    asio::post(session->strand, [raw_session]() { read_serial(raw_session); });
+
+    if (!discover_device(raw_session, baud_rate, warm ? &known : nullptr)) {
+        forget_device(port_name);
+        discover_device(raw_session, baud_rate, nullptr);
+    }
+    set_open_port(session->port_name, session->caps);
+    add_virtual_session(raw_session);
+
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log, "Opened at %u baud", static_cast<unsigned>(baud_rate));
+    return handle;
+}
+
+DLL_EXPORT int32_t close_microwave_controller(MicrowaveHandle handle) {
+    // Unpublishes the handle, ends calls still using it, waits for them, then
+    // frees the slot
+    bool closed = g_sessions.destroy(handle, [](MicrowaveSession& session) {
+        // Close on the strand so the reader sees operation_aborted, and fail
+        // everything a call may be blocked on: a command that never gets a
+        // reply, a recipe, a wait for the cook
+        std::promise<void> port_closed;
+        asio::post(session.strand, [&session, &port_closed]() {
+            // Ends a reconnect in progress as well
+            session.closing = true;
+            session.link_failed = true;         // queued and held commands fail
+            session.stop_epoch.fetch_add(1);    // recipes, profiles and batches end
+            session.reconnect_timer.cancel();
+            try {
+                if (session.port.is_open()) {
+                    session.port.close();
+                }
+            } catch (const asio::system_error& e) {
+                LINK_LOG(MICROWAVE_LOG_ERROR, &session.log, "Error on port close: %s", e.what());
+                // Continue to free the slot, as we can't recover
+            }
+            for (PendingCommand* waiter : session.stop_waiters) {
+                signal_command(waiter, API_ERROR_SERIAL_FAIL);
+            }
+            session.stop_waiters.clear();
+            session.stop_timer.cancel();
+            session.stop_hold = false;
+            complete_inflight(&session, API_ERROR_SERIAL_FAIL);
+            lose_oven_state(&session);          // ends a tracked cook, waking wait_microwave_done
+            // Behind a completion the wheel may already have queued
+            asio::post(session.strand, [&port_closed]() { port_closed.set_value(); });
+        });
+        port_closed.get_future().wait();
+    }, [](MicrowaveSession& session) {
+        remove_virtual_session(&session);
+        if (session.reader_running) {
+            session.reader_stopped.get_future().wait();
+        }
+        session.trace.reset();
+        save_timings(&session);
+        clear_open_port(session.port_name);
+        LINK_LOG(MICROWAVE_LOG_INFO, &session.log, "Closed");
+    });
+    if (!closed) {
+        return API_ERROR_BAD_HANDLE; // Stale, double-closed or never valid
+    }
+    release_link_runtime();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t discover_microwave_controllers(const char* const* ports, size_t port_count, uint32_t baud_rate,
+                                                  uint32_t timeout_ms, microwave_device_info* devices,
+                                                  size_t capacity, size_t* found) {
+    if ((!devices && capacity > 0) || !found) {
+        return API_ERROR_UNKNOWN;
+    }
+    std::vector<std::string> names;
+    if (ports) {
+        for (size_t i = 0; i < port_count; ++i) {
+            if (ports[i] && std::find(names.begin(), names.end(), ports[i]) == names.end()) {
+                names.emplace_back(ports[i]);
+            }
+        }
+    } else {
+        names = candidate_ports();
+    }
+
+    struct Candidate {
+        std::string port;
+        microwave_caps caps{};
+        bool in_use = false;
+        std::future<bool> answered;
+    };
+    std::vector<Candidate> candidates(names.size());
+    const auto deadline = LinkClock::now() +
+                          std::chrono::milliseconds(timeout_ms ? timeout_ms : kWarmStartTimeoutMs);
+    asio::io_context& io = acquire_link_runtime();
+    for (size_t i = 0; i < names.size(); ++i) {
+        Candidate& candidate = candidates[i];
+        candidate.port = names[i];
+        {
+            std::lock_guard<std::mutex> lock(g_open_ports_mutex);
+            for (const OpenPort& open : g_open_ports) {
+                if (open.port == candidate.port) {
+                    candidate.caps = open.caps;
+                    candidate.in_use = true;
+                }
+            }
+        }
+        if (!candidate.in_use) {
+            candidate.answered = asio::co_spawn(io, probe_port(candidate.port, baud_rate, deadline, &candidate.caps),
+                                                asio::use_future);
+        }
+    }
+
+    size_t count = 0;
+    for (Candidate& candidate : candidates) {
+        bool answered = false;
+        if (candidate.in_use) {
+            answered = candidate.caps.firmware_version[0] != '\0';
+        } else {
+            try {
+                answered = candidate.answered.get();
+            } catch (const std::exception&) {
+                answered = false;
+            }
+            if (answered) {
+                // Seed the registry so the next open skips the reset wait
+                DeviceRecord record{};
+                record.baud = baud_rate;
+                std::snprintf(record.port, sizeof(record.port), "%s", candidate.port.c_str());
+                record.caps = candidate.caps;
+                KeyMap keys;
+                if (keys.parse_list(read_cache_file(cache_file_path("keymap-", candidate.caps.firmware_version)))) {
+                    record.key_map_hash = keys.content_hash();
+                }
+                with_registry([&record](DeviceRegistry& registry) {
+                    // Keep the board's learned key timing
+                    DeviceRecord previous;
+                    if (registry.find(record.port, record.baud, previous) &&
+                        std::strcmp(previous.caps.device_id, record.caps.device_id) == 0) {
+                        std::memcpy(record.press_ms, previous.press_ms, sizeof(record.press_ms));
+                        std::memcpy(record.gap_ms, previous.gap_ms, sizeof(record.gap_ms));
+                    }
+                    registry.store(record);
+                });
+            }
+        }
+        if (!answered) {
+            continue;
+        }
+        if (count < capacity) {
+            microwave_device_info& info = devices[count];
+            info = microwave_device_info{};
+            std::snprintf(info.port, sizeof(info.port), "%s", candidate.port.c_str());
+            std::snprintf(info.device_id, sizeof(info.device_id), "%s", candidate.caps.device_id);
+            std::snprintf(info.firmware_version, sizeof(info.firmware_version), "%s",
+                          candidate.caps.firmware_version);
+            info.features = candidate.caps.features;
+            info.in_use = candidate.in_use ? 1 : 0;
+        }
+        ++count;
+    }
+    release_link_runtime();
+    *found = count;
+    return API_SUCCESS;
+}
+
+/**
+ * @brief Sends a raw command string to the Arduino.
+ *
+ * NOTE: This function sends the command *verbatim*. The caller is
+ * responsible for formatting it correctly (e.g., "press start",
+ * "hold 1", "release").
+ */
+DLL_EXPORT int32_t send_microwave_command(MicrowaveHandle handle, const char* command) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!command) {
+        return API_ERROR_UNKNOWN;
+    }
+
+    // Identical read-only queries share one exchange
+    int query = find_coalesced_query(command);
+    if (query >= 0) {
+        return send_coalesced_query(session.get(), query, nullptr);
+    }
+
+    // Pass the command string directly to the raw helper
+    return send_raw_command(session.get(), command);
+}
+
+DLL_EXPORT int32_t run_microwave(MicrowaveHandle handle, const char* time_str, uint8_t power_level) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!time_str) {
+        return API_ERROR_BAD_TIME_STR;
+    }
+
+    // 1. Parse time
+    uint32_t seconds = 0;
+    if (!parse_time_to_seconds(std::string(time_str), seconds)) {
+        return API_ERROR_BAD_TIME_STR;
+    }
+
+    // 2. Plan from the oven's state and run the keys on the session's runtime
+    // (the Stop presses the plan starts with replace assuming a clean state)
+    try {
+        std::future<int32_t> result = asio::co_spawn(
+            session->strand.get_inner_executor(),
+            async_run_sequence(session.get(), seconds, power_level),
+            asio::use_future);
+        return result.get();
+    } catch (const std::exception& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in run_microwave: %s", e.what());
+        return API_ERROR_UNKNOWN;
+    }
+}
+
+DLL_EXPORT int32_t plan_microwave_run(MicrowaveHandle handle, const char* time_str, uint8_t power_level,
+                                      microwave_plan* plan) {
+    SessionTable::Ref session;
+    if (handle != 0) {
+        session = g_sessions.acquire(handle);
+        if (!session) {
+            return API_ERROR_BAD_HANDLE;
+        }
+    }
+    if (!plan) {
+        return API_ERROR_UNKNOWN;
+    }
+    uint32_t seconds = 0;
+    KeystrokePlan planned;
+    if (!time_str || !parse_time_to_seconds(std::string(time_str), seconds) ||
+        !plan_run_for(session.get(), seconds, power_level, false, planned)) {
+        return API_ERROR_BAD_TIME_STR;
+    }
+    *plan = microwave_plan{};
+    std::copy_n(planned.keys, planned.count, plan->keys);
+    plan->key_count = static_cast<uint32_t>(planned.count);
+    plan->cook_seconds = planned.cook_seconds;
+    plan->power_level = planned.power_level;
+    plan->predicted_ms = planned.predicted_ms;
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t stop_microwave(MicrowaveHandle handle) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+
+    BlockingCommand waiter;
+    begin_emergency_stop(session.get(), waiter);
+    return waiter.wait();
+}
+
+DLL_EXPORT int32_t get_microwave_stop_latency(MicrowaveHandle handle, uint32_t* latency_us) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!latency_us) {
+        return API_ERROR_UNKNOWN;
+    }
+    *latency_us = session->last_stop_latency_us.load();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_reconnect_policy(MicrowaveHandle handle, int32_t policy, uint32_t timeout_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (policy < MICROWAVE_RECONNECT_OFF || policy > MICROWAVE_RECONNECT_REPLAY_INFLIGHT) {
+        return API_ERROR_UNKNOWN;
+    }
+    session->reconnect_policy = policy;
+    session->reconnect_timeout_ms = timeout_ms ? timeout_ms : kDefaultReconnectTimeoutMs;
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_event_callback(MicrowaveHandle handle, microwave_event_callback callback,
+                                                void* user_data) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    MicrowaveSession* raw_session = session.get();
+    auto apply = [raw_session, callback, user_data]() {
+        raw_session->event_callback = callback;
+        raw_session->event_user_data = user_data;
+    };
+    if (session->strand.running_in_this_thread()) {
+        apply(); // called from inside an event callback
+        return API_SUCCESS;
+    }
+    // Swap on the strand so no event is delivered to the old callback afterwards
+    std::promise<void> applied;
+    asio::post(session->strand, [&apply, &applied]() {
+        apply();
+        applied.set_value();
+    });
+    applied.get_future().wait();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_trace_file(MicrowaveHandle handle, const char* path) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    std::unique_ptr<TraceWriter> trace;
+    if (path && !(trace = open_trace(session.get(), path))) {
+        return API_ERROR_OPEN_FAIL;
+    }
+    // Swap on the strand; the old trace is finished here, off the I/O thread
+    MicrowaveSession* raw_session = session.get();
+    auto swap = [raw_session, &trace]() { raw_session->trace.swap(trace); };
+    if (session->strand.running_in_this_thread()) {
+        swap();
+    } else {
+        std::promise<void> swapped;
+        asio::post(session->strand, [&swap, &swapped]() {
+            swap();
+            swapped.set_value();
+        });
+        swapped.get_future().wait();
+    }
+    trace.reset();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_fault_profile(MicrowaveHandle handle, const microwave_fault_profile* profile) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    const microwave_fault_profile faults = profile ? *profile : microwave_fault_profile{};
+    // The port is strand-only; swap between two of its operations
+    MicrowaveSession* raw_session = session.get();
+    auto apply = [raw_session, &faults]() { raw_session->port.set_faults(faults); };
+    if (session->strand.running_in_this_thread()) {
+        apply();
+        return API_SUCCESS;
+    }
+    std::promise<void> applied;
+    asio::post(session->strand, [&apply, &applied]() {
+        apply();
+        applied.set_value();
+    });
+    applied.get_future().wait();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_command_timeout(MicrowaveHandle handle, uint32_t timeout_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    session->command_timeout_ms = timeout_ms;
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t query_microwave(MicrowaveHandle handle, const char* query, char* reply, uint32_t reply_capacity) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    int index = query ? find_coalesced_query(query) : -1;
+    if (index < 0) {
+        return API_ERROR_BAD_COMMAND;
+    }
+    std::string text;
+    int32_t result = send_coalesced_query(session.get(), index, reply ? &text : nullptr);
+    if (reply && reply_capacity > 0) {
+        size_t n = text.copy(reply, reply_capacity - 1);
+        reply[n] = '\0';
+    }
+    return result;
+}
+
+DLL_EXPORT int32_t set_microwave_query_ttl(MicrowaveHandle handle, uint32_t ttl_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    session->query_ttl_ms.store(ttl_ms);
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t get_microwave_query_stats(MicrowaveHandle handle, uint64_t* hits, uint64_t* misses) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!hits || !misses) {
+        return API_ERROR_UNKNOWN;
+    }
+    *hits = 0;
+    *misses = 0;
+    for (const SingleFlight& query : session->queries) {
+        uint64_t query_hits, query_misses;
+        query.stats(query_hits, query_misses);
+        *hits += query_hits;
+        *misses += query_misses;
+    }
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_cache_dir(const char* path) {
+    std::lock_guard<std::mutex> lock(g_cache_dir_mutex);
+    g_cache_dir_overridden = path != nullptr;
+    g_cache_dir = path ? path : "";
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t get_microwave_caps(MicrowaveHandle handle, microwave_caps* caps) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!caps) {
+        return API_ERROR_UNKNOWN;
+    }
+    *caps = session->caps;
+    caps->features = session->features.load();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t get_microwave_status(MicrowaveHandle handle, microwave_status* status) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!status) {
+        return API_ERROR_UNKNOWN;
+    }
+    *status = session->status.load();
+    if (status->frame_count > 0) {
+        uint32_t now_ms = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            LinkClock::now().time_since_epoch()).count());
+        status->age_ms = now_ms - status->age_ms;
+    }
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t calibrate_microwave_timing(MicrowaveHandle handle, uint32_t window_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!(session->features.load() & MICROWAVE_FEATURE_SCAN)) {
+        return API_ERROR_BAD_COMMAND;
+    }
+    window_ms = window_ms ? std::min(window_ms, kMaxScanWindowMs) : kDefaultScanWindowMs;
+    int32_t result = calibrate_timings(session.get(), window_ms);
+    if (result == API_SUCCESS) {
+        save_timings(session.get());
+    }
+    return result;
+}
+
+DLL_EXPORT int32_t get_microwave_key_timing(MicrowaveHandle handle, int32_t key, uint32_t* press_ms,
+                                            uint32_t* gap_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (key < 0 || key >= MICROWAVE_KEY_COUNT || !press_ms || !gap_ms) {
+        return API_ERROR_BAD_COMMAND;
+    }
+    KeyTimings timings = session->timings.load();
+    *press_ms = timings.press_ms(key);
+    *gap_ms = timings.gap_ms(key);
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t get_microwave_oven_state(MicrowaveHandle handle, microwave_oven_state* state) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!state) {
+        return API_ERROR_UNKNOWN;
+    }
+    OvenState now = session->oven.load().state(steady_ms(), kOvenModel);
+    static const int32_t kPublicStates[] = {
+        MICROWAVE_OVEN_UNKNOWN, MICROWAVE_OVEN_IDLE, MICROWAVE_OVEN_ENTERING_TIME, MICROWAVE_OVEN_POWER_SET,
+        MICROWAVE_OVEN_COOKING, MICROWAVE_OVEN_PAUSED, MICROWAVE_OVEN_UNKNOWN,
+    };
+    state->state = kPublicStates[static_cast<uint32_t>(now.mode)];
+    state->seconds = now.seconds;
+    state->power_level = now.power_level;
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t execute_microwave_batch(MicrowaveHandle handle, const microwave_op* ops, size_t count,
+                                           microwave_result* results) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (count == 0) {
+        return API_SUCCESS;
+    }
+    if (!ops) {
+        return API_ERROR_BAD_COMMAND;
+    }
+    size_t invalid = find_invalid_op(ops, count);
+    if (invalid != count) {
+        if (results) {
+            for (size_t i = 0; i < count; ++i) {
+                results[i] = microwave_result{i == invalid ? API_ERROR_BAD_COMMAND : API_ERROR_ABORTED, 0, 0};
+            }
+        }
+        return API_ERROR_BAD_COMMAND;
+    }
+
+    try {
+        std::future<int32_t> result = asio::co_spawn(
+            session->strand.get_inner_executor(),
+            async_execute_batch(session.get(), ops, count, results),
+            asio::use_future);
+        return result.get();
+    } catch (const std::exception& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in execute_microwave_batch: %s", e.what());
+        return API_ERROR_UNKNOWN;
+    }
+}
+
+DLL_EXPORT int32_t run_microwave_power_profile(MicrowaveHandle handle, const microwave_power_segment* segments,
+                                               size_t count, uint32_t window_seconds, int32_t mode,
+                                               microwave_power_window* windows, size_t window_capacity,
+                                               size_t* window_count) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!segments || mode < MICROWAVE_DUTY_AUTO || mode > MICROWAVE_DUTY_MIX) {
+        return API_ERROR_BAD_POWER;
+    }
+    std::vector<PowerSegment> profile(count);
+    for (size_t i = 0; i < count; ++i) {
+        profile[i] = PowerSegment{segments[i].seconds, segments[i].start_permille, segments[i].end_permille};
+    }
+    DutyPlan plan;
+    if (!plan_duty_cycle(profile.data(), count, window_seconds, static_cast<DutyMode>(mode), kOvenModel,
+                         session->timings.load(), plan)) {
+        return API_ERROR_BAD_POWER;
+    }
+
+    std::vector<uint32_t> effect_ms;
+    int32_t result;
+    try {
+        result = run_timed(session.get(), [&]() { return async_run_duty_cycle(session.get(), plan, effect_ms); });
+    } catch (const std::exception& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in run_microwave_power_profile: %s", e.what());
+        result = API_ERROR_UNKNOWN;
+    }
+
+    uint64_t target = 0;
+    uint64_t achieved = 0;
+    for (size_t i = 0; i < plan.windows.size(); ++i) {
+        const DutyWindow& window = plan.windows[i];
+        const uint32_t delivered =
+            delivered_permille(plan.actions.data(), effect_ms.data(), effect_ms.size(), window.start_ms,
+                               window.start_ms + window.length_ms, kOvenModel);
+        target += uint64_t{window.target_permille} * window.length_ms;
+        achieved += uint64_t{delivered} * window.length_ms;
+        if (windows && i < window_capacity) {
+            windows[i] = microwave_power_window{window.start_ms, window.length_ms, window.target_permille,
+                                                window.planned_permille, delivered};
+        }
+    }
+    if (window_count) {
+        *window_count = plan.windows.size();
+    }
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log,
+             "Power profile (%s, %zu windows, %zu actions): %.1f of %.1f full-power seconds, status %d",
+             plan.mode == DutyMode::kMix ? "mixed levels" : "cycled", plan.windows.size(), plan.actions.size(),
+             static_cast<double>(achieved) / 1e6, static_cast<double>(target) / 1e6, static_cast<int>(result));
+    return result;
+}
+
+DLL_EXPORT int32_t run_microwave_recipe(MicrowaveHandle handle, const char* path) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    MicrowaveSession* raw = session.get();
+    microwave_recipe_report report{};
+    report.status = API_ERROR_OPEN_FAIL;
+
+    std::string text;
+    std::ifstream in;
+    if (path) {
+        in.open(path, std::ios::binary);
+        text.resize(kMaxRecipeBytes + 1);
+        in.read(text.data(), static_cast<std::streamsize>(text.size()));
+        text.resize(static_cast<size_t>(in.gcount()));
+    }
+    if (!path || !in.eof() || in.bad()) { // unopened, unreadable or too big
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Cannot read recipe file (missing or over %u bytes)",
+                 static_cast<unsigned>(kMaxRecipeBytes));
+        store_recipe_report(raw, report);
+        return API_ERROR_OPEN_FAIL;
+    }
+
+    std::vector<RecipeOp> code;
+    RecipeError error;
+    if (!compile_recipe(text, kOvenModel, [raw](std::string_view name) { return key_index(raw, name); }, code,
+                        error)) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Recipe %s, line %u: %s", path,
+                 static_cast<unsigned>(error.line), error.message);
+        report.status = API_ERROR_BAD_COMMAND;
+        report.error_line = error.line;
+        store_recipe_report(raw, report);
+        return API_ERROR_BAD_COMMAND;
+    }
+    for (const RecipeOp& op : code) {
+        report.step_count += op.opcode != RecipeOpcode::kWait && op.opcode != RecipeOpcode::kAt;
+    }
+
+    int32_t result;
+    try {
+        result = run_timed(raw, [&]() { return async_run_recipe(raw, code, report); });
+    } catch (const std::exception& e) {
+        LINK_LOG(MICROWAVE_LOG_ERROR, &session->log, "Unknown error in run_microwave_recipe: %s", e.what());
+        result = report.status = API_ERROR_UNKNOWN;
+    }
+    LINK_LOG(MICROWAVE_LOG_INFO, &session->log,
+             "Recipe %s: %u/%u steps in %u ms, jitter max %u us mean %u us, status %d", path,
+             static_cast<unsigned>(report.steps_run), static_cast<unsigned>(report.step_count),
+             static_cast<unsigned>(report.duration_ms), static_cast<unsigned>(report.max_jitter_us),
+             static_cast<unsigned>(report.mean_jitter_us), static_cast<int>(result));
+    store_recipe_report(raw, report);
+    return result;
+}
+
+DLL_EXPORT int32_t get_microwave_recipe_report(MicrowaveHandle handle, microwave_recipe_report* report) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    if (!report) {
+        return API_ERROR_UNKNOWN;
+    }
+    *report = session->recipe_report.load();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t wait_microwave_done(MicrowaveHandle handle, uint32_t timeout_ms) {
+    SessionTable::Ref session = g_sessions.acquire(handle);
+    if (!session) {
+        return API_ERROR_BAD_HANDLE;
+    }
+    // The shadow is stored before a cook's end is counted, so reading both
+    // under the lock never misses an end
+    std::unique_lock<std::mutex> lock(session->done_mutex);
+    const uint64_t ended = session->cooks_ended;
+    const OvenMode mode = session->oven.load().state(steady_ms(), kOvenModel).mode;
+    if (mode == OvenMode::kPaused) {
+        return API_ERROR_ABORTED;
+    }
+    if (mode != OvenMode::kCooking) {
+        return API_SUCCESS;
+    }
+    // The deadline is on the LinkClock; in virtual time it may come closer
+    // by a jump while this thread sleeps, so sleep in kVirtualPoll slices
+    const LinkClock::time_point deadline = LinkClock::now() + std::chrono::milliseconds(timeout_ms);
+    TimedWait wait(deadline);
+    session->done_waits.push_back(&wait);
+    for (LinkClock::time_point now = LinkClock::now(); session->cooks_ended == ended && now < deadline;
+         now = LinkClock::now()) {
+        LinkClock::duration left = deadline - now;
+        if (virtual_time().enabled.load()) {
+            left = std::min<LinkClock::duration>(left, LinkWaitTraits::kVirtualPoll);
+        }
+        session->done_cv.wait_for(lock, left);
+    }
+    std::erase(session->done_waits, &wait);
+    if (session->cooks_ended == ended) {
+        return API_ERROR_TIMEOUT;
+    }
+    return session->last_cook_done ? API_SUCCESS : API_ERROR_ABORTED;
+}
+
+DLL_EXPORT int32_t set_microwave_virtual_time(const char* clock_path, uint32_t callers) {
+    VirtualTime& vt = virtual_time();
+    if (!attach_virtual_clock(clock_path)) {
+        return API_ERROR_OPEN_FAIL;
+    }
+    {
+        std::lock_guard<std::mutex> lock(vt.mutex);
+        vt.callers = callers ? callers : 1;
+        if (vt.slot.load() < 0) {
+            vt.slot.store(join_virtual_clock());
+        }
+        if (vt.slot.load() < 0) {
+            return API_ERROR_OPEN_FAIL; // every participant slot is taken
+        }
+    }
+    if (!vt.enabled.exchange(true)) {
+        LinkRuntime& rt = link_runtime();
+        std::lock_guard<std::mutex> lock(rt.mutex);
+        if (rt.users != 0) {
+            start_clock_pump(rt);
+        }
+    }
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t sleep_microwave(uint32_t ms) {
+    const LinkClock::time_point deadline = LinkClock::now() + std::chrono::milliseconds(ms);
+    TimedWait wait(deadline);
+    sleep_until_link(deadline);
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t get_microwave_clock(uint64_t* now_us) {
+    if (!now_us) {
+        return API_ERROR_UNKNOWN;
+    }
+    *now_us = steady_us();
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_log_level(int32_t level) {
+    if (level < MICROWAVE_LOG_TRACE || level > MICROWAVE_LOG_OFF) {
+        return API_ERROR_UNKNOWN;
+    }
+    g_link_log_level.store(level);
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_log_callback(microwave_log_callback callback, void* user_data) {
+    link_log_set_callback(callback, user_data);
+    return API_SUCCESS;
+}
+
+DLL_EXPORT int32_t set_microwave_log_file(const char* path, uint32_t max_bytes, uint32_t max_files) {
+    return link_log_set_file(path, max_bytes, max_files) ? API_SUCCESS : API_ERROR_OPEN_FAIL;
+}
+
+DLL_EXPORT int32_t flush_microwave_log(void) {
+    link_log_flush();
+    return API_SUCCESS;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+// --- C++ API Implementation ---
+
+MicrowaveController::MicrowaveController(std::string_view port_name, uint32_t baud_rate)
+    : handle_(open_microwave_controller(std::string(port_name).c_str(), baud_rate)) {}
+
+MicrowaveController::~MicrowaveController() {
+    close();
+}
+
+MicrowaveController::MicrowaveController(MicrowaveController&& other) noexcept
+    : handle_(other.release()) {}
+
+MicrowaveController& MicrowaveController::operator=(MicrowaveController&& other) noexcept {
+    if (this != &other) {
+        close();
+        handle_ = other.release();
+    }
+    return *this;
+}
+
+MicrowaveHandle MicrowaveController::release() noexcept {
+    MicrowaveHandle handle = handle_;
+    handle_ = 0;
+    return handle;
+}
+
+void MicrowaveController::close() noexcept {
+    if (handle_ != 0) {
+        close_microwave_controller(handle_);
+        handle_ = 0;
+    }
+}
+
+// Each operation pins the session in its coroutine frame, so closing the
+// controller while one is suspended waits for it to finish.
+
+asio::awaitable<int32_t> MicrowaveController::send(std::string_view command) const {
+    SessionTable::Ref session = g_sessions.acquire(handle_);
+    if (!session) {
+        co_return API_ERROR_BAD_HANDLE;
+    }
+    co_return co_await async_send_command(session.get(), command);
+}
+
+asio::awaitable<int32_t> MicrowaveController::press(std::string_view key) const {
+    SessionTable::Ref session = g_sessions.acquire(handle_);
+    if (!session) {
+        co_return API_ERROR_BAD_HANDLE;
+    }
+    co_return co_await async_press_key(session.get(), key);
+}
+
+asio::awaitable<int32_t> MicrowaveController::run(std::chrono::seconds duration, uint8_t power_level) const {
+    SessionTable::Ref session = g_sessions.acquire(handle_);
+    if (!session) {
+        co_return API_ERROR_BAD_HANDLE;
+    }
+    if (duration.count() <= 0 || duration.count() > 99 * 60 + 59) {
+        co_return API_ERROR_BAD_TIME_STR;
+    }
+    co_return co_await async_run_sequence(session.get(), static_cast<uint32_t>(duration.count()), power_level);
+}
+
+asio::awaitable<int32_t> MicrowaveController::execute(std::span<const microwave_op> ops,
+                                                       std::span<microwave_result> results) const {
+    SessionTable::Ref session = g_sessions.acquire(handle_);
+    if (!session) {
+        co_return API_ERROR_BAD_HANDLE;
+    }
+    if ((!results.empty() && results.size() != ops.size()) ||
+        find_invalid_op(ops.data(), ops.size()) != ops.size()) {
+        co_return API_ERROR_BAD_COMMAND;
+    }
+    co_return co_await async_execute_batch(session.get(), ops.data(), ops.size(),
+                                           results.empty() ? nullptr : results.data());
+}
+
+asio::awaitable<int32_t> MicrowaveController::stop() const {
+    SessionTable::Ref session = g_sessions.acquire(handle_);
+    if (!session) {
+        co_return API_ERROR_BAD_HANDLE;
+    }
+    AsyncCommand waiter;
+    co_return co_await async_emergency_stop(session.get(), waiter, asio::use_awaitable);
+}
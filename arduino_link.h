@@ -5,6 +5,7 @@
 #define MD1001LB_MICROWAVE_CONTROLLER_ARDUINO_LINK_H
 
 #include <stdint.h> // For standard integer types
+#include <stddef.h> // For size_t
 
 // Define DLL_EXPORT for Windows compilation
 #ifdef _WIN32
@@ -24,8 +25,184 @@ extern "C" {
 /**
  * @breif Opaque handle to a microwave controller instance.
  * Using intptr_t so labVIEW can treat it as a 64-bit (or 32-bit) systems.
+ * The value encodes a session slot and generation (it always fits in 31 bits);
+ * a stale, closed or made-up handle makes every call return API_ERROR_BAD_HANDLE.
  */
     typedef intptr_t MicrowaveHandle;
+/**
+ * @brief Log levels used by set_microwave_log_level and the log callback.
+ */
+    enum {
+        MICROWAVE_LOG_TRACE = 0, // every line sent and received
+        MICROWAVE_LOG_DEBUG = 1,
+        MICROWAVE_LOG_INFO = 2,  // port open/close
+        MICROWAVE_LOG_WARN = 3,  // default
+        MICROWAVE_LOG_ERROR = 4,
+        MICROWAVE_LOG_OFF = 5
+    };
+
+/**
+ * @brief Receives log records from the DLL's background log thread.
+ *
+ * @param level One of the MICROWAVE_LOG_* levels.
+ * @param handle The session the record belongs to, or 0 for global records.
+ * @param message NUL-terminated text, only valid for the duration of the call.
+ * @param user_data The pointer given to set_microwave_log_callback.
+ */
+    typedef void (*microwave_log_callback)(int32_t level, MicrowaveHandle handle, const char* message, void* user_data);
+
+/**
+ * @brief Unsolicited events reported by the firmware (or, for the link
+ *        events, by the library; their timestamp_ms is 0).
+ */
+    enum {
+        MICROWAVE_EVENT_KEY_DOWN = 0,      // key starts being driven
+        MICROWAVE_EVENT_KEY_UP = 1,        // key released
+        MICROWAVE_EVENT_SEQUENCE_DONE = 2, // a 'seq' finished
+        MICROWAVE_EVENT_ERROR = 3,         // error not tied to a command, see detail
+        MICROWAVE_EVENT_SCAN_LOST = 4,     // held key's row stopped being scanned
+        MICROWAVE_EVENT_DISCONNECTED = 5,  // port failed; reconnecting (detail: error)
+        MICROWAVE_EVENT_RECONNECTED = 6,   // board back online (detail: port)
+        MICROWAVE_EVENT_COOK_DONE = 7      // a cook ran to the end (host clock, see wait_microwave_done)
+    };
+
+/**
+ * @brief What happens when a controller's port fails (set_microwave_reconnect_policy).
+ */
+    enum {
+        MICROWAVE_RECONNECT_OFF = 0,             // fail every later call with API_ERROR_SERIAL_FAIL
+        MICROWAVE_RECONNECT_FAIL_INFLIGHT = 1,   // reconnect; the command in flight fails, queued ones wait
+        MICROWAVE_RECONNECT_REPLAY_INFLIGHT = 2  // reconnect; the command in flight is sent again
+    };
+
+/**
+ * @brief One firmware event.
+ */
+    typedef struct {
+        int32_t type;          // MICROWAVE_EVENT_*
+        int32_t key;           // MICROWAVE_KEY_* for key and scan events, otherwise -1
+        uint32_t timestamp_ms; // board clock (millis()) when it happened
+        const char* detail;    // NUL-terminated text (may be empty), valid during the call;
+                               // for key-up, the row strobes seen while pressed
+    } microwave_event;
+
+/**
+ * @brief Receives a session's firmware events.
+ *
+ * Runs on the DLL's I/O thread, in the order the events arrived. It must
+ * return quickly and must not call blocking functions of this API (they
+ * would wait for the very thread the callback is running on).
+ */
+    typedef void (*microwave_event_callback)(MicrowaveHandle handle, const microwave_event* event, void* user_data);
+
+/**
+ * @brief Flags in microwave_status.flags.
+ */
+    enum {
+        MICROWAVE_STATUS_HELD = 0x01,      // active key is held until released
+        MICROWAVE_STATUS_SEQUENCE = 0x02,  // a 'seq' is running
+        MICROWAVE_STATUS_SCAN_LOST = 0x04  // active key's row is not being scanned
+    };
+
+/**
+ * @brief Latest device state decoded from the firmware's telemetry stream.
+ */
+    typedef struct {
+        uint32_t frame_count;       // frames received so far (0 = telemetry never seen)
+        uint32_t age_ms;            // time since the frame was received
+        uint32_t board_time_ms;     // board clock (millis()) when the frame was sent
+        int32_t active_key;         // MICROWAVE_KEY_* being pressed, or -1
+        uint32_t flags;             // MICROWAVE_STATUS_*
+        uint32_t hold_remaining_ms; // time left on a timed press (saturates at 65535)
+        uint32_t sequence_step;     // next 'seq' step to run
+        uint32_t sequence_length;   // steps in the running 'seq' (0 = none)
+        uint32_t loop_count;        // firmware loop passes since the previous frame
+        uint32_t max_loop_us;       // slowest firmware loop pass since the previous frame
+    } microwave_status;
+
+/**
+ * @brief Protocol features in microwave_caps.features.
+ */
+    enum {
+        MICROWAVE_FEATURE_SEQ = 0x01,       // 'seq': whole key sequences in one exchange
+        MICROWAVE_FEATURE_TELEMETRY = 0x02, // 'telemetry <hz>' status frames
+        MICROWAVE_FEATURE_EVENTS = 0x04,    // unsolicited EVT lines
+        MICROWAVE_FEATURE_ESTOP = 0x08,     // single-byte emergency stop
+        MICROWAVE_FEATURE_LIST_END = 0x10,  // 'list' ends with "OK: <n> keys"
+        MICROWAVE_FEATURE_SCAN = 0x20       // 'scan' and strobe counts in key-up events
+    };
+
+/**
+ * @brief What the connected firmware supports, from its 'caps' reply.
+ *
+ * All zero (and an empty version) for firmware that predates 'caps'; the
+ * library then uses the plain text protocol.
+ */
+    typedef struct {
+        char firmware_version[32];
+        char device_id[16];         // serial number kept in the board's EEPROM
+        uint32_t features;          // MICROWAVE_FEATURE_* in use
+        uint32_t max_line;          // longest command line
+        uint32_t seq_steps;         // most steps per 'seq'
+        uint32_t telemetry_max_hz;
+        uint32_t key_count;
+        uint32_t max_baud;
+    } microwave_caps;
+
+/**
+ * @brief Keypad keys, numbered in the firmware's 'list' order.
+ */
+    enum {
+        MICROWAVE_KEY_COOK_TIME = 0, MICROWAVE_KEY_6, MICROWAVE_KEY_CLOCK_TIMER, MICROWAVE_KEY_AUTO_COOK,
+        MICROWAVE_KEY_START, MICROWAVE_KEY_5, MICROWAVE_KEY_DEFROST, MICROWAVE_KEY_VEGGIE,
+        MICROWAVE_KEY_STOP, MICROWAVE_KEY_4, MICROWAVE_KEY_TEST11, MICROWAVE_KEY_RICE,
+        MICROWAVE_KEY_TEST13, MICROWAVE_KEY_3, MICROWAVE_KEY_POWER, MICROWAVE_KEY_POTATO,
+        MICROWAVE_KEY_9, MICROWAVE_KEY_2, MICROWAVE_KEY_TEST24, MICROWAVE_KEY_FRZ_ENTREE,
+        MICROWAVE_KEY_8, MICROWAVE_KEY_1, MICROWAVE_KEY_TEST26, MICROWAVE_KEY_FRZ_PIZZA,
+        MICROWAVE_KEY_7, MICROWAVE_KEY_0, MICROWAVE_KEY_SOFTEN_MELT, MICROWAVE_KEY_REHEAT,
+        MICROWAVE_KEY_COUNT
+    };
+
+/**
+ * @brief Operations understood by execute_microwave_batch.
+ */
+    enum {
+        MICROWAVE_OP_PRESS = 0,   // tap key for duration_ms (0 = the key's calibrated press), then wait wait_ms
+        MICROWAVE_OP_HOLD = 1,    // hold key until MICROWAVE_OP_RELEASE, then wait wait_ms
+        MICROWAVE_OP_RELEASE = 2, // release the held key, then wait wait_ms
+        MICROWAVE_OP_WAIT = 3     // wait wait_ms
+    };
+
+/**
+ * @brief One step of a batch (plain struct so LabVIEW can pass an array of clusters).
+ */
+    typedef struct {
+        int32_t opcode;       // MICROWAVE_OP_*
+        int32_t key;          // MICROWAVE_KEY_* (PRESS and HOLD only)
+        uint32_t duration_ms; // PRESS only
+        uint32_t wait_ms;     // extra idle time after the step
+    } microwave_op;
+
+/**
+ * @brief Outcome of one batch step.
+ */
+    typedef struct {
+        int32_t status;       // 0, the failing step's error, or API_ERROR_ABORTED (-8) if not run
+        uint32_t start_ms;    // when the step started, relative to the start of the batch
+        uint32_t elapsed_ms;  // how long the step took, including its wait
+    } microwave_result;
+
+/**
+ * @brief A board found by discover_microwave_controllers.
+ */
+    typedef struct {
+        char port[96];              // pass to open_microwave_controller
+        char device_id[16];
+        char firmware_version[32];
+        uint32_t features;          // MICROWAVE_FEATURE_*
+        int32_t in_use;             // 1 if this process already has the port open
+    } microwave_device_info;
+
 /**
  * @breif  Opens a serial connection to the Arduino
  *
@@ -39,15 +216,46 @@ extern "C" {
 /**
  * @breif Closes the serial connection to the Arduino.
  *
+ * Waits for any call still running on this handle to return first.
+ *
  * @param handle The handle to the microwave controller instance.
  *
- * @return A non-zero value on success, or 0 on failure.
+ * @return 0 on success, or API_ERROR_BAD_HANDLE if the handle was already closed or is invalid.
  */
     DLL_EXPORT int32_t close_microwave_controller(MicrowaveHandle handle);
 
+/**
+ * @brief Finds every attached controller by probing candidate ports at once.
+ *
+ * Each port is opened and sent 'caps' until it answers or timeout_ms runs
+ * out, all ports in parallel, so the whole scan takes about one board reset
+ * however many ports there are. Ports that do not answer (other devices,
+ * firmware without 'caps') are left out. Ports this process already has
+ * open are reported from their session without being probed. Boards found
+ * are added to the device registry, so opening them afterwards is quick.
+ *
+ * @param ports Ports to probe, or NULL for every likely port on the machine
+ *        (/dev/ttyUSB* and /dev/ttyACM* on Linux, /dev/cu.usbmodem* and
+ *        /dev/cu.usbserial* on macOS, the COM ports on Windows).
+ * @param port_count Entries in ports (ignored when ports is NULL).
+ * @param baud_rate As for open_microwave_controller.
+ * @param timeout_ms How long to wait for a board (0 = 2500 ms).
+ * @param devices Receives up to capacity boards, in the order of ports.
+ * @param capacity Entries in devices.
+ * @param found Receives the number of boards found (may exceed capacity).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t discover_microwave_controllers(const char* const* ports, size_t port_count, uint32_t baud_rate,
+                                                      uint32_t timeout_ms, microwave_device_info* devices,
+                                                      size_t capacity, size_t* found);
+
 /**
  * @brief sends one command over serial to the microwave controller (Ex. start, stop, set power, 1, 2, 3 etc.).
  *
+ * May be called from several threads on the same handle: commands are queued
+ * and sent one at a time, and each caller gets the reply to its own command.
+ *
  * @param handle The handle to the microwave controller instance.
  * @param command The command string to send.
  *
@@ -65,18 +273,524 @@ extern "C" {
  * @param power_level The power level a percentage (0-100) counted by 10s (e.g., 10, 20, ..., 100).
  * Defaults to 100 if no value is given or invalid value is given.
  *
+ * Sends the key sequence plan_microwave_run picks, so the time may be typed
+ * as something other than the literal MM:SS (e.g. 01:30 as "90"). The oven
+ * is cleared first as far as needed (see get_microwave_oven_state).
+ *
  * @return 0 on success, non-zero on failure.
  */
     DLL_EXPORT int32_t run_microwave(MicrowaveHandle handle, const char* time_str, uint8_t power_level);
 
+/**
+ * @brief The key sequence run_microwave would send.
+ */
+typedef struct {
+    int32_t keys[24];           // MICROWAVE_KEY_*, in order
+    uint32_t key_count;
+    uint32_t cook_seconds;
+    uint32_t power_level;       // after invalid levels fall back to 100
+    uint32_t predicted_ms;      // time to send every key
+} microwave_plan;
+
+/**
+ * @brief Plans a run without sending anything.
+ *
+ * Searches the ways the oven accepts a time and power level (minutes and
+ * seconds, seconds past 59 such as "90" for 01:30, power presses) for the
+ * sequence that takes the least time to key in, and reports it with its
+ * predicted duration.
+ *
+ * @param handle A controller handle (plans from its oven state), or 0 to
+ *        plan from an idle oven.
+ * @param time_str, power_level As for run_microwave.
+ *
+ * @return 0 on success, -3 (API_ERROR_BAD_TIME_STR) for an unusable time.
+ */
+    DLL_EXPORT int32_t plan_microwave_run(MicrowaveHandle handle, const char* time_str, uint8_t power_level,
+                                          microwave_plan* plan);
+
 /**
  * @name stop
  *
  * @brief stops the microwave operation.
  *
- * @return 0 on success, non-zero on failure.
+ * Takes a fast lane past the command queue: a reserved stop byte is written
+ * immediately and the firmware presses Stop straight from its serial receive
+ * path, abandoning any press in progress. Commands that were queued or in
+ * flight on this handle (including a running run_microwave sequence) return
+ * API_ERROR_ABORTED (-8).
+ *
+ * @return 0 once the firmware confirms the Stop press, non-zero on failure.
  */
     DLL_EXPORT int32_t stop_microwave(MicrowaveHandle handle);
 
+/**
+ * @brief Reports how long the last emergency stop took on the board.
+ *
+ * @param handle The handle to the microwave controller instance.
+ * @param latency_us Receives the firmware-measured time, in microseconds, from
+ * reading the stop byte to driving the Stop key (0 if no stop was confirmed yet).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_stop_latency(MicrowaveHandle handle, uint32_t* latency_us);
+
+/**
+ * @brief Chooses how a controller recovers from a failed port (USB glitch, replug).
+ *
+ * Unless the policy is MICROWAVE_RECONNECT_OFF, a failed port does not end
+ * the handle: the library watches for the board's device node to come back
+ * (under the same or a new name, matched by the board's serial number),
+ * rebinds the handle to it, checks the board's state with 'status' and
+ * restores the telemetry rate. Commands issued meanwhile wait, up to
+ * timeout_ms, and then fail with API_ERROR_SERIAL_FAIL; the handle keeps
+ * watching and recovers whenever the board returns. stop_microwave issued
+ * while disconnected is sent as soon as the board is back. Boards whose
+ * firmware reports no serial number are never rebound.
+ *
+ * @param policy MICROWAVE_RECONNECT_* (default MICROWAVE_RECONNECT_FAIL_INFLIGHT).
+ * @param timeout_ms How long commands wait for a reconnect (0 = 10000 ms).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t set_microwave_reconnect_policy(MicrowaveHandle handle, int32_t policy, uint32_t timeout_ms);
+
+/**
+ * @brief Registers the callback that receives this controller's firmware events (NULL to remove).
+ *
+ * Once this returns the previous callback will not be called again.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t set_microwave_event_callback(MicrowaveHandle handle, microwave_event_callback callback,
+                                                    void* user_data);
+
+/**
+ * @brief Records every byte the handle sends and receives to a trace file
+ *        (NULL to stop).
+ *
+ * The file is append-only and written through a memory mapping: bytes are
+ * stored with delta-encoded microsecond timestamps in 64 KiB chunks, and
+ * stopping (or closing the handle) appends an index of the chunks. Setting
+ * $MD1001LB_TRACE_DIR records every handle from open onwards into
+ * <dir>/<port>-<unix time>.mwtrace. trace_replay plays a trace back (see
+ * README). A file already being recorded to is finished first.
+ *
+ * @return 0 on success, -4 (API_ERROR_OPEN_FAIL) if the file cannot be created.
+ */
+    DLL_EXPORT int32_t set_microwave_trace_file(MicrowaveHandle handle, const char* path);
+
+/**
+ * @brief Faults injected into a handle's serial traffic (set_microwave_fault_profile).
+ *
+ * Rates are in parts per million. Byte faults are drawn for every byte sent
+ * or received, link faults for every read or write.
+ */
+    typedef struct {
+        uint32_t seed;           // same seed and traffic, same faults
+        uint32_t drop_ppm;       // byte lost
+        uint32_t corrupt_ppm;    // byte with one bit flipped
+        uint32_t duplicate_ppm;  // byte delivered twice
+        uint32_t spike_ppm;      // read or write held back spike_ms
+        uint32_t spike_ms;
+        uint32_t stall_ppm;      // link silent both ways for stall_ms
+        uint32_t stall_ms;
+        uint32_t disconnect_ppm; // read or write fails as if the port was unplugged
+    } microwave_fault_profile;
+
+/**
+ * @brief Injects faults into everything the handle sends and receives from
+ *        now on (NULL to stop), to measure how timeouts and retries cope
+ *        with a bad link.
+ *
+ * The faults sit between the session and its port, so framing, replies,
+ * telemetry and reconnects all see them. Setting $MD1001LB_FAULTS (for
+ * example "seed=7,drop=1000,spike=5000:200,stall=500:1500", ppm and ms)
+ * applies a profile to every handle from open onwards. Keys: seed, drop,
+ * corrupt, duplicate, spike, stall, disconnect. link_bench faults measures
+ * latency and success rate under a set of profiles (see README).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t set_microwave_fault_profile(MicrowaveHandle handle, const microwave_fault_profile* profile);
+
+/**
+ * @brief Fails commands whose reply has not arrived within timeout_ms with
+ *        API_ERROR_TIMEOUT (-10), instead of waiting for it (0, the default).
+ *
+ * Only a lost reply needs this. The reply may still arrive later, so after
+ * a timeout the next command waits while the session resyncs: it sends a
+ * numbered probe and drops every line up to the probe's echo, and until then
+ * no reply is matched to a command. If the probe gets no echo within the
+ * next command's timeout, that command fails with API_ERROR_TIMEOUT too.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t set_microwave_command_timeout(MicrowaveHandle handle, uint32_t timeout_ms);
+
+/**
+ * @brief Runs a read-only query ("status", "list" or "version") and returns its reply text.
+ *
+ * Callers asking the same handle for the same query at the same time share
+ * one serial exchange; within the TTL set by set_microwave_query_ttl a
+ * recent reply is reused without any exchange. A reply is never reused
+ * across a command that may change the device state (press, hold, stop ...).
+ * send_microwave_command coalesces these queries the same way.
+ *
+ * @param handle The handle to the microwave controller instance.
+ * @param query "status", "list" or "version".
+ * @param reply Receives the reply lines, newline-separated and NUL-terminated (may be NULL).
+ * @param reply_capacity Size of reply in bytes; longer replies are truncated.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t query_microwave(MicrowaveHandle handle, const char* query, char* reply, uint32_t reply_capacity);
+
+/**
+ * @brief Sets how long a successful query reply may be reused (default 0: only in-flight queries are shared).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t set_microwave_query_ttl(MicrowaveHandle handle, uint32_t ttl_ms);
+
+/**
+ * @brief Reports how many queries were answered from a shared exchange (hits) or needed their own (misses).
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_query_stats(MicrowaveHandle handle, uint64_t* hits, uint64_t* misses);
+
+/**
+ * @brief Sets the directory for cached device data such as key maps.
+ *
+ * While opening, the library asks the firmware for its version and key list
+ * and uses the list to reject unknown key names without a round trip. The
+ * list is cached per firmware version, so later opens skip fetching it. The
+ * directory also holds the device registry (devices.bin), which lets a
+ * known board be reopened without waiting out its reset. The default
+ * directory is $MD1001LB_CACHE_DIR, else the user's cache directory.
+ *
+ * @param path The directory, "" to turn caching off, or NULL for the default.
+ *
+ * @return 0 on success.
+ */
+    DLL_EXPORT int32_t set_microwave_cache_dir(const char* path);
+
+/**
+ * @brief Reports the firmware version, limits and the protocol features in use.
+ *
+ * Probed with 'caps' on the first open of a port and cached per port after
+ * that. A feature that turns out to be missing at run time (e.g. after the
+ * board was reflashed with older firmware) is dropped and the library falls
+ * back to the text protocol.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_caps(MicrowaveHandle handle, microwave_caps* caps);
+
+/**
+ * @brief Measures how fast the oven scans its keypad and derives each key's
+ *        press length and the pause after it.
+ *
+ * Sends 'scan', which counts the oven's row strobes for window_ms without
+ * pressing anything. A key is held for 3 strobe periods and released for 2,
+ * plus a 50% margin, instead of the fixed 150 ms each. The times keep
+ * adapting from the strobe count of every press afterwards (a press that
+ * saw too few strobes lengthens that key's times again) and are kept in the
+ * device registry. A board's first open runs this automatically.
+ *
+ * @param window_ms How long to count (0 = 200 ms, at most 2000).
+ *
+ * @return 0 on success, -9 (API_ERROR_BAD_COMMAND) if the firmware has no
+ *         'scan', other non-zero values on failure.
+ */
+    DLL_EXPORT int32_t calibrate_microwave_timing(MicrowaveHandle handle, uint32_t window_ms);
+
+/**
+ * @brief Reports the press length and following pause currently used for a key.
+ *
+ * @param key MICROWAVE_KEY_*.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_key_timing(MicrowaveHandle handle, int32_t key, uint32_t* press_ms,
+                                                uint32_t* gap_ms);
+
+/**
+ * @brief Reads the device state from the last telemetry frame.
+ *
+ * Needs the stream to be turned on first, e.g.
+ * send_microwave_command(handle, "telemetry 20"). Never touches the serial
+ * port and never blocks, so it is cheap enough to poll from a UI loop.
+ *
+ * @param handle The handle to the microwave controller instance.
+ * @param status Receives the snapshot; frame_count is 0 until the first frame arrives.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_status(MicrowaveHandle handle, microwave_status* status);
+
+/**
+ * @brief What the oven is doing (microwave_oven_state.state).
+ */
+    enum {
+        MICROWAVE_OVEN_UNKNOWN = 0,       // not yet known, or keys may have been pressed by hand
+        MICROWAVE_OVEN_IDLE = 1,
+        MICROWAVE_OVEN_ENTERING_TIME = 2, // Cook Time and digits entered
+        MICROWAVE_OVEN_POWER_SET = 3,     // ... and the power level
+        MICROWAVE_OVEN_COOKING = 4,
+        MICROWAVE_OVEN_PAUSED = 5
+    };
+
+/**
+ * @brief The library's model of the oven.
+ */
+    typedef struct {
+        int32_t state;          // MICROWAVE_OVEN_*
+        uint32_t seconds;       // entered time, or time left when cooking or paused
+        uint32_t power_level;   // percent
+    } microwave_oven_state;
+
+/**
+ * @brief Reports what the library believes the oven is doing.
+ *
+ * Tracked from every key the library presses (commands, batches, runs and
+ * emergency stops); a cook counts down on the host clock. A failed press,
+ * a firmware error or scan-lost event, a lost link, or a minute without
+ * presses makes the state unknown, since the oven may have been touched
+ * by hand. run_microwave plans from this state, so it presses Stop only
+ * as often as needed and nothing at all when the same run is already
+ * entered. Never touches the serial port.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_oven_state(MicrowaveHandle handle, microwave_oven_state* state);
+
+/**
+ * @brief Executes a whole array of operations in one call.
+ *
+ * Consecutive presses (and the waits between them) are packed into as few
+ * firmware 'seq' lines as possible, so a typical run is a single serial
+ * exchange. Every op is validated before anything is sent; execution stops
+ * at the first failure.
+ *
+ * @param handle The handle to the microwave controller instance.
+ * @param ops The operations, executed in order.
+ * @param count Number of entries in ops and results.
+ * @param results Receives one entry per op (may be NULL).
+ *
+ * @return 0 if every op succeeded, otherwise the first failing op's status.
+ */
+    DLL_EXPORT int32_t execute_microwave_batch(MicrowaveHandle handle, const microwave_op* ops, size_t count,
+                                               microwave_result* results);
+
+/**
+ * @brief Part of a power profile: power ramps linearly from start_permille
+ *        to end_permille of full power over seconds (equal for a constant level).
+ */
+    typedef struct {
+        uint32_t seconds;
+        uint32_t start_permille;
+        uint32_t end_permille;
+    } microwave_power_segment;
+
+/**
+ * @brief How run_microwave_power_profile reaches power between keypad levels.
+ */
+    enum {
+        MICROWAVE_DUTY_AUTO = 0,  // whichever of the two comes closer
+        MICROWAVE_DUTY_CYCLE = 1, // cook at 100% and pause for part of each window
+        MICROWAVE_DUTY_MIX = 2    // whole magnetron cycles at the levels above and below
+    };
+
+/**
+ * @brief Average power over one window of a profile, in per mille of full power.
+ */
+    typedef struct {
+        uint32_t start_ms;            // from the start of the profile
+        uint32_t length_ms;
+        uint32_t target_permille;
+        uint32_t planned_permille;    // what the schedule delivers if every press lands on time
+        uint32_t achieved_permille;   // what it delivered, from when the presses took effect
+    } microwave_power_window;
+
+/**
+ * @brief Cooks a power profile with any average power, not just 10% steps.
+ *
+ * The profile is cut into windows, each aiming at the ramp's value at its
+ * middle. The keypad can only set 10% steps, so in between the library
+ * either cooks at 100% and pauses (Stop) and resumes (Start) for the rest
+ * of each window, to the second, or mixes whole magnetron cycles (30 s) of
+ * the levels above and below, since a level below 100% only delivers its
+ * share over whole cycles. The presses are scheduled against absolute
+ * deadlines on the library's I/O thread and sent ahead by their own press
+ * time, so each lands on its deadline. Blocks until the profile is done;
+ * stop_microwave ends it. If it fails for any other reason the oven is
+ * stopped.
+ *
+ * @param segments, count The profile, at most 99:59 in total.
+ * @param window_seconds Averaging window (0 = one magnetron cycle).
+ * @param mode MICROWAVE_DUTY_*.
+ * @param windows Receives up to window_capacity windows with the target,
+ *        planned and achieved power (may be NULL).
+ * @param window_count Receives the number of windows in the profile (may be NULL).
+ *
+ * @return 0 on success, -5 (API_ERROR_BAD_POWER) for an unusable profile,
+ *         -8 (API_ERROR_ABORTED) if stopped, other non-zero values on failure.
+ */
+    DLL_EXPORT int32_t run_microwave_power_profile(MicrowaveHandle handle, const microwave_power_segment* segments,
+                                                   size_t count, uint32_t window_seconds, int32_t mode,
+                                                   microwave_power_window* windows, size_t window_capacity,
+                                                   size_t* window_count);
+
+/**
+ * @brief How the last recipe on a handle went.
+ */
+    typedef struct {
+        int32_t status;           // 0, or the error that ended the recipe
+        uint32_t error_line;      // recipe line of the compile error or failed step, 0 if none
+        uint32_t step_count;      // steps that press keys or stop (waits are not steps)
+        uint32_t steps_run;
+        uint32_t duration_ms;     // from the start of the recipe to the end of its last step
+        uint32_t max_jitter_us;   // latest any step started after its deadline
+        uint32_t mean_jitter_us;
+    } microwave_recipe_report;
+
+/**
+ * @brief Runs a cooking recipe file.
+ *
+ * A recipe is a list of statements separated by newlines or ';' ('#'
+ * starts a comment), e.g. "run 1:30 @50; wait 45s; stop":
+ *
+ *   run <time> [@<power>]    enter time and power the quickest way and press Start
+ *   enter <time> [@<power>]  the same without Start, like run_microwave
+ *   press <key>              press one key by name
+ *   stop                     emergency stop, as stop_microwave
+ *   wait <duration>          pause before the next step ("45s", "1m30s", "250ms", "1:30")
+ *   at <duration>            start the next step this long after the recipe began
+ *
+ * The whole file is compiled before anything is sent. Steps are then
+ * scheduled on one monotonic timeline: a step's deadline is the previous
+ * step's deadline plus its predicted duration plus any wait, so a slow
+ * step delays only the step right after it and time spent in calls never
+ * accumulates. get_microwave_recipe_report gives how late steps started.
+ * stop_microwave from another thread ends the recipe.
+ *
+ * @param path Recipe file, at most 64 KiB.
+ *
+ * @return 0 on success, -4 (API_ERROR_OPEN_FAIL) if the file cannot be read,
+ *         -9 (API_ERROR_BAD_COMMAND) if it does not compile (the line is
+ *         logged and reported), -8 (API_ERROR_ABORTED) if stopped, otherwise
+ *         the failing step's status.
+ */
+    DLL_EXPORT int32_t run_microwave_recipe(MicrowaveHandle handle, const char* path);
+
+/**
+ * @brief Reports how the last run_microwave_recipe on the handle went.
+ *
+ * @return 0 on success, non-zero on failure.
+ */
+    DLL_EXPORT int32_t get_microwave_recipe_report(MicrowaveHandle handle, microwave_recipe_report* report);
+
+/**
+ * @brief Waits for the cook in progress to finish.
+ *
+ * The end of a cook is predicted from the oven state (see
+ * get_microwave_oven_state) when Start is pressed, and moves with every
+ * key that changes it. Every handle's cooks share one timing wheel on the
+ * library's thread, at 10 ms resolution, so tracking costs nothing per
+ * open oven while it cooks. When a cook runs to the end the event callback
+ * also receives MICROWAVE_EVENT_COOK_DONE. Closing the handle waits for
+ * this call to return.
+ *
+ * @param timeout_ms Longest wait.
+ *
+ * @return 0 when the cook finished or the oven is not cooking, -8
+ *         (API_ERROR_ABORTED) if it was paused, stopped or its state was lost,
+ *         -10 (API_ERROR_TIMEOUT) if it is still cooking at timeout_ms.
+ */
+    DLL_EXPORT int32_t wait_microwave_done(MicrowaveHandle handle, uint32_t timeout_ms);
+
+/**
+ * @brief Runs the library on a virtual clock shared with the emulator, so
+ *        simulated cooks take as long as the work between their waits.
+ *
+ * Every process that attaches clock_path (md1001lb_emulator --clock, or
+ * $MD1001LB_VIRTUAL_CLOCK) reads the same time. Real time keeps flowing,
+ * and whenever all of them are idle the clock jumps to the earliest
+ * deadline any of them waits for, so every event still happens in order at
+ * its own time. The library is idle while all calling threads are blocked
+ * in run_microwave_recipe, run_microwave_power_profile, wait_microwave_done
+ * or sleep_microwave and no command is on the link; any other call, a key
+ * press on the emulator or telemetry keeps the clock in real time. Timing
+ * reports and timeouts follow the virtual clock; log stamps stay wall time.
+ *
+ * Call before opening controllers; it cannot be turned off. For emulated
+ * ovens on POSIX hosts: a real oven does not skip time.
+ * $MD1001LB_VIRTUAL_CLOCK turns it on at the first open with one caller.
+ *
+ * @param clock_path The clock file, created if missing.
+ * @param callers Threads that drive the simulation (0 means 1): the clock
+ *        only jumps while all of them wait.
+ *
+ * @return 0 on success, -4 (API_ERROR_OPEN_FAIL) if the file cannot be
+ *         mapped, another clock is attached or the clock has no free slot.
+ */
+    DLL_EXPORT int32_t set_microwave_virtual_time(const char* clock_path, uint32_t callers);
+
+/**
+ * @brief Sleeps on the library's clock: real time, or virtual time that
+ *        may jump ahead while the caller sleeps.
+ *
+ * @return 0.
+ */
+    DLL_EXPORT int32_t sleep_microwave(uint32_t ms);
+
+/**
+ * @brief Reads the library's clock in microseconds (CLOCK_MONOTONIC plus
+ *        any time the virtual clock skipped).
+ *
+ * @return 0 on success, non-zero if now_us is NULL.
+ */
+    DLL_EXPORT int32_t get_microwave_clock(uint64_t* now_us);
+
+/**
+ * @brief Sets the minimum level that is logged (default MICROWAVE_LOG_WARN).
+ *
+ * Records below the level cost only a compare at the call site.
+ *
+ * @return 0 on success, non-zero if the level is out of range.
+ */
+    DLL_EXPORT int32_t set_microwave_log_level(int32_t level);
+
+/**
+ * @brief Registers a callback that receives every log record (NULL to remove).
+ *
+ * Records are buffered and delivered from a background thread, never from
+ * the thread that logged them. While no callback and no log file are set,
+ * records go to stderr.
+ *
+ * @return 0 on success.
+ */
+    DLL_EXPORT int32_t set_microwave_log_callback(microwave_log_callback callback, void* user_data);
+
+/**
+ * @brief Appends log records to a file, rotating it when it grows too large.
+ *
+ * @param path The log file path, or NULL to stop logging to a file.
+ * @param max_bytes Rotate once the file would exceed this size (0 = never).
+ * @param max_files Number of rotated files kept as path.1 ... path.N.
+ *
+ * @return 0 on success, non-zero if the file cannot be opened.
+ */
+    DLL_EXPORT int32_t set_microwave_log_file(const char* path, uint32_t max_bytes, uint32_t max_files);
+
+/**
+ * @brief Delivers every buffered log record before returning.
+ *
+ * @return 0 on success.
+ */
+    DLL_EXPORT int32_t flush_microwave_log(void);
+
 }
 #endif //MD1001LB_MICROWAVE_CONTROLLER_ARDUINO_LINK_H
\ No newline at end of file
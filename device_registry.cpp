@@ -0,0 +1,195 @@
+//
+// Device registry file mapping and record management.
+//
+
+#include "device_registry.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'W', 'D', 'E', 'V', 'R', 'E', 'G'};
+// Bump whenever DeviceRecord or microwave_caps changes shape
+constexpr uint32_t kLayoutVersion = 2;
+
+bool port_equals(const char* stored, std::string_view port) {
+    return std::strlen(stored) == port.size() && std::memcmp(stored, port.data(), port.size()) == 0;
+}
+
+} // namespace
+
+struct DeviceRegistry::FileLayout {
+    char magic[8];
+    uint32_t layout_version;
+    uint32_t capacity;
+    uint32_t record_size;
+    uint32_t reserved;
+    DeviceRecord records[kCapacity];
+};
+
+bool DeviceRegistry::open(const std::filesystem::path& file) {
+    close();
+    std::error_code ec;
+    std::filesystem::create_directories(file.parent_path(), ec);
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    // Mapping a file larger than its size grows it (zero-filled)
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READWRITE, 0, sizeof(FileLayout), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(FileLayout)) : nullptr;
+    if (!view) {
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+    file_handle_ = handle;
+    mapping_ = mapping;
+#else
+    int fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 ||
+        (static_cast<size_t>(info.st_size) < sizeof(FileLayout) && ftruncate(fd, sizeof(FileLayout)) != 0)) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, sizeof(FileLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+#endif
+    file_ = static_cast<FileLayout*>(view);
+    path_ = file;
+
+    lock();
+    if (std::memcmp(file_->magic, kMagic, sizeof(kMagic)) != 0 || file_->layout_version != kLayoutVersion ||
+        file_->capacity != kCapacity || file_->record_size != sizeof(DeviceRecord)) {
+        std::memset(static_cast<void*>(file_), 0, sizeof(FileLayout));
+        std::memcpy(file_->magic, kMagic, sizeof(kMagic));
+        file_->layout_version = kLayoutVersion;
+        file_->capacity = kCapacity;
+        file_->record_size = sizeof(DeviceRecord);
+    }
+    unlock();
+    return true;
+}
+
+void DeviceRegistry::close() {
+    if (!file_) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(file_);
+    CloseHandle(static_cast<HANDLE>(mapping_));
+    CloseHandle(static_cast<HANDLE>(file_handle_));
+    mapping_ = nullptr;
+    file_handle_ = nullptr;
+#else
+    munmap(file_, sizeof(FileLayout));
+    ::close(fd_);
+    fd_ = -1;
+#endif
+    file_ = nullptr;
+    path_.clear();
+}
+
+void DeviceRegistry::lock() {
+#ifdef _WIN32
+    OVERLAPPED whole{};
+    LockFileEx(static_cast<HANDLE>(file_handle_), LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole);
+#else
+    while (flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+void DeviceRegistry::unlock() {
+#ifdef _WIN32
+    OVERLAPPED whole{};
+    UnlockFileEx(static_cast<HANDLE>(file_handle_), 0, MAXDWORD, MAXDWORD, &whole);
+#else
+    flock(fd_, LOCK_UN);
+#endif
+}
+
+bool DeviceRegistry::find(std::string_view port, uint32_t baud, DeviceRecord& record) {
+    if (!file_) {
+        return false;
+    }
+    bool found = false;
+    lock();
+    for (const DeviceRecord& candidate : file_->records) {
+        if (candidate.in_use && candidate.baud == baud && port_equals(candidate.port, port)) {
+            record = candidate;
+            found = true;
+            break;
+        }
+    }
+    unlock();
+    return found;
+}
+
+void DeviceRegistry::store(const DeviceRecord& record) {
+    if (!file_) {
+        return;
+    }
+    lock();
+    DeviceRecord* slot = nullptr;
+    for (DeviceRecord& candidate : file_->records) {
+        if (!candidate.in_use) {
+            continue;
+        }
+        if (port_equals(candidate.port, record.port) ||
+            std::strcmp(candidate.caps.device_id, record.caps.device_id) == 0) {
+            candidate.in_use = 0;
+        }
+    }
+    for (DeviceRecord& candidate : file_->records) {
+        if (!candidate.in_use) {
+            slot = &candidate;
+            break;
+        }
+        if (!slot || candidate.last_seen < slot->last_seen) {
+            slot = &candidate;
+        }
+    }
+    *slot = record;
+    slot->in_use = 1;
+    slot->last_seen = static_cast<uint64_t>(std::time(nullptr));
+    unlock();
+}
+
+void DeviceRegistry::forget(std::string_view port) {
+    if (!file_) {
+        return;
+    }
+    lock();
+    for (DeviceRecord& candidate : file_->records) {
+        if (candidate.in_use && port_equals(candidate.port, port)) {
+            candidate.in_use = 0;
+        }
+    }
+    unlock();
+}
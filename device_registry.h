@@ -0,0 +1,92 @@
+//
+// Memory-mapped registry of controllers this machine has talked to, shared
+// by every process that uses the DLL.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_DEVICE_REGISTRY_H
+#define MD1001LB_MICROWAVE_CONTROLLER_DEVICE_REGISTRY_H
+
+#include "arduino_link.h"
+#include "key_timing.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+/**
+ * @brief What a previous process learned about one board.
+ *
+ * Stored as is in the registry file, so only fixed-size fields.
+ */
+struct DeviceRecord {
+    uint32_t in_use;
+    uint32_t baud;
+    char port[96];
+    microwave_caps caps;        // includes the board's serial number and firmware version
+    uint32_t key_map_hash;      // KeyMap::content_hash of the board's key list
+    uint16_t press_ms[KeyTimings::kMaxKeys];  // calibrated tap length per key, 0 = default
+    uint16_t gap_ms[KeyTimings::kMaxKeys];    // calibrated pause after each key, 0 = default
+    uint32_t reserved;
+    uint64_t last_seen;         // seconds since the epoch
+};
+
+/**
+ * @brief A fixed table of DeviceRecords in a file mapped into memory.
+ *
+ * Every call takes an exclusive lock on the file, so several processes can
+ * share it; within a process the caller serialises access. A file with an
+ * unknown layout is reset rather than trusted.
+ */
+class DeviceRegistry {
+public:
+    static constexpr size_t kCapacity = 32;
+
+    DeviceRegistry() = default;
+    ~DeviceRegistry() { close(); }
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+    /**
+     * @brief Maps the registry file, creating it (and its directory) if needed.
+     */
+    bool open(const std::filesystem::path& file);
+    void close();
+    bool is_open() const { return file_ != nullptr; }
+    const std::filesystem::path& path() const { return path_; }
+
+    /**
+     * @brief Looks up the board last seen on a port at a given baud rate.
+     */
+    bool find(std::string_view port, uint32_t baud, DeviceRecord& record);
+
+    /**
+     * @brief Adds or replaces the record for a board.
+     *
+     * Drops any other record for the same port or serial number (a board
+     * moved, or another board took its port); when full, evicts the record
+     * seen least recently.
+     */
+    void store(const DeviceRecord& record);
+
+    /**
+     * @brief Drops the record for a port, if any.
+     */
+    void forget(std::string_view port);
+
+private:
+    struct FileLayout;
+
+    void lock();
+    void unlock();
+
+    std::filesystem::path path_;
+    FileLayout* file_ = nullptr;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_DEVICE_REGISTRY_H
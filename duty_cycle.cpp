@@ -0,0 +1,309 @@
+//
+// Duty-cycle scheduling for fractional power.
+//
+
+#include "duty_cycle.h"
+
+#include "arduino_link.h"
+#include "keystroke_planner.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t kMaxSeconds = 99 * 60 + 59;
+constexpr size_t kMaxWindows = 4096;
+
+// A stretch of the profile at one level; 0 = magnetron off
+struct Stretch {
+    uint32_t level;
+    uint32_t start_ms;
+    uint32_t length_ms;
+};
+
+struct Interval {
+    uint64_t start_ms;
+    uint64_t end_ms;
+    uint32_t level;
+};
+
+bool build_windows(const PowerSegment* segments, size_t count, uint32_t window_seconds,
+                   std::vector<DutyWindow>& windows) {
+    uint32_t start_s = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const PowerSegment& segment = segments[i];
+        if (segment.start_permille > 1000 || segment.end_permille > 1000 ||
+            segment.seconds > kMaxSeconds - start_s) {
+            return false;
+        }
+        for (uint32_t offset = 0; offset < segment.seconds; offset += window_seconds) {
+            if (windows.size() == kMaxWindows) {
+                return false;
+            }
+            const uint32_t length = std::min(window_seconds, segment.seconds - offset);
+            // The ramp's value at the middle of the window
+            const int64_t rise = static_cast<int64_t>(segment.end_permille) - segment.start_permille;
+            const int64_t target = segment.start_permille + rise * (2 * offset + length) / (2 * segment.seconds);
+            windows.push_back(DutyWindow{(start_s + offset) * 1000, length * 1000, static_cast<uint32_t>(target), 0});
+        }
+        start_s += segment.seconds;
+    }
+    return !windows.empty();
+}
+
+void add_stretch(std::vector<Stretch>& stretches, uint32_t level, uint32_t start_ms, uint32_t length_ms) {
+    if (length_ms == 0) {
+        return;
+    }
+    if (!stretches.empty() && stretches.back().level == level) {
+        stretches.back().length_ms += length_ms;
+        return;
+    }
+    stretches.push_back(Stretch{level, start_ms, length_ms});
+}
+
+/**
+ * @brief Cycling: full power for the window's share, off for the rest.
+ */
+void cycle_window(const DutyWindow& window, std::vector<Stretch>& stretches) {
+    const uint32_t seconds = window.length_ms / 1000;
+    const uint32_t on = (window.target_permille * seconds + 500) / 1000;
+    add_stretch(stretches, 100, window.start_ms, on * 1000);
+    add_stretch(stretches, 0, window.start_ms + on * 1000, (seconds - on) * 1000);
+}
+
+/**
+ * @brief Mixing: whole magnetron cycles at the levels around the target.
+ *
+ * Odd windows put the upper level first so that neighbouring windows meet
+ * at the same level and share a run.
+ */
+void mix_window(const DutyWindow& window, size_t index, const ApplianceModel& model,
+                std::vector<Stretch>& stretches) {
+    const uint32_t step = 10 * (100 / model.power_steps);   // per mille
+    const uint32_t lower = window.target_permille / step * step;
+    const uint32_t seconds = window.length_ms / 1000;
+    if (lower == window.target_permille) {
+        add_stretch(stretches, lower / 10, window.start_ms, window.length_ms);
+        return;
+    }
+    const uint32_t upper = lower + step;
+    const uint32_t cycle = std::max<uint32_t>(1, model.magnetron_cycle_seconds);
+    const uint32_t cycles = seconds / cycle;
+    if (cycles == 0) {
+        // Too short for a whole cycle: the nearer level
+        const bool up = upper - window.target_permille < window.target_permille - lower;
+        add_stretch(stretches, (up ? upper : lower) / 10, window.start_ms, window.length_ms);
+        return;
+    }
+    const uint32_t upper_cycles = (cycles * (window.target_permille - lower) * 2 / step + 1) / 2;
+    const uint32_t upper_ms = upper_cycles * cycle * 1000;
+    const uint32_t lower_ms = window.length_ms - upper_ms;
+    if (index % 2) {
+        add_stretch(stretches, upper / 10, window.start_ms, upper_ms);
+        add_stretch(stretches, lower / 10, window.start_ms + upper_ms, lower_ms);
+    } else {
+        add_stretch(stretches, lower / 10, window.start_ms, lower_ms);
+        add_stretch(stretches, upper / 10, window.start_ms + lower_ms, upper_ms);
+    }
+}
+
+/**
+ * @brief Turns stretches into runs, pauses and resumes.
+ *
+ * Each run covers the following stretches at its level or off; the oven
+ * counts down only while cooking, so the run's time is just the time on,
+ * and it finishes by itself after the last stretch on. A run that cannot
+ * take effect on time (the previous run was still cooking while its keys
+ * would have been sent) is shortened by the delay, to the second, so that
+ * the schedule does not drift.
+ */
+void schedule(const std::vector<Stretch>& stretches, const ApplianceModel& model, const KeyTimings& timings,
+              std::vector<DutyAction>& actions) {
+    OvenState idle;
+    idle.mode = OvenMode::kIdle;
+    uint64_t oven_free_ms = 0;   // when the previous run finishes
+    bool first = true;
+    size_t i = 0;
+    while (i < stretches.size()) {
+        const uint32_t level = stretches[i].level;
+        if (level == 0) {
+            ++i;
+            continue;
+        }
+        size_t last_on = i;
+        uint32_t on_ms = 0;
+        uint32_t off_ms = 0;
+        for (size_t j = i; j < stretches.size() && (stretches[j].level == level || stretches[j].level == 0); ++j) {
+            if (stretches[j].level == level) {
+                on_ms += stretches[j].length_ms;
+                last_on = j;
+            }
+        }
+        for (size_t j = i; j < last_on; ++j) {
+            off_ms += stretches[j].level == 0 ? stretches[j].length_ms : 0;
+        }
+
+        KeystrokePlan keys;
+        uint32_t lead_ms = 0;
+        if (plan_run(std::max<uint32_t>(1, on_ms / 1000), level, true, idle, model, timings, keys)) {
+            lead_ms = keys.predicted_ms - timings.gap_ms(MICROWAVE_KEY_START);
+        }
+        const uint64_t wanted = stretches[i].start_ms;
+        const uint64_t effect = first ? wanted : std::max<uint64_t>(wanted, oven_free_ms + lead_ms);
+        uint32_t cut_s = static_cast<uint32_t>((effect - wanted + 500) / 1000);
+        cut_s = std::min(cut_s, stretches[last_on].length_ms / 1000 - 1); // never finish before the last stretch
+        const uint32_t seconds = on_ms / 1000 - cut_s;
+
+        actions.push_back(DutyAction{DutyActionKind::kRun, static_cast<uint8_t>(level), seconds,
+                                     static_cast<uint32_t>(effect), lead_ms});
+        for (size_t j = i + 1; j <= last_on; ++j) {
+            const bool on = stretches[j].level == level;
+            if (on == (stretches[j - 1].level == level)) {
+                continue;
+            }
+            const int32_t key = on ? MICROWAVE_KEY_START : MICROWAVE_KEY_STOP;
+            actions.push_back(DutyAction{on ? DutyActionKind::kResume : DutyActionKind::kPause,
+                                         static_cast<uint8_t>(level), 0, stretches[j].start_ms,
+                                         timings.press_ms(key)});
+        }
+        oven_free_ms = effect + uint64_t{seconds} * 1000 + off_ms;
+        first = false;
+        i = last_on + 1;
+    }
+}
+
+uint64_t magnetron_on_ms(uint32_t level, uint64_t elapsed_ms, uint32_t cycle_ms) {
+    if (level >= 100 || cycle_ms == 0) {
+        return elapsed_ms;
+    }
+    const uint64_t on_per_cycle = uint64_t{cycle_ms} * level / 100;
+    return elapsed_ms / cycle_ms * on_per_cycle + std::min<uint64_t>(elapsed_ms % cycle_ms, on_per_cycle);
+}
+
+uint64_t window_error(const DutyPlan& plan) {
+    uint64_t error = 0;
+    for (const DutyWindow& window : plan.windows) {
+        const uint32_t diff = window.planned_permille > window.target_permille
+                                  ? window.planned_permille - window.target_permille
+                                  : window.target_permille - window.planned_permille;
+        error += uint64_t{diff} * window.length_ms;
+    }
+    return error;
+}
+
+bool plan_mode(const std::vector<DutyWindow>& windows, DutyMode mode, const ApplianceModel& model,
+               const KeyTimings& timings, DutyPlan& plan) {
+    std::vector<Stretch> stretches;
+    for (size_t i = 0; i < windows.size(); ++i) {
+        if (mode == DutyMode::kMix) {
+            mix_window(windows[i], i, model, stretches);
+        } else {
+            cycle_window(windows[i], stretches);
+        }
+    }
+    plan.mode = mode;
+    plan.windows = windows;
+    plan.actions.clear();
+    schedule(stretches, model, timings, plan.actions);
+
+    std::vector<uint32_t> effect(plan.actions.size());
+    for (size_t i = 0; i < plan.actions.size(); ++i) {
+        effect[i] = plan.actions[i].at_ms;
+    }
+    for (DutyWindow& window : plan.windows) {
+        window.planned_permille = delivered_permille(plan.actions.data(), effect.data(), plan.actions.size(),
+                                                     window.start_ms, window.start_ms + window.length_ms, model);
+    }
+    plan.total_ms = windows.back().start_ms + windows.back().length_ms;
+    return true;
+}
+
+} // namespace
+
+bool plan_duty_cycle(const PowerSegment* segments, size_t count, uint32_t window_seconds, DutyMode mode,
+                     const ApplianceModel& model, const KeyTimings& timings, DutyPlan& plan) {
+    if (model.power_steps == 0 || (count > 0 && !segments)) {
+        return false;
+    }
+    if (window_seconds == 0) {
+        window_seconds = std::max<uint32_t>(1, model.magnetron_cycle_seconds);
+    }
+    std::vector<DutyWindow> windows;
+    if (!build_windows(segments, count, window_seconds, windows)) {
+        return false;
+    }
+    if (mode != DutyMode::kAuto) {
+        return plan_mode(windows, mode, model, timings, plan);
+    }
+    DutyPlan cycled;
+    DutyPlan mixed;
+    plan_mode(windows, DutyMode::kCycle, model, timings, cycled);
+    plan_mode(windows, DutyMode::kMix, model, timings, mixed);
+    const uint64_t cycled_error = window_error(cycled);
+    const uint64_t mixed_error = window_error(mixed);
+    const bool take_mixed = mixed_error < cycled_error ||
+                            (mixed_error == cycled_error && mixed.actions.size() < cycled.actions.size());
+    plan = take_mixed ? std::move(mixed) : std::move(cycled);
+    return true;
+}
+
+uint32_t delivered_permille(const DutyAction* actions, const uint32_t* effect_ms, size_t count,
+                            uint32_t from_ms, uint32_t to_ms, const ApplianceModel& model) {
+    if (to_ms <= from_ms) {
+        return 0;
+    }
+    // Replay the oven's countdown into the intervals it cooked
+    std::vector<Interval> intervals;
+    uint64_t budget_ms = 0;
+    uint64_t since_ms = 0;
+    uint32_t level = 100;
+    bool cooking = false;
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t t = effect_ms[i];
+        if (cooking && since_ms + budget_ms <= t) {
+            intervals.push_back(Interval{since_ms, since_ms + budget_ms, level});
+            cooking = false;
+            budget_ms = 0;
+        }
+        switch (actions[i].kind) {
+        case DutyActionKind::kRun:
+            if (cooking) {
+                intervals.push_back(Interval{since_ms, t, level});
+            }
+            level = actions[i].power_level;
+            budget_ms = uint64_t{actions[i].seconds} * 1000;
+            since_ms = t;
+            cooking = budget_ms > 0;
+            break;
+        case DutyActionKind::kPause:
+            if (cooking) {
+                intervals.push_back(Interval{since_ms, t, level});
+                budget_ms -= t - since_ms;
+                cooking = false;
+            }
+            break;
+        case DutyActionKind::kResume:
+            if (!cooking && budget_ms > 0) {
+                since_ms = t;
+                cooking = true;
+            }
+            break;
+        }
+    }
+    if (cooking) {
+        intervals.push_back(Interval{since_ms, since_ms + budget_ms, level});
+    }
+
+    const uint32_t cycle_ms = model.magnetron_cycle_seconds * 1000;
+    uint64_t on_ms = 0;
+    for (const Interval& interval : intervals) {
+        const uint64_t begin = std::max<uint64_t>(interval.start_ms, from_ms);
+        const uint64_t end = std::min<uint64_t>(interval.end_ms, to_ms);
+        if (begin < end) {
+            on_ms += magnetron_on_ms(interval.level, end - interval.start_ms, cycle_ms) -
+                     magnetron_on_ms(interval.level, begin - interval.start_ms, cycle_ms);
+        }
+    }
+    return static_cast<uint32_t>(on_ms * 1000 / (to_ms - from_ms));
+}
@@ -0,0 +1,97 @@
+//
+// Average power finer than the keypad's 10% steps, by pausing and resuming
+// a run or by mixing adjacent power levels on a schedule.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_DUTY_CYCLE_H
+#define MD1001LB_MICROWAVE_CONTROLLER_DUTY_CYCLE_H
+
+#include "key_timing.h"
+#include "oven_shadow.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Part of a power profile: a linear ramp, in per mille of full power.
+ */
+struct PowerSegment {
+    uint32_t seconds;
+    uint32_t start_permille;
+    uint32_t end_permille;
+};
+
+enum class DutyMode : uint32_t {
+    kAuto,      // whichever of the two below comes closer to the target
+    kCycle,     // run at 100% and pause for part of every window
+    kMix,       // whole magnetron cycles at the two levels around the target
+};
+
+enum class DutyActionKind : uint8_t {
+    kRun,       // enter seconds at power_level and press Start
+    kPause,     // Stop while cooking
+    kResume,    // Start while paused
+};
+
+/**
+ * @brief One scheduled keypad action.
+ *
+ * at_ms is when it should take effect, counted from the start of the
+ * profile; lead_ms is how long before that it has to be sent.
+ */
+struct DutyAction {
+    DutyActionKind kind;
+    uint8_t power_level;
+    uint32_t seconds;
+    uint32_t at_ms;
+    uint32_t lead_ms;
+};
+
+/**
+ * @brief One averaging window of a profile.
+ */
+struct DutyWindow {
+    uint32_t start_ms;
+    uint32_t length_ms;
+    uint32_t target_permille;
+    uint32_t planned_permille;   // what the actions deliver if sent on time
+};
+
+struct DutyPlan {
+    DutyMode mode = DutyMode::kCycle;   // never kAuto once planned
+    std::vector<DutyAction> actions;
+    std::vector<DutyWindow> windows;
+    uint32_t total_ms = 0;
+};
+
+/**
+ * @brief Schedules the presses that give a power profile.
+ *
+ * The profile is cut into windows of window_seconds (0 = one magnetron
+ * cycle), each aiming at the ramp's value at its middle. Cycling keeps one
+ * run at 100% and pauses it for the rest of each window, to the second.
+ * Mixing runs whole magnetron cycles at the keypad levels just above and
+ * below the target, since a level below 100% only delivers its share over
+ * a whole cycle; it needs windows of at least one cycle, and every change
+ * of level costs a fresh time entry during which the magnetron is off.
+ * Auto plans both and keeps the one with the smaller error (ties go to
+ * fewer actions).
+ *
+ * @return false if the profile is empty, longer than 99:59, or asks for
+ *         more than 1000 per mille.
+ */
+bool plan_duty_cycle(const PowerSegment* segments, size_t count, uint32_t window_seconds, DutyMode mode,
+                     const ApplianceModel& model, const KeyTimings& timings, DutyPlan& plan);
+
+/**
+ * @brief Average power, in per mille, that actions taking effect at
+ *        effect_ms[i] deliver over [from_ms, to_ms).
+ *
+ * Follows the oven: a run cooks for its seconds minus the time spent paused,
+ * and below 100% the magnetron is on for the level's share of each cycle
+ * from every Start or resume.
+ */
+uint32_t delivered_permille(const DutyAction* actions, const uint32_t* effect_ms, size_t count,
+                            uint32_t from_ms, uint32_t to_ms, const ApplianceModel& model);
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_DUTY_CYCLE_H
@@ -0,0 +1,95 @@
+//
+// Minimal Arduino core shim used to build MD1001LB_Controller.ino natively.
+//
+// Only the subset of the Arduino API that the sketch actually uses is
+// provided. Serial is backed by the master side of a pseudo terminal and the
+// GPIO functions drive a simulated keypad matrix (see arduino_shim.cpp).
+//
+#ifndef MD1001LB_EMULATOR_ARDUINO_H
+#define MD1001LB_EMULATOR_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define LOW 0x0
+#define HIGH 0x1
+#define A0 14
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/**
+ * @brief Subset of the Arduino String class backed by std::string.
+ */
+class String {
+public:
+    String() = default;
+    String(const char *s) : s_(s ? s : "") {}
+    String(const __FlashStringHelper *s) : s_(reinterpret_cast<const char *>(s)) {}
+
+    unsigned int length() const { return static_cast<unsigned int>(s_.size()); }
+    const char *c_str() const { return s_.c_str(); }
+
+    char operator[](unsigned int index) const { return index < s_.size() ? s_[index] : '\0'; }
+    String &operator+=(char c) { s_ += c; return *this; }
+
+    bool operator==(const String &other) const { return s_ == other.s_; }
+    bool operator==(const char *other) const { return s_ == other; }
+    bool operator==(const __FlashStringHelper *other) const {
+        return s_ == reinterpret_cast<const char *>(other);
+    }
+
+    int indexOf(char c, unsigned int from = 0) const;
+    String substring(unsigned int begin) const;
+    String substring(unsigned int begin, unsigned int end) const;
+    void trim();
+    void toLowerCase();
+    long toInt() const;
+    bool equalsIgnoreCase(const String &other) const;
+
+private:
+    std::string s_;
+};
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void setTimeout(unsigned long timeout_ms);
+    int available();
+    int read();
+
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(const String &s);
+    size_t print(char c);
+    size_t print(int value);
+    size_t print(long value);
+    size_t print(unsigned int value);
+    size_t print(unsigned long value);
+
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *buffer, size_t size);
+
+    size_t println();
+    template <typename T>
+    size_t println(const T &value) {
+        size_t n = print(value);
+        return n + println();
+    }
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+#endif // MD1001LB_EMULATOR_ARDUINO_H
@@ -0,0 +1,29 @@
+//
+// Minimal EEPROM library shim: 1 KB (an UNO's worth), erased (0xFF) at start
+// unless the emulator binds it to a file (emulator_attach_eeprom), in which
+// case it survives restarts like a real board's.
+//
+#ifndef MD1001LB_EMULATOR_EEPROM_H
+#define MD1001LB_EMULATOR_EEPROM_H
+
+#include <stdint.h>
+
+class EEPROMClass {
+public:
+    EEPROMClass();
+
+    uint8_t read(int address) const;
+    void write(int address, uint8_t value);
+    void update(int address, uint8_t value);
+    int length() const { return static_cast<int>(sizeof(bytes_)); }
+
+    void bind(const char* path);
+
+private:
+    uint8_t bytes_[1024];
+    const char* path_ = nullptr;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // MD1001LB_EMULATOR_EEPROM_H
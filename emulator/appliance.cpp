@@ -0,0 +1,299 @@
+//
+// MD1001LB control board model: keypad scan, keypad logic, countdown and
+// magnetron.
+//
+
+#include "appliance.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t kMagnetronCycleUs = 30'000'000;
+constexpr uint64_t kExpressUs = 30'000'000;
+constexpr uint32_t kPowerStep = 10;
+
+// Strobes after which a keypad that stopped changing cannot change state
+// any more: every counter has reached its threshold
+constexpr uint64_t kSettledSlots =
+    Appliance::kRows * (std::max(Appliance::kRegisterScans, Appliance::kReleaseScans) + 1);
+
+enum class Function { kDigit, kCookTime, kPower, kStart, kStop, kOther };
+
+struct KeyFunction {
+    Function function;
+    uint32_t digit;
+    const char* name;
+};
+
+// The oven's wiring, as listed in the sketch's kKeyMap
+const KeyFunction kKeypad[Appliance::kRows][Appliance::kColumns] = {
+    {{Function::kCookTime, 0, "Cook Time"}, {Function::kDigit, 6, "6"},
+     {Function::kOther, 0, "Clock Timer"}, {Function::kOther, 0, "Auto Cook"}},
+    {{Function::kStart, 0, "Start"}, {Function::kDigit, 5, "5"},
+     {Function::kOther, 0, "Defrost"}, {Function::kOther, 0, "Veggie"}},
+    {{Function::kStop, 0, "Stop"}, {Function::kDigit, 4, "4"},
+     {Function::kOther, 0, "test11"}, {Function::kOther, 0, "Rice"}},
+    {{Function::kOther, 0, "test13"}, {Function::kDigit, 3, "3"},
+     {Function::kPower, 0, "Power"}, {Function::kOther, 0, "Potato"}},
+    {{Function::kDigit, 9, "9"}, {Function::kDigit, 2, "2"},
+     {Function::kOther, 0, "test24"}, {Function::kOther, 0, "Frz. Entree"}},
+    {{Function::kDigit, 8, "8"}, {Function::kDigit, 1, "1"},
+     {Function::kOther, 0, "test26"}, {Function::kOther, 0, "Frz. Pizza"}},
+    {{Function::kDigit, 7, "7"}, {Function::kDigit, 0, "0"},
+     {Function::kOther, 0, "Soften/Melt"}, {Function::kOther, 0, "Reheat"}},
+};
+
+const char* mode_name(ApplianceMode mode) {
+    switch (mode) {
+    case ApplianceMode::kIdle:
+        return "idle";
+    case ApplianceMode::kEnteringTime:
+        return "entering";
+    case ApplianceMode::kPowerSet:
+        return "power";
+    case ApplianceMode::kCooking:
+        return "cooking";
+    case ApplianceMode::kPaused:
+        return "paused";
+    }
+    return "?";
+}
+
+uint32_t ceil_seconds(uint64_t us) {
+    return static_cast<uint32_t>((us + 999'999) / 1'000'000);
+}
+
+} // namespace
+
+uint32_t Appliance::strobed_row(uint64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    advance_locked(now_us, true);
+    return static_cast<uint32_t>(scan_us_ / kScanSlotUs % kRows);
+}
+
+void Appliance::drive_columns(uint32_t driven_mask, uint32_t low_mask, uint64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    advance_locked(now_us);
+    columns_driven_ = driven_mask;
+    columns_low_ = low_mask & driven_mask;
+    slot_low_ |= columns_low_;
+}
+
+ApplianceSnapshot Appliance::snapshot(uint64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    settle(now_us);
+    return snapshot_locked(now_us);
+}
+
+void Appliance::set_log(FILE* log) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    log_ = log;
+}
+
+int64_t Appliance::next_change_us(uint64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    advance_locked(now_us);
+    if (mode_ != ApplianceMode::kCooking) {
+        return -1;
+    }
+    uint64_t next = ends_us_ - now_us;
+    if (power_level_ < 100) {
+        const uint64_t share = kMagnetronCycleUs * power_level_ / 100;
+        const uint64_t phase = (now_us - run_started_us_) % kMagnetronCycleUs;
+        next = std::min(next, phase < share ? share - phase : kMagnetronCycleUs - phase);
+    }
+    return static_cast<int64_t>(next);
+}
+
+void Appliance::advance_locked(uint64_t now_us, bool strobe_read) {
+    scan(now_us, strobe_read);
+    settle(now_us);
+    if (log_ && magnetron_on(now_us) != logged_magnetron_) {
+        log_state("magnetron", now_us);
+    }
+}
+
+void Appliance::scan(uint64_t now_us, bool strobe_read) {
+    uint64_t scan_us = std::max(now_us - scan_lag_us_, scan_us_);
+    if (columns_driven_ != 0) {
+        // Not past the end of a slot the sketch has not been shown
+        const uint64_t limit = strobe_read ? (scan_us_ / kScanSlotUs + 2) * kScanSlotUs - 1 : scan_us_;
+        if (scan_us > limit) {
+            scan_lag_us_ += scan_us - limit;
+            scan_us = limit;
+        }
+    }
+    scan_us_ = scan_us;
+
+    // Slots before this one have ended. A column counts for a strobe if it
+    // was pulled low at any point of it; one left low from the previous
+    // strobe counts only once the sketch writes it again.
+    const uint64_t now_slot = scan_us / kScanSlotUs;
+    const uint64_t last = std::min(now_slot, next_slot_ + kSettledSlots);
+    for (uint64_t slot = next_slot_; slot < last; ++slot) {
+        const uint64_t read_us = (slot + 1) * kScanSlotUs + scan_lag_us_;
+        const uint32_t low = slot == next_slot_ ? slot_low_ : columns_low_;
+        settle(read_us);
+        const uint32_t row = static_cast<uint32_t>(slot % kRows);
+        for (uint32_t column = 0; column < kColumns; ++column) {
+            if (low & (1u << column)) {
+                unseen_[row][column] = 0;
+                seen_[row][column] = static_cast<uint8_t>(std::min(seen_[row][column] + 1, 255));
+                if (!down_[row][column] && seen_[row][column] >= kRegisterScans) {
+                    down_[row][column] = true;
+                    key_down(row, column, read_us);
+                }
+            } else {
+                seen_[row][column] = 0;
+                unseen_[row][column] = static_cast<uint8_t>(std::min(unseen_[row][column] + 1, 255));
+                if (down_[row][column] && unseen_[row][column] >= kReleaseScans) {
+                    down_[row][column] = false;
+                }
+            }
+        }
+    }
+    if (now_slot > next_slot_) {
+        next_slot_ = now_slot;
+        slot_low_ = 0;
+    }
+}
+
+void Appliance::settle(uint64_t now_us) {
+    if (mode_ == ApplianceMode::kCooking && now_us >= ends_us_) {
+        end_run(ends_us_);
+        mode_ = ApplianceMode::kIdle;
+        show_end_ = true;
+        if (log_) {
+            log_state("done", ends_us_);
+        }
+    }
+}
+
+void Appliance::start_run(uint64_t length_us, uint64_t now_us) {
+    mode_ = ApplianceMode::kCooking;
+    run_started_us_ = now_us;
+    ends_us_ = now_us + length_us;
+}
+
+void Appliance::end_run(uint64_t now_us) {
+    cooking_us_ += now_us - run_started_us_;
+    magnetron_us_ += magnetron_us(run_started_us_, now_us);
+}
+
+uint64_t Appliance::magnetron_us(uint64_t from_us, uint64_t to_us) const {
+    const uint64_t share = kMagnetronCycleUs * power_level_ / 100;
+    const uint64_t length = to_us - from_us;
+    return length / kMagnetronCycleUs * share + std::min(length % kMagnetronCycleUs, share);
+}
+
+bool Appliance::magnetron_on(uint64_t now_us) const {
+    return mode_ == ApplianceMode::kCooking &&
+           (now_us - run_started_us_) % kMagnetronCycleUs < kMagnetronCycleUs * power_level_ / 100;
+}
+
+void Appliance::key_down(uint32_t row, uint32_t column, uint64_t now_us) {
+    const KeyFunction& key = kKeypad[row][column];
+    ++keys_;
+    last_row_ = static_cast<int32_t>(row);
+    last_column_ = static_cast<int32_t>(column);
+    last_key_us_ = now_us;
+    show_end_ = false;
+
+    const uint32_t entered_seconds = entry_ / 100 * 60 + entry_ % 100;
+    switch (key.function) {
+    case Function::kStop:
+        if (mode_ == ApplianceMode::kCooking) {
+            end_run(now_us);
+            remaining_us_ = ends_us_ - now_us;
+            mode_ = ApplianceMode::kPaused;
+        } else {
+            mode_ = ApplianceMode::kIdle;
+        }
+        break;
+    case Function::kCookTime:
+        if (mode_ == ApplianceMode::kIdle) {
+            entry_ = 0;
+            power_level_ = 100;
+            mode_ = ApplianceMode::kEnteringTime;
+        }
+        break;
+    case Function::kDigit:
+        if (mode_ == ApplianceMode::kEnteringTime) {
+            entry_ = (entry_ * 10 + key.digit) % 10000;
+        }
+        break;
+    case Function::kPower:
+        if (mode_ == ApplianceMode::kEnteringTime && entered_seconds > 0) {
+            power_level_ = 100;
+            mode_ = ApplianceMode::kPowerSet;
+        } else if (mode_ == ApplianceMode::kPowerSet) {
+            power_level_ = power_level_ > kPowerStep ? power_level_ - kPowerStep : 100;
+        }
+        break;
+    case Function::kStart:
+        if ((mode_ == ApplianceMode::kEnteringTime || mode_ == ApplianceMode::kPowerSet) && entered_seconds > 0) {
+            start_run(uint64_t{entered_seconds} * 1'000'000, now_us);
+        } else if (mode_ == ApplianceMode::kPaused) {
+            start_run(remaining_us_, now_us);
+        } else if (mode_ == ApplianceMode::kIdle) {
+            power_level_ = 100;
+            start_run(kExpressUs, now_us);
+        } else if (mode_ == ApplianceMode::kCooking) {
+            ends_us_ += kExpressUs;
+        }
+        break;
+    case Function::kOther:
+        break;
+    }
+    if (log_) {
+        log_state(key.name, now_us);
+    }
+}
+
+ApplianceSnapshot Appliance::snapshot_locked(uint64_t now_us) const {
+    ApplianceSnapshot snapshot;
+    snapshot.mode = mode_;
+    snapshot.power_level = power_level_;
+    switch (mode_) {
+    case ApplianceMode::kIdle:
+        std::snprintf(snapshot.display, sizeof(snapshot.display), "%s", show_end_ ? "End" : "");
+        break;
+    case ApplianceMode::kEnteringTime:
+        snapshot.seconds = entry_ / 100 * 60 + entry_ % 100;
+        std::snprintf(snapshot.display, sizeof(snapshot.display), "%02u:%02u", entry_ / 100 % 100, entry_ % 100);
+        break;
+    case ApplianceMode::kPowerSet:
+        snapshot.seconds = entry_ / 100 * 60 + entry_ % 100;
+        std::snprintf(snapshot.display, sizeof(snapshot.display), "P%u", power_level_);
+        break;
+    case ApplianceMode::kCooking:
+    case ApplianceMode::kPaused:
+        snapshot.seconds = ceil_seconds(mode_ == ApplianceMode::kCooking ? ends_us_ - now_us : remaining_us_);
+        std::snprintf(snapshot.display, sizeof(snapshot.display), "%02u:%02u", snapshot.seconds / 60 % 100,
+                      snapshot.seconds % 60);
+        break;
+    }
+    snapshot.magnetron_on = magnetron_on(now_us);
+    uint64_t cooking_us = cooking_us_;
+    uint64_t magnetron = magnetron_us_;
+    if (mode_ == ApplianceMode::kCooking) {
+        cooking_us += now_us - run_started_us_;
+        magnetron += magnetron_us(run_started_us_, now_us);
+    }
+    snapshot.cooking_ms = cooking_us / 1000;
+    snapshot.magnetron_ms = magnetron / 1000;
+    snapshot.keys = keys_;
+    snapshot.last_row = last_row_;
+    snapshot.last_column = last_column_;
+    snapshot.last_key_us = last_key_us_;
+    return snapshot;
+}
+
+void Appliance::log_state(const char* cause, uint64_t now_us) {
+    const ApplianceSnapshot state = snapshot_locked(now_us);
+    logged_magnetron_ = state.magnetron_on;
+    std::fprintf(log_, "oven %10.3f %-11s %-8s %-5s %3u%% magnetron %s\n", static_cast<double>(now_us) / 1e6, cause,
+                 mode_name(state.mode), state.display, state.power_level, state.magnetron_on ? "on" : "off");
+    std::fflush(log_);
+}
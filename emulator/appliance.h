@@ -0,0 +1,151 @@
+//
+// Behavioural model of the MD1001LB's own control board.
+//
+// The sketch only drives the keypad matrix; this is what the microwave does
+// with it. The model strobes the rows, debounces what it sees on the
+// columns, and runs the oven's keypad logic, display and magnetron, so the
+// emulator can tell whether a run actually ended up cooking for the right
+// time at the right power.
+//
+#ifndef MD1001LB_EMULATOR_APPLIANCE_H
+#define MD1001LB_EMULATOR_APPLIANCE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+enum class ApplianceMode : uint32_t {
+    kIdle,
+    kEnteringTime,  // "Cook Time" and digits
+    kPowerSet,      // ... and "Power"
+    kCooking,
+    kPaused,
+};
+
+/**
+ * @brief What the microwave shows and does at one moment.
+ */
+struct ApplianceSnapshot {
+    ApplianceMode mode = ApplianceMode::kIdle;
+    char display[8] = {};           // "01:30", "P50", "End", or "" when idle
+    uint32_t seconds = 0;           // entered, or left when cooking or paused
+    uint32_t power_level = 100;
+    bool magnetron_on = false;
+    uint64_t cooking_ms = 0;        // spent cooking since boot
+    uint64_t magnetron_ms = 0;      // ... with the magnetron on
+    uint32_t keys = 0;              // key presses the oven accepted since boot
+    int32_t last_row = -1;          // of the last accepted key
+    int32_t last_column = -1;
+    uint64_t last_key_us = 0;       // when it registered (emulator clock)
+};
+
+/**
+ * @brief The oven's controller, driven by the column levels of its keypad.
+ *
+ * Rows are strobed one at a time for kScanSlotUs each; a key counts as seen
+ * on a strobe of its row if its column was pulled low during it. It
+ * registers once seen on kRegisterScans strobes of its row in a row, and is
+ * released after kReleaseScans strobes without it.
+ *
+ * The scan runs on its own clock. A real board mirrors every strobe onto
+ * the held key's column within microseconds, but the emulated sketch can be
+ * descheduled for milliseconds with a column pulled low (or left high),
+ * which would show every key of that column (or none) to a scan running
+ * on. So while the sketch drives any column only strobed_row moves the
+ * scan, at most into the slot after the one it last reported, and the scan
+ * clock falls behind the emulator clock by whatever the sketch lost.
+ *
+ * Keypad logic (the same rules ApplianceModel in oven_shadow.h describes
+ * from the host's side): "Cook Time" then up to four digits shifting in
+ * from the right of MM:SS, seconds up to 99; "Power" shows 100% and each
+ * further press steps down 10%, wrapping; "Start" cooks what was entered,
+ * resumes a pause, or with nothing entered adds 30 s at 100% (also while
+ * cooking); "Stop" pauses a running oven and clears anything else. Below
+ * 100% the magnetron is on for that share of every 30 s cycle, from each
+ * Start or resume. Other keys (the auto programs) are accepted but ignored.
+ *
+ * Times are microseconds of the emulator clock. Thread-safe: the emulator
+ * loop drives it while other threads take snapshots.
+ */
+class Appliance {
+public:
+    static constexpr uint32_t kRows = 7;
+    static constexpr uint32_t kColumns = 4;
+    static constexpr uint64_t kScanSlotUs = 1000;
+    static constexpr uint32_t kRegisterScans = 3;
+    static constexpr uint32_t kReleaseScans = 2;
+
+    /**
+     * @brief Brings the scan up to now_us and returns the row strobed (pulled
+     *        low) then.
+     */
+    uint32_t strobed_row(uint64_t now_us);
+
+    /**
+     * @brief Sets which columns the sketch drives, and which of those low,
+     *        from now_us on (bit i = column i).
+     */
+    void drive_columns(uint32_t driven_mask, uint32_t low_mask, uint64_t now_us);
+
+    /**
+     * @brief The state at now_us; for other threads, so it leaves the scan
+     *        where the sketch's side last brought it.
+     */
+    ApplianceSnapshot snapshot(uint64_t now_us);
+
+    /**
+     * @brief Prints every accepted key and change of state to log (nullptr = off).
+     */
+    void set_log(FILE* log);
+
+    /**
+     * @brief Advances to now_us, then returns the microseconds until the next
+     *        change of state that happens without a key (end of cooking,
+     *        magnetron switching), or -1 if none.
+     */
+    int64_t next_change_us(uint64_t now_us);
+
+private:
+    void advance_locked(uint64_t now_us, bool strobe_read = false);
+    void scan(uint64_t now_us, bool strobe_read);
+    void settle(uint64_t now_us);
+    void key_down(uint32_t row, uint32_t column, uint64_t now_us);
+    void start_run(uint64_t length_us, uint64_t now_us);
+    void end_run(uint64_t now_us);
+    uint64_t magnetron_us(uint64_t from_us, uint64_t to_us) const;
+    bool magnetron_on(uint64_t now_us) const;
+    ApplianceSnapshot snapshot_locked(uint64_t now_us) const;
+    void log_state(const char* cause, uint64_t now_us);
+
+    std::mutex mutex_;
+    FILE* log_ = nullptr;
+    bool logged_magnetron_ = false;
+
+    // Keypad scan
+    uint32_t columns_driven_ = 0;
+    uint32_t columns_low_ = 0;
+    uint32_t slot_low_ = 0;                     // columns pulled low during the current slot
+    uint64_t scan_us_ = 0;                      // scan clock, as last advanced
+    uint64_t scan_lag_us_ = 0;                  // emulator clock minus scan clock
+    uint64_t next_slot_ = 0;                    // first slot not read yet (scan clock)
+    uint8_t seen_[kRows][kColumns] = {};        // consecutive strobes seen
+    uint8_t unseen_[kRows][kColumns] = {};      // consecutive strobes missed
+    bool down_[kRows][kColumns] = {};
+
+    // Control logic
+    ApplianceMode mode_ = ApplianceMode::kIdle;
+    bool show_end_ = false;
+    uint32_t entry_ = 0;                        // MMSS as typed
+    uint32_t power_level_ = 100;
+    uint64_t ends_us_ = 0;                      // cooking
+    uint64_t remaining_us_ = 0;                 // paused
+    uint64_t run_started_us_ = 0;               // last Start or resume: the magnetron cycle's origin
+    uint64_t cooking_us_ = 0;                   // finished runs
+    uint64_t magnetron_us_ = 0;                 // ... and their magnetron time
+    uint32_t keys_ = 0;
+    int32_t last_row_ = -1;
+    int32_t last_column_ = -1;
+    uint64_t last_key_us_ = 0;
+};
+
+#endif // MD1001LB_EMULATOR_APPLIANCE_H
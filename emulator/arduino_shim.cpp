@@ -0,0 +1,354 @@
+//
+// Native implementation of the Arduino shim declared in Arduino.h.
+//
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "appliance.h"
+#include "emulator.h"
+#include "virtual_clock.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <poll.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+
+namespace {
+
+// Pin numbering mirrors the sketch: rows on 2-8, columns on 9-12.
+constexpr uint8_t kFirstRowPin = 2;
+constexpr uint8_t kRowPinCount = Appliance::kRows;
+constexpr uint8_t kFirstColumnPin = 9;
+constexpr uint8_t kColumnPinCount = Appliance::kColumns;
+constexpr uint8_t kPinCount = 20;
+
+int g_serial_fd = -1;
+uint8_t g_pin_mode[kPinCount] = {};
+uint8_t g_pin_level[kPinCount] = {};
+
+// The sketch's clock starts here; millis() and micros() follow LinkClock
+// so that a shared virtual clock moves the oven and the host together.
+LinkClock::time_point g_boot = LinkClock::now();
+
+// The microwave on the other side of the keypad matrix: it strobes the rows
+// and reads the columns.
+Appliance g_appliance;
+
+// Arduino UNO sized receive buffer.
+char g_rx[64];
+size_t g_rx_head = 0;
+size_t g_rx_tail = 0;
+
+void fill_rx() {
+    if (g_serial_fd < 0 || g_rx_head != g_rx_tail) {
+        return;
+    }
+    pollfd pfd{g_serial_fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) {
+        return;
+    }
+    ssize_t n = ::read(g_serial_fd, g_rx, sizeof(g_rx));
+    if (n > 0) {
+        g_rx_head = 0;
+        g_rx_tail = static_cast<size_t>(n);
+    }
+}
+
+size_t write_bytes(const char *data, size_t len) {
+    size_t written = 0;
+    while (g_serial_fd >= 0 && written < len) {
+        ssize_t n = ::write(g_serial_fd, data + written, len - written);
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return written;
+}
+
+} // namespace
+
+// --- String ---
+
+int String::indexOf(char c, unsigned int from) const {
+    if (from >= s_.size()) {
+        return -1;
+    }
+    size_t pos = s_.find(c, from);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+}
+
+String String::substring(unsigned int begin) const {
+    return substring(begin, length());
+}
+
+String String::substring(unsigned int begin, unsigned int end) const {
+    if (begin > end) {
+        std::swap(begin, end);
+    }
+    end = std::min(end, length());
+    String out;
+    if (begin < end) {
+        out.s_ = s_.substr(begin, end - begin);
+    }
+    return out;
+}
+
+void String::trim() {
+    size_t begin = 0;
+    size_t end = s_.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(s_[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(s_[end - 1]))) --end;
+    s_ = s_.substr(begin, end - begin);
+}
+
+void String::toLowerCase() {
+    for (char &c : s_) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+}
+
+long String::toInt() const {
+    return std::strtol(s_.c_str(), nullptr, 10);
+}
+
+bool String::equalsIgnoreCase(const String &other) const {
+    if (s_.size() != other.s_.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < s_.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(s_[i])) !=
+            std::tolower(static_cast<unsigned char>(other.s_[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Serial ---
+
+void HardwareSerial::begin(unsigned long /*baud*/) {}
+void HardwareSerial::setTimeout(unsigned long /*timeout_ms*/) {}
+
+int HardwareSerial::available() {
+    fill_rx();
+    return static_cast<int>(g_rx_tail - g_rx_head);
+}
+
+int HardwareSerial::read() {
+    fill_rx();
+    if (g_rx_head == g_rx_tail) {
+        return -1;
+    }
+    return static_cast<unsigned char>(g_rx[g_rx_head++]);
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *s) {
+    return print(reinterpret_cast<const char *>(s));
+}
+
+size_t HardwareSerial::print(const char *s) {
+    return write_bytes(s, std::strlen(s));
+}
+
+size_t HardwareSerial::print(const String &s) {
+    return write_bytes(s.c_str(), s.length());
+}
+
+size_t HardwareSerial::print(char c) {
+    return write_bytes(&c, 1);
+}
+
+size_t HardwareSerial::print(int value) {
+    return print(static_cast<long>(value));
+}
+
+size_t HardwareSerial::print(long value) {
+    char buf[24];
+    int n = std::snprintf(buf, sizeof(buf), "%ld", value);
+    return write_bytes(buf, static_cast<size_t>(n));
+}
+
+size_t HardwareSerial::print(unsigned int value) {
+    return print(static_cast<unsigned long>(value));
+}
+
+size_t HardwareSerial::print(unsigned long value) {
+    char buf[24];
+    int n = std::snprintf(buf, sizeof(buf), "%lu", value);
+    return write_bytes(buf, static_cast<size_t>(n));
+}
+
+size_t HardwareSerial::write(uint8_t byte) {
+    return write_bytes(reinterpret_cast<const char *>(&byte), 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    return write_bytes(reinterpret_cast<const char *>(buffer), size);
+}
+
+size_t HardwareSerial::println() {
+    return write_bytes("\r\n", 2);
+}
+
+// --- Time ---
+
+// Set whenever the sketch reads the clock; the idle loop never does.
+static bool g_clock_read = false;
+
+unsigned long millis() {
+    g_clock_read = true;
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        LinkClock::now() - g_boot).count());
+}
+
+unsigned long micros() {
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::microseconds>(
+        LinkClock::now() - g_boot).count());
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// --- GPIO / simulated keypad matrix ---
+
+/**
+ * @brief Tells the appliance how the columns are now driven, if pin is one.
+ */
+static void update_columns(uint8_t pin) {
+    if (pin < kFirstColumnPin || pin >= kFirstColumnPin + kColumnPinCount) {
+        return;
+    }
+    uint32_t driven = 0;
+    uint32_t low = 0;
+    for (uint8_t i = 0; i < kColumnPinCount; ++i) {
+        const uint8_t column = kFirstColumnPin + i;
+        if (g_pin_mode[column] == OUTPUT) {
+            driven |= 1u << i;
+            if (g_pin_level[column] == LOW) {
+                low |= 1u << i;
+            }
+        }
+    }
+    g_appliance.drive_columns(driven, low, micros());
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < kPinCount) {
+        g_pin_mode[pin] = mode;
+        update_columns(pin);
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < kPinCount) {
+        g_pin_level[pin] = value ? HIGH : LOW;
+        update_columns(pin);
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    if (pin >= kFirstRowPin && pin < kFirstRowPin + kRowPinCount) {
+        return g_appliance.strobed_row(micros()) == static_cast<uint32_t>(pin - kFirstRowPin) ? LOW : HIGH;
+    }
+    return pin < kPinCount ? g_pin_level[pin] : LOW;
+}
+
+int analogRead(uint8_t /*pin*/) {
+    // A floating input: noise around mid-scale, different on every run
+    static std::minstd_rand noise(std::random_device{}());
+    return 512 + static_cast<int>(noise() % 64) - 32;
+}
+
+// --- EEPROM ---
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass() {
+    std::memset(bytes_, 0xFF, sizeof(bytes_)); // erased
+}
+
+uint8_t EEPROMClass::read(int address) const {
+    return address >= 0 && address < length() ? bytes_[address] : 0xFF;
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+    if (address >= 0 && address < length()) {
+        bytes_[address] = value;
+        if (path_) {
+            if (FILE* f = std::fopen(path_, "wb")) {
+                std::fwrite(bytes_, 1, sizeof(bytes_), f);
+                std::fclose(f);
+            }
+        }
+    }
+}
+
+void EEPROMClass::bind(const char* path) {
+    path_ = path;
+    if (FILE* f = std::fopen(path, "rb")) {
+        size_t n = std::fread(bytes_, 1, sizeof(bytes_), f);
+        (void)n;
+        std::fclose(f);
+    }
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+    write(address, value);
+}
+
+// --- Emulator hooks ---
+
+void emulator_attach_serial(int fd) {
+    g_serial_fd = fd;
+}
+
+void emulator_attach_eeprom(const char* path) {
+    EEPROM.bind(path);
+}
+
+bool emulator_take_clock_read() {
+    bool read = g_clock_read;
+    g_clock_read = false;
+    return read;
+}
+
+ApplianceSnapshot emulator_oven() {
+    return g_appliance.snapshot(micros());
+}
+
+void emulator_log_oven(FILE* log) {
+    g_appliance.set_log(log);
+}
+
+bool emulator_attach_clock(const char* path) {
+    if (!attach_virtual_clock(path)) {
+        return false;
+    }
+    g_boot = LinkClock::now(); // a clock that has skipped ahead must not age the board
+    return true;
+}
+
+int emulator_advance_oven() {
+    const int64_t next_us = g_appliance.next_change_us(micros());
+    return next_us < 0 ? -1 : static_cast<int>(std::min<int64_t>(next_us / 1000 + 1, 60'000));
+}
+
+bool emulator_key_active() {
+    for (uint8_t pin = 0; pin < kPinCount; ++pin) {
+        if (g_pin_mode[pin] == OUTPUT) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,89 @@
+//
+// Pseudo terminal plumbing and main loop for the native firmware build.
+//
+
+#include "emulator.h"
+#include "virtual_clock.h"
+
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Entry points provided by MD1001LB_Controller.ino.
+void setup();
+void loop();
+
+int emulator_open_pty(std::string& slave_path) {
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        return -1;
+    }
+    if (::grantpt(master) != 0 || ::unlockpt(master) != 0) {
+        ::close(master);
+        return -1;
+    }
+    const char* name = ::ptsname(master);
+    if (!name) {
+        ::close(master);
+        return -1;
+    }
+    slave_path = name;
+
+    // Put the slave into raw mode before the banner is written so the line
+    // discipline never echoes firmware output back in as input. The slave fd
+    // is deliberately leaked: keeping it open means the master does not see
+    // EIO while no host is attached.
+    int slave = ::open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        ::close(master);
+        return -1;
+    }
+    termios tio{};
+    if (::tcgetattr(slave, &tio) == 0) {
+        ::cfmakeraw(&tio);
+        ::tcsetattr(slave, TCSANOW, &tio);
+    }
+    return master;
+}
+
+void emulator_run(int master_fd) {
+    emulator_attach_serial(master_fd);
+    if (const char* clock = std::getenv("MD1001LB_VIRTUAL_CLOCK")) {
+        emulator_attach_clock(clock);
+    }
+    const int slot = virtual_clock_attached() ? join_virtual_clock() : -1;
+    setup();
+    while (true) {
+        loop();
+        // Sleep until the host sends something. While a key is being held the
+        // sketch must mirror each row strobe onto its column well within the
+        // strobe, or the oven misses the key, so only nap briefly; while it
+        // waits on a deadline (it read millis() this pass) nap a millisecond;
+        // otherwise wake for the microwave's own next change.
+        bool waiting = emulator_take_clock_read();
+        int oven_ms = emulator_advance_oven();
+        if (emulator_key_active()) {
+            virtual_clock_busy(slot);
+            ::usleep(100);
+            continue;
+        }
+        // On a virtual clock the board is idle until the microwave's next
+        // change, unless the sketch is timing something of its own; the
+        // clock may then jump, so nap a millisecond at most
+        if (slot >= 0) {
+            if (waiting) {
+                virtual_clock_busy(slot);
+            } else {
+                virtual_clock_idle(slot, oven_ms < 0 ? LinkClock::time_point::max()
+                                                     : LinkClock::now() + std::chrono::milliseconds(oven_ms));
+            }
+        }
+        pollfd pfd{master_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, slot >= 0 || waiting ? 1 : oven_ms) > 0) {
+            virtual_clock_busy(slot);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//
+// Native host for MD1001LB_Controller.ino.
+//
+// The sketch is compiled unchanged against the Arduino shim and its serial
+// port is exposed as a pseudo terminal, so arduino_link can talk to it exactly
+// as it talks to a real board.
+//
+#ifndef MD1001LB_EMULATOR_EMULATOR_H
+#define MD1001LB_EMULATOR_EMULATOR_H
+
+#include "appliance.h"
+
+#include <cstdio>
+#include <string>
+
+/**
+ * @brief Creates a raw-mode pseudo terminal for the emulated board.
+ *
+ * @param slave_path Receives the path the host should open (e.g. "/dev/pts/3").
+ *
+ * @return The master file descriptor, or -1 on failure.
+ */
+int emulator_open_pty(std::string& slave_path);
+
+/**
+ * @brief Runs the sketch's setup() and loop() against the given pty master.
+ *
+ * Never returns; the emulator lives until its process exits.
+ */
+[[noreturn]] void emulator_run(int master_fd);
+
+// Hooks implemented by arduino_shim.cpp.
+void emulator_attach_serial(int fd);
+void emulator_attach_eeprom(const char* path);
+bool emulator_key_active();
+bool emulator_take_clock_read();
+
+/**
+ * @brief Puts the board on the virtual clock in path (see
+ *        set_microwave_virtual_time); call before emulator_run.
+ *
+ * @return false if the clock file cannot be attached.
+ */
+bool emulator_attach_clock(const char* path);
+
+/**
+ * @brief What the emulated microwave shows and does now; safe to call from
+ *        any thread while emulator_run serves the sketch.
+ */
+ApplianceSnapshot emulator_oven();
+
+/**
+ * @brief Prints the microwave's accepted keys and state changes (nullptr = off).
+ */
+void emulator_log_oven(FILE* log);
+
+/**
+ * @brief Brings the microwave up to date.
+ *
+ * @return Milliseconds until it next changes by itself (end of cooking,
+ *         magnetron cycling), or -1 if it will not.
+ */
+int emulator_advance_oven();
+
+#endif // MD1001LB_EMULATOR_EMULATOR_H
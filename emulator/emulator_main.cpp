@@ -0,0 +1,49 @@
+//
+// Standalone MD1001LB board emulator.
+//
+// Prints the pty path to open (pass it to open_microwave_controller or
+// main_tester) and then serves the sketch until killed.
+//
+//     md1001lb_emulator [--eeprom <file>] [--oven] [--clock <file>]
+//
+// --eeprom keeps the board's EEPROM (and so its serial number) in a file,
+// so a restarted emulator comes back as the same board, like a replugged one.
+// --oven prints, after the pty path, every key the emulated microwave
+// accepted and what it then shows and does.
+// --clock runs the board on the virtual clock in the file, shared with the
+// host library (see set_microwave_virtual_time).
+//
+
+#include "emulator.h"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    bool oven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--eeprom" && i + 1 < argc) {
+            emulator_attach_eeprom(argv[++i]);
+        } else if (arg == "--oven") {
+            oven = true;
+        } else if (arg == "--clock" && i + 1 < argc) {
+            if (!emulator_attach_clock(argv[++i])) {
+                std::cerr << "Cannot attach clock " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::string slave_path;
+    int master = emulator_open_pty(slave_path);
+    if (master < 0) {
+        std::cerr << "Failed to create pseudo terminal" << std::endl;
+        return 1;
+    }
+    std::cout << slave_path << std::endl;
+    if (oven) {
+        emulator_log_oven(stdout);
+    }
+    emulator_run(master);
+}
@@ -0,0 +1,4 @@
+//
+// Compiles the Arduino sketch as an ordinary C++ translation unit.
+//
+#include "../MD1001LB_Controller.ino"
@@ -0,0 +1,136 @@
+//
+// Fault decisions for FaultyStream, and the $MD1001LB_FAULTS syntax.
+//
+
+#include "fault_link.h"
+
+#include <string_view>
+
+namespace {
+
+constexpr uint32_t kMillion = 1000000;
+
+/**
+ * @brief Parses an unsigned decimal that spans all of text.
+ */
+bool parse_number(std::string_view text, uint32_t& value) {
+    if (text.empty() || text.size() > 10) {
+        return false;
+    }
+    uint64_t parsed = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        parsed = parsed * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (parsed > UINT32_MAX) {
+        return false;
+    }
+    value = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+bool parse_ppm(std::string_view text, uint32_t& ppm) {
+    return parse_number(text, ppm) && ppm <= kMillion;
+}
+
+/**
+ * @brief Parses "ppm:ms".
+ */
+bool parse_timed(std::string_view text, uint32_t& ppm, uint32_t& ms) {
+    const size_t colon = text.find(':');
+    return colon != std::string_view::npos && parse_ppm(text.substr(0, colon), ppm) &&
+           parse_number(text.substr(colon + 1), ms);
+}
+
+} // namespace
+
+void FaultInjector::configure(const microwave_fault_profile& profile) {
+    profile_ = profile;
+    active_ = profile.drop_ppm || profile.corrupt_ppm || profile.duplicate_ppm ||
+              (profile.spike_ppm && profile.spike_ms) || (profile.stall_ppm && profile.stall_ms) ||
+              profile.disconnect_ppm;
+    random_.seed(profile.seed);
+    stalled_until_ = {};
+}
+
+bool FaultInjector::happens(uint32_t ppm) {
+    return ppm != 0 && random_() % kMillion < ppm;
+}
+
+void FaultInjector::mangle(const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + length);
+    for (size_t i = 0; i < length; ++i) {
+        if (happens(profile_.drop_ppm)) {
+            continue;
+        }
+        uint8_t byte = data[i];
+        if (happens(profile_.corrupt_ppm)) {
+            byte ^= static_cast<uint8_t>(1u << (random_() % 8)); // one flipped bit, as line noise does
+        }
+        out.push_back(byte);
+        if (happens(profile_.duplicate_ppm)) {
+            out.push_back(byte);
+        }
+    }
+}
+
+bool FaultInjector::disconnect() {
+    return happens(profile_.disconnect_ppm);
+}
+
+std::chrono::milliseconds FaultInjector::delay() {
+    const auto now = std::chrono::steady_clock::now();
+    if (stalled_until_ > now) {
+        return std::chrono::ceil<std::chrono::milliseconds>(stalled_until_ - now);
+    }
+    if (profile_.stall_ms && happens(profile_.stall_ppm)) {
+        stalled_until_ = now + std::chrono::milliseconds(profile_.stall_ms);
+        return std::chrono::milliseconds(profile_.stall_ms);
+    }
+    if (profile_.spike_ms && happens(profile_.spike_ppm)) {
+        return std::chrono::milliseconds(profile_.spike_ms);
+    }
+    return std::chrono::milliseconds(0);
+}
+
+bool parse_fault_profile(const char* text, microwave_fault_profile& profile) {
+    microwave_fault_profile parsed{};
+    std::string_view rest(text ? text : "");
+    while (!rest.empty()) {
+        const size_t comma = rest.find(',');
+        std::string_view item = rest.substr(0, comma);
+        rest = comma == std::string_view::npos ? std::string_view() : rest.substr(comma + 1);
+        if (item.empty()) {
+            continue;
+        }
+        const size_t equals = item.find('=');
+        if (equals == std::string_view::npos) {
+            return false;
+        }
+        const std::string_view key = item.substr(0, equals);
+        const std::string_view value = item.substr(equals + 1);
+        bool ok = false;
+        if (key == "seed") {
+            ok = parse_number(value, parsed.seed);
+        } else if (key == "drop") {
+            ok = parse_ppm(value, parsed.drop_ppm);
+        } else if (key == "corrupt") {
+            ok = parse_ppm(value, parsed.corrupt_ppm);
+        } else if (key == "duplicate") {
+            ok = parse_ppm(value, parsed.duplicate_ppm);
+        } else if (key == "spike") {
+            ok = parse_timed(value, parsed.spike_ppm, parsed.spike_ms);
+        } else if (key == "stall") {
+            ok = parse_timed(value, parsed.stall_ppm, parsed.stall_ms);
+        } else if (key == "disconnect") {
+            ok = parse_ppm(value, parsed.disconnect_ppm);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    profile = parsed;
+    return true;
+}
@@ -0,0 +1,311 @@
+//
+// Fault injection between a session and its serial port, for measuring how
+// the library copes with a bad link.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_FAULT_LINK_H
+#define MD1001LB_MICROWAVE_CONTROLLER_FAULT_LINK_H
+
+#include "arduino_link.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include "lib/asio/include/asio.hpp"
+
+/**
+ * @brief Decides which faults hit the traffic, from a seeded generator.
+ *
+ * Byte faults (drop, corrupt, duplicate) are drawn per byte, link faults
+ * (latency spike, stall, disconnect) per read or write, so the same seed and
+ * the same traffic give the same faults. A stall silences both directions
+ * until it ends. Not thread-safe: the owning stream's strand serializes it.
+ */
+class FaultInjector {
+public:
+    /**
+     * @brief Starts injecting profile's faults (an all-zero profile turns them off).
+     */
+    void configure(const microwave_fault_profile& profile);
+
+    bool active() const { return active_; }
+
+    /**
+     * @brief Copies data to out with this pass's byte faults applied.
+     */
+    void mangle(const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+
+    /**
+     * @brief Whether this read or write fails as if the port was unplugged.
+     */
+    bool disconnect();
+
+    /**
+     * @brief How long this read or write is held back: a latency spike, or
+     *        what is left of a stall.
+     */
+    std::chrono::milliseconds delay();
+
+private:
+    bool happens(uint32_t ppm);
+
+    microwave_fault_profile profile_{};
+    bool active_ = false;
+    std::mt19937_64 random_;
+    std::chrono::steady_clock::time_point stalled_until_{};
+};
+
+/**
+ * @brief Parses a profile such as "seed=7,drop=1000,spike=5000:200,stall=500:1500"
+ *        (ppm, and ms after the colon), as $MD1001LB_FAULTS takes it.
+ *
+ * Keys: seed, drop, corrupt, duplicate, spike, stall, disconnect.
+ *
+ * @return false on an unknown key or a malformed value.
+ */
+bool parse_fault_profile(const char* text, microwave_fault_profile& profile);
+
+/**
+ * @brief A stream decorator that injects a FaultInjector's faults into the
+ *        asynchronous reads and writes of Stream.
+ *
+ * Stands in for the port it wraps: opening, options, closing and the
+ * synchronous calls go straight through, as do the asynchronous ones while
+ * no faults are configured. A read delivers what the port returned with
+ * byte faults applied (bytes that do not fit are delivered by the next
+ * read); a write sends the mangled bytes and reports the caller's length.
+ * Delayed operations end with operation_aborted on cancel or close, like
+ * the port's own.
+ *
+ * All calls must come from one strand, the one Stream's operations run on.
+ */
+template <typename Stream>
+class FaultyStream {
+public:
+    using executor_type = typename Stream::executor_type;
+    using native_handle_type = typename Stream::native_handle_type;
+
+    explicit FaultyStream(const executor_type& executor) : next_(executor) {}
+
+    Stream& next_layer() { return next_; }
+    executor_type get_executor() { return next_.get_executor(); }
+
+    void set_faults(const microwave_fault_profile& profile) {
+        faults_.configure(profile);
+        if (!faults_.active()) {
+            pending_.clear();
+        }
+    }
+
+    void open(const std::string& device) { next_.open(device); }
+    void open(const std::string& device, asio::error_code& ec) { next_.open(device, ec); }
+    bool is_open() const { return next_.is_open(); }
+
+    template <typename Option>
+    void set_option(const Option& option) {
+        next_.set_option(option);
+    }
+    template <typename Option>
+    void set_option(const Option& option, asio::error_code& ec) {
+        next_.set_option(option, ec);
+    }
+
+    void cancel() {
+        cancel_delays();
+        next_.cancel();
+    }
+    void cancel(asio::error_code& ec) {
+        cancel_delays();
+        next_.cancel(ec);
+    }
+    void close() {
+        cancel_delays();
+        pending_.clear();
+        next_.close();
+    }
+    void close(asio::error_code& ec) {
+        cancel_delays();
+        pending_.clear();
+        next_.close(ec);
+    }
+
+    template <typename ConstBuffers>
+    size_t write_some(const ConstBuffers& buffers, asio::error_code& ec) {
+        return next_.write_some(buffers, ec);
+    }
+    template <typename MutableBuffers>
+    size_t read_some(const MutableBuffers& buffers, asio::error_code& ec) {
+        return next_.read_some(buffers, ec);
+    }
+
+    template <typename MutableBuffers, typename Token>
+    auto async_read_some(const MutableBuffers& buffers, Token&& token) {
+        if (!faults_.active()) {
+            return next_.async_read_some(buffers, std::forward<Token>(token));
+        }
+        return asio::async_compose<Token, void(asio::error_code, size_t)>(
+            ReadOp<MutableBuffers>{this, buffers}, token, next_);
+    }
+
+    template <typename ConstBuffers, typename Token>
+    auto async_write_some(const ConstBuffers& buffers, Token&& token) {
+        if (!faults_.active()) {
+            return next_.async_write_some(buffers, std::forward<Token>(token));
+        }
+        // Mangled now, while the caller's buffers are certainly valid
+        std::vector<uint8_t> data(asio::buffer_size(buffers));
+        asio::buffer_copy(asio::buffer(data), buffers);
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
+        faults_.mangle(data.data(), data.size(), *bytes);
+        return asio::async_compose<Token, void(asio::error_code, size_t)>(WriteOp{this, data.size(), bytes}, token,
+                                                                          next_);
+    }
+
+private:
+    using Timer = asio::basic_waitable_timer<std::chrono::steady_clock,
+                                             asio::wait_traits<std::chrono::steady_clock>, executor_type>;
+
+    /**
+     * @brief Resumes self after delay, or with operation_aborted if cancelled.
+     */
+    template <typename Self>
+    void wait(Self& self, std::chrono::milliseconds delay) {
+        auto timer = std::make_shared<Timer>(next_.get_executor(), delay);
+        std::erase_if(delays_, [](const std::weak_ptr<Timer>& t) { return t.expired(); });
+        delays_.push_back(timer);
+        timer->async_wait(asio::consign(std::move(self), timer));
+    }
+
+    void cancel_delays() {
+        for (const std::weak_ptr<Timer>& delay : delays_) {
+            if (std::shared_ptr<Timer> timer = delay.lock()) {
+                timer->cancel();
+            }
+        }
+        delays_.clear();
+    }
+
+    template <typename MutableBuffers>
+    struct ReadOp {
+        FaultyStream* stream;
+        MutableBuffers buffers;
+        enum { kStart, kRead, kDelivered } state = kStart;
+        size_t delivered = 0;
+
+        template <typename Self>
+        void operator()(Self& self, asio::error_code ec = {}, size_t n = 0) {
+            switch (state) {
+            case kStart:
+                if (!stream->pending_.empty()) {
+                    // Left over from the last read; complete through the executor
+                    state = kRead;
+                    asio::post(stream->next_.get_executor(), std::move(self));
+                    return;
+                }
+                state = kRead;
+                stream->next_.async_read_some(stream->raw_buffer(buffers), std::move(self));
+                return;
+            case kRead: {
+                if (ec) {
+                    self.complete(ec, 0);
+                    return;
+                }
+                if (stream->faults_.disconnect()) {
+                    self.complete(asio::error::broken_pipe, 0);
+                    return;
+                }
+                std::vector<uint8_t>& pending = stream->pending_;
+                stream->faults_.mangle(stream->raw_.data(), n, pending);
+                delivered = asio::buffer_copy(buffers, asio::buffer(pending));
+                pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(delivered));
+                if (delivered == 0) {
+                    // Everything was dropped: the caller sees nothing yet
+                    state = kRead;
+                    stream->next_.async_read_some(stream->raw_buffer(buffers), std::move(self));
+                    return;
+                }
+                state = kDelivered;
+                const std::chrono::milliseconds delay = stream->faults_.delay();
+                if (delay.count() > 0) {
+                    stream->wait(self, delay);
+                    return;
+                }
+                self.complete({}, delivered);
+                return;
+            }
+            case kDelivered:
+                self.complete(ec, ec ? 0 : delivered);
+                return;
+            }
+        }
+    };
+
+    struct WriteOp {
+        FaultyStream* stream;
+        size_t length;                                  // as the caller asked
+        std::shared_ptr<std::vector<uint8_t>> bytes;    // as sent
+        enum { kStart, kDelayed, kWritten } state = kStart;
+
+        template <typename Self>
+        void operator()(Self& self, asio::error_code ec = {}, size_t /*n*/ = 0) {
+            switch (state) {
+            case kStart: {
+                state = kDelayed;
+                const std::chrono::milliseconds delay = stream->faults_.delay();
+                if (delay.count() > 0) {
+                    stream->wait(self, delay);
+                    return;
+                }
+                (*this)(self);
+                return;
+            }
+            case kDelayed:
+                if (ec) {
+                    self.complete(ec, 0);
+                    return;
+                }
+                if (stream->faults_.disconnect()) {
+                    self.complete(asio::error::broken_pipe, 0);
+                    return;
+                }
+                state = kWritten;
+                if (bytes->empty()) {
+                    self.complete({}, length); // all dropped
+                    return;
+                }
+                asio::async_write(stream->next_, asio::buffer(*bytes), std::move(self));
+                return;
+            case kWritten:
+                self.complete(ec, ec ? 0 : length);
+                return;
+            }
+        }
+    };
+
+    /**
+     * @brief Where a faulty read lands before byte faults: as large as the
+     *        caller's buffers.
+     */
+    template <typename MutableBuffers>
+    asio::mutable_buffer raw_buffer(const MutableBuffers& buffers) {
+        raw_.resize(std::max<size_t>(asio::buffer_size(buffers), 1));
+        return asio::buffer(raw_);
+    }
+
+    Stream next_;
+    FaultInjector faults_;
+    std::vector<uint8_t> raw_;          // read before byte faults
+    std::vector<uint8_t> pending_;      // read, faulted, not delivered yet
+    std::vector<std::weak_ptr<Timer>> delays_;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_FAULT_LINK_H
@@ -0,0 +1,226 @@
+//
+// Generation-checked handle table (slot map) used to hand out MicrowaveHandle
+// values without exposing raw pointers across the DLL boundary.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_HANDLE_TABLE_H
+#define MD1001LB_MICROWAVE_CONTROLLER_HANDLE_TABLE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Fixed-capacity slot map with preallocated object storage.
+ *
+ * A handle packs a slot index into its low kIndexBits and the slot's
+ * generation above that. Closing a handle bumps the generation, so a stale or
+ * double-closed handle simply fails to resolve instead of reaching freed
+ * memory. Handles fit in 31 bits so they stay positive even when LabVIEW
+ * passes them as a 32-bit intptr_t, and are never 0.
+ *
+ * Lookup is lock-free and O(1): each slot keeps one atomic word holding its
+ * generation, a live flag and a pin count. acquire() pins the object for the
+ * lifetime of the returned Ref; destroy() unpublishes the slot, lets the caller
+ * end calls still in flight, then waits for outstanding pins to drain before
+ * running the destructor. Only
+ * create()/destroy() touch the free list, under a mutex.
+ *
+ * @tparam T        Stored object type.
+ * @tparam kIndexBits Log2 of the slot count.
+ */
+template <typename T, unsigned kIndexBits>
+class HandleTable {
+public:
+    static constexpr size_t kCapacity = size_t(1) << kIndexBits;
+
+    /**
+     * @brief Pins one live object; unpins on destruction.
+     */
+    class Ref {
+    public:
+        Ref() = default;
+        Ref(const Ref&) = delete;
+        Ref& operator=(const Ref&) = delete;
+        Ref(Ref&& other) noexcept : table_(other.table_), index_(other.index_) { other.table_ = nullptr; }
+        Ref& operator=(Ref&& other) noexcept {
+            if (this != &other) {
+                if (table_) table_->unpin(index_);
+                table_ = other.table_;
+                index_ = other.index_;
+                other.table_ = nullptr;
+            }
+            return *this;
+        }
+        ~Ref() {
+            if (table_) table_->unpin(index_);
+        }
+
+        explicit operator bool() const { return table_ != nullptr; }
+        T* get() const { return table_ ? table_->object(index_) : nullptr; }
+        T* operator->() const { return get(); }
+
+    private:
+        friend class HandleTable;
+        Ref(HandleTable* table, size_t index) : table_(table), index_(index) {}
+
+        HandleTable* table_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    HandleTable() = default;
+    HandleTable(const HandleTable&) = delete;
+    HandleTable& operator=(const HandleTable&) = delete;
+
+    /**
+     * @brief Constructs a T in a free slot.
+     *
+     * @return The new handle, or 0 if the table is full.
+     */
+    template <typename... Args>
+    intptr_t create(Args&&... args) {
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(free_mutex_);
+            if (free_count_ > 0) {
+                index = free_list_[--free_count_];
+            } else if (next_unused_ < kCapacity) {
+                index = next_unused_++;
+            } else {
+                return 0;
+            }
+        }
+
+        Slot& slot = slots_[index];
+        uint32_t generation = generation_of(slot.state.load(std::memory_order_relaxed));
+        if (generation == 0) {
+            generation = 1; // never-used slot
+        }
+        new (&slot.storage) T(std::forward<Args>(args)...);
+        slot.state.store(pack(generation, true, 0), std::memory_order_release);
+        return static_cast<intptr_t>((uintptr_t(generation) << kIndexBits) | index);
+    }
+
+    /**
+     * @brief Resolves and pins a handle.
+     *
+     * @return An empty Ref if the handle is 0, out of range, stale or closing.
+     */
+    Ref acquire(intptr_t handle) {
+        size_t index;
+        uint32_t generation;
+        if (!decode(handle, index, generation)) {
+            return Ref();
+        }
+        std::atomic<uint64_t>& state = slots_[index].state;
+        uint64_t current = state.load(std::memory_order_acquire);
+        do {
+            if (generation_of(current) != generation || !is_live(current)) {
+                return Ref();
+            }
+        } while (!state.compare_exchange_weak(current, current + 1,
+                                              std::memory_order_acquire, std::memory_order_acquire));
+        return Ref(this, index);
+    }
+
+    /**
+     * @brief Unpublishes a handle, waits for pins to drain and destroys it.
+     *
+     * @param on_unpublish Called with the object once no new pins can be
+     *                     taken, while calls already in flight may still
+     *                     hold theirs; it should make them return.
+     * @param on_close Called with the object after the last pin is released
+     *                 and before its destructor runs.
+     *
+     * @return false if the handle was not live (already closed or never valid).
+     */
+    template <typename OnUnpublish, typename OnClose>
+    bool destroy(intptr_t handle, OnUnpublish&& on_unpublish, OnClose&& on_close) {
+        size_t index;
+        uint32_t generation;
+        if (!decode(handle, index, generation)) {
+            return false;
+        }
+        Slot& slot = slots_[index];
+        uint64_t current = slot.state.load(std::memory_order_acquire);
+        do {
+            if (generation_of(current) != generation || !is_live(current)) {
+                return false;
+            }
+        } while (!slot.state.compare_exchange_weak(current, current & ~kLiveBit,
+                                                   std::memory_order_acq_rel, std::memory_order_acquire));
+
+        // No new pins can be taken now; end calls already in flight and wait
+        // them out.
+        on_unpublish(*object(index));
+        while (pins_of(slot.state.load(std::memory_order_acquire)) != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        T* obj = object(index);
+        on_close(*obj);
+        obj->~T();
+
+        uint32_t next = (generation + 1) & kGenerationMask;
+        slot.state.store(pack(next == 0 ? 1 : next, false, 0), std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_list_[free_count_++] = index;
+        return true;
+    }
+
+    template <typename OnClose>
+    bool destroy(intptr_t handle, OnClose&& on_close) {
+        return destroy(handle, [](T&) {}, std::forward<OnClose>(on_close));
+    }
+
+private:
+    static constexpr unsigned kGenerationBits = 31 - kIndexBits;
+    static constexpr uint32_t kGenerationMask = (uint32_t(1) << kGenerationBits) - 1;
+    static constexpr uint64_t kLiveBit = uint64_t(1) << 31;
+    static constexpr uint64_t kPinMask = kLiveBit - 1;
+
+    struct Slot {
+        // generation << 32 | live << 31 | pin count
+        std::atomic<uint64_t> state{0};
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static uint64_t pack(uint32_t generation, bool live, uint32_t pins) {
+        return (uint64_t(generation) << 32) | (live ? kLiveBit : 0) | pins;
+    }
+    static uint32_t generation_of(uint64_t state) { return uint32_t(state >> 32); }
+    static bool is_live(uint64_t state) { return (state & kLiveBit) != 0; }
+    static uint32_t pins_of(uint64_t state) { return uint32_t(state & kPinMask); }
+
+    static bool decode(intptr_t handle, size_t& index, uint32_t& generation) {
+        if (handle <= 0) {
+            return false;
+        }
+        uintptr_t raw = static_cast<uintptr_t>(handle);
+        uintptr_t high = raw >> kIndexBits;
+        if (high == 0 || high > kGenerationMask) {
+            return false;
+        }
+        index = raw & (kCapacity - 1);
+        generation = uint32_t(high);
+        return true;
+    }
+
+    T* object(size_t index) { return std::launder(reinterpret_cast<T*>(&slots_[index].storage)); }
+
+    void unpin(size_t index) { slots_[index].state.fetch_sub(1, std::memory_order_release); }
+
+    Slot slots_[kCapacity];
+
+    std::mutex free_mutex_;
+    size_t free_list_[kCapacity];
+    size_t free_count_ = 0;
+    size_t next_unused_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_HANDLE_TABLE_H
@@ -0,0 +1,138 @@
+//
+// Key map parsing and perfect hash construction.
+//
+
+#include "key_map.h"
+
+#include <cctype>
+
+namespace {
+
+constexpr uint32_t kFnvOffset = 2166136261u;
+constexpr uint32_t kFnvPrime = 16777619u;
+constexpr uint32_t kMaxSeedAttempts = 10000;
+
+char lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+uint32_t hash_name(std::string_view name, uint32_t seed) {
+    uint32_t h = kFnvOffset ^ seed;
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(lower(c));
+        h *= kFnvPrime;
+    }
+    // Final mix so nearby seeds give unrelated slot layouts
+    h ^= h >> 15;
+    h *= 0x2c1b3c6dU;
+    h ^= h >> 12;
+    return h;
+}
+
+bool equals_ignore_case(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool KeyMap::parse_list(std::string_view list_reply) {
+    names_.clear();
+    table_.clear();
+    content_hash_ = 0;
+
+    size_t pos = 0;
+    while (pos < list_reply.size()) {
+        size_t end = list_reply.find('\n', pos);
+        if (end == std::string_view::npos) {
+            end = list_reply.size();
+        }
+        std::string_view line = list_reply.substr(pos, end - pos);
+        pos = end + 1;
+
+        // Key lines are indented: "  cook_time  (Cook Time)"
+        if (line.size() < 3 || line[0] != ' ') {
+            continue;
+        }
+        size_t start = line.find_first_not_of(' ');
+        size_t stop = line.find(' ', start);
+        if (start == std::string_view::npos || stop == std::string_view::npos ||
+            line.find('(', stop) == std::string_view::npos) {
+            continue;
+        }
+        if (names_.size() == kMaxKeys) {
+            names_.clear();
+            return false;
+        }
+        names_.emplace_back(line.substr(start, stop - start));
+    }
+
+    if (names_.empty() || !build_table()) {
+        names_.clear();
+        table_.clear();
+        return false;
+    }
+
+    content_hash_ = kFnvOffset;
+    for (const std::string& name : names_) {
+        for (char c : name) {
+            content_hash_ ^= static_cast<uint8_t>(lower(c));
+            content_hash_ *= kFnvPrime;
+        }
+        content_hash_ ^= 0xFF; // separator
+        content_hash_ *= kFnvPrime;
+    }
+    return true;
+}
+
+bool KeyMap::build_table() {
+    size_t slots = 1;
+    while (slots < names_.size() * 2) {
+        slots <<= 1;
+    }
+    mask_ = static_cast<uint32_t>(slots - 1);
+
+    for (uint32_t seed = 0; seed < kMaxSeedAttempts; ++seed) {
+        table_.assign(slots, -1);
+        bool collision = false;
+        for (size_t i = 0; i < names_.size() && !collision; ++i) {
+            int8_t& slot = table_[hash_name(names_[i], seed) & mask_];
+            if (slot >= 0) {
+                // Either a real collision or a duplicate name; both need a new seed
+                collision = true;
+            } else {
+                slot = static_cast<int8_t>(i);
+            }
+        }
+        if (!collision) {
+            seed_ = seed;
+            return true;
+        }
+    }
+    return false;
+}
+
+int KeyMap::find(std::string_view name) const {
+    if (table_.empty()) {
+        return -1;
+    }
+    int8_t index = table_[hash_name(name, seed_) & mask_];
+    if (index < 0 || !equals_ignore_case(names_[index], name)) {
+        return -1;
+    }
+    return index;
+}
+
+const char* KeyMap::name(int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= names_.size()) {
+        return nullptr;
+    }
+    return names_[index].c_str();
+}
@@ -0,0 +1,62 @@
+//
+// Host-side copy of the firmware's key table, discovered through 'list'.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_KEY_MAP_H
+#define MD1001LB_MICROWAVE_CONTROLLER_KEY_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Case-insensitive map from key name to firmware key index.
+ *
+ * Built from the text the firmware prints for 'list', in the same order as
+ * its kKeyMap, so indices match the firmware (and MICROWAVE_KEY_*). Lookups
+ * use a perfect hash: a seed is searched at build time so that every name
+ * lands in its own slot, and find() costs one hash plus one string compare.
+ * Immutable once built, so it may be read from any thread.
+ */
+class KeyMap {
+public:
+    static constexpr size_t kMaxKeys = 64;
+
+    /**
+     * @brief Parses a 'list' reply ("  <name>  (<label>)" per key).
+     *
+     * @return false (and leaves the map empty) if no keys were found or the
+     *         names cannot be hashed.
+     */
+    bool parse_list(std::string_view list_reply);
+
+    /**
+     * @return The key index, or -1 if the name is unknown.
+     */
+    int find(std::string_view name) const;
+
+    /**
+     * @return The firmware's spelling of a key, or nullptr if out of range.
+     */
+    const char* name(int index) const;
+
+    size_t size() const { return names_.size(); }
+    bool empty() const { return names_.empty(); }
+
+    /**
+     * @brief FNV-1a over the lowercased names in order (0 when empty).
+     */
+    uint32_t content_hash() const { return content_hash_; }
+
+private:
+    bool build_table();
+
+    std::vector<std::string> names_;
+    std::vector<int8_t> table_;   // slot -> key index, -1 = empty
+    uint32_t seed_ = 0;
+    uint32_t mask_ = 0;
+    uint32_t content_hash_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_KEY_MAP_H
@@ -0,0 +1,115 @@
+//
+// Key timing calibration.
+//
+
+#include "key_timing.h"
+
+#include <algorithm>
+
+namespace {
+
+// Bounds on any learned time: below 20 ms USB scheduling jitter is of the
+// same order as the press itself; above 1 s something is wrong with the scan.
+constexpr uint32_t kMinMs = 20;
+constexpr uint32_t kMaxMs = 1000;
+constexpr uint16_t kMaxPenaltyPercent = 400;
+// Clean presses needed before a penalty is eased by 10%
+constexpr uint16_t kSuccessesPerEase = 32;
+
+uint16_t scans_to_ms(uint32_t scans, uint32_t period_us, uint32_t penalty_percent) {
+    uint64_t us = uint64_t{scans} * period_us * KeyTimings::kMarginPercent / 100 * penalty_percent / 100;
+    return static_cast<uint16_t>(std::clamp<uint64_t>((us + 999) / 1000, kMinMs, kMaxMs));
+}
+
+} // namespace
+
+uint32_t KeyTimings::press_ms(int32_t key) const {
+    if (key < 0 || static_cast<size_t>(key) >= kMaxKeys || keys_[key].press_ms == 0) {
+        return kDefaultPressMs;
+    }
+    return keys_[key].press_ms;
+}
+
+uint32_t KeyTimings::gap_ms(int32_t key) const {
+    if (key < 0 || static_cast<size_t>(key) >= kMaxKeys || keys_[key].gap_ms == 0) {
+        return kDefaultGapMs;
+    }
+    return keys_[key].gap_ms;
+}
+
+uint32_t KeyTimings::max_gap_ms() const {
+    uint32_t longest = 0;
+    for (size_t i = 0; i < kMaxKeys; ++i) {
+        longest = std::max(longest, gap_ms(static_cast<int32_t>(i)));
+    }
+    return longest;
+}
+
+void KeyTimings::derive(Key& key) {
+    if (key.period_us == 0) {
+        return;
+    }
+    key.press_ms = scans_to_ms(kRegisterScans, key.period_us, key.penalty_percent);
+    key.gap_ms = scans_to_ms(kReleaseScans, key.period_us, key.penalty_percent);
+}
+
+void KeyTimings::calibrate(const uint32_t* strobes, size_t count, uint32_t window_ms) {
+    for (size_t i = 0; i < std::min(count, kMaxKeys); ++i) {
+        if (strobes[i] < 2) {
+            continue; // row not scanned (oven off?) or too slow to tell
+        }
+        Key& key = keys_[i];
+        key.period_us = static_cast<uint32_t>(uint64_t{window_ms} * 1000 / strobes[i]);
+        key.successes = 0;
+        derive(key);
+    }
+}
+
+bool KeyTimings::observe_press(int32_t key_index, uint32_t held_ms, uint32_t strobes) {
+    if (key_index < 0 || static_cast<size_t>(key_index) >= kMaxKeys) {
+        return true;
+    }
+    Key& key = keys_[key_index];
+    if (strobes >= 2) {
+        uint32_t sample = static_cast<uint32_t>(uint64_t{held_ms} * 1000 / strobes);
+        key.period_us = key.period_us ? (3 * key.period_us + sample) / 4 : sample;
+    }
+    const bool registered = strobes >= kRegisterScans;
+    if (!registered) {
+        key.penalty_percent = std::min<uint16_t>(kMaxPenaltyPercent, key.penalty_percent * 3 / 2);
+        key.successes = 0;
+    } else if (++key.successes >= kSuccessesPerEase) {
+        key.penalty_percent = std::max<uint16_t>(100, key.penalty_percent * 9 / 10);
+        key.successes = 0;
+    }
+    derive(key);
+    return registered;
+}
+
+void KeyTimings::press_failed(int32_t key_index) {
+    if (key_index < 0 || static_cast<size_t>(key_index) >= kMaxKeys) {
+        return;
+    }
+    Key& key = keys_[key_index];
+    key.penalty_percent = std::min<uint16_t>(kMaxPenaltyPercent, key.penalty_percent * 3 / 2);
+    key.successes = 0;
+    derive(key);
+}
+
+void KeyTimings::save(uint16_t* press_ms, uint16_t* gap_ms, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        press_ms[i] = i < kMaxKeys ? keys_[i].press_ms : 0;
+        gap_ms[i] = i < kMaxKeys ? keys_[i].gap_ms : 0;
+    }
+}
+
+void KeyTimings::load(const uint16_t* press_ms, const uint16_t* gap_ms, size_t count) {
+    for (size_t i = 0; i < std::min(count, kMaxKeys); ++i) {
+        Key& key = keys_[i];
+        key = Key{};
+        key.press_ms = press_ms[i];
+        key.gap_ms = gap_ms[i];
+        // Work the period back out so penalties and new samples apply to it
+        key.period_us = static_cast<uint32_t>(uint64_t{press_ms[i]} * 1000 * 100 / kMarginPercent / kRegisterScans);
+    }
+}
@@ -0,0 +1,86 @@
+//
+// Per-key press and gap lengths, learned from how fast the oven scans its
+// keypad.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_KEY_TIMING_H
+#define MD1001LB_MICROWAVE_CONTROLLER_KEY_TIMING_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief How long to hold each key and how long to leave the keypad alone
+ *        after it.
+ *
+ * The oven's controller strobes one keypad row at a time and only accepts a
+ * key it has seen on several strobes in a row, and a release likewise. Both
+ * times therefore follow from the row's strobe period: kRegisterScans
+ * periods to press, kReleaseScans to release, each with a kMarginPercent
+ * safety margin. The period comes from a 'scan' (calibrate) and keeps being
+ * refined from every press's strobe count (observe_press). A press that saw
+ * too few strobes, or lost the scan altogether, multiplies that key's times
+ * by a penalty that successful presses slowly wear down again.
+ *
+ * Keys without a measurement use the firmware defaults. Trivially copyable,
+ * so a session can publish it through a Seqlock.
+ */
+class KeyTimings {
+public:
+    static constexpr size_t kMaxKeys = 32;
+    static constexpr uint32_t kDefaultPressMs = 150;
+    static constexpr uint32_t kDefaultGapMs = 150;
+    static constexpr uint32_t kRegisterScans = 3;
+    static constexpr uint32_t kReleaseScans = 2;
+    static constexpr uint32_t kMarginPercent = 150;
+
+    uint32_t press_ms(int32_t key) const;
+    uint32_t gap_ms(int32_t key) const;
+
+    /**
+     * @brief The longest gap of any key: the pause for commands that end a
+     *        press without naming the key (e.g. 'release').
+     */
+    uint32_t max_gap_ms() const;
+
+    /**
+     * @brief Takes a 'scan' result: strobes[i] strobes of key i's row in window_ms.
+     *
+     * Keys whose row was not strobed at least twice keep their times.
+     */
+    void calibrate(const uint32_t* strobes, size_t count, uint32_t window_ms);
+
+    /**
+     * @brief Learns from one finished press of held_ms that saw strobes strobes.
+     *
+     * @return false if the press was too short for the oven to register it.
+     */
+    bool observe_press(int32_t key, uint32_t held_ms, uint32_t strobes);
+
+    /**
+     * @brief Backs a key off after its row stopped being scanned mid-press.
+     */
+    void press_failed(int32_t key);
+
+    /**
+     * @brief Copies the times out for storage (0 = default) or back in.
+     *
+     * Loaded times stand until the next measurement of the key.
+     */
+    void save(uint16_t* press_ms, uint16_t* gap_ms, size_t count) const;
+    void load(const uint16_t* press_ms, const uint16_t* gap_ms, size_t count);
+
+private:
+    struct Key {
+        uint32_t period_us = 0;     // row strobe period, 0 = not measured
+        uint16_t press_ms = 0;      // 0 = default
+        uint16_t gap_ms = 0;
+        uint16_t penalty_percent = 100;
+        uint16_t successes = 0;     // since the penalty last changed
+    };
+
+    void derive(Key& key);
+
+    Key keys_[kMaxKeys];
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_KEY_TIMING_H
@@ -0,0 +1,165 @@
+//
+// Keystroke search for timed runs.
+//
+
+#include "keystroke_planner.h"
+
+#include "arduino_link.h"
+
+#include <cstdio>
+
+namespace {
+
+constexpr int32_t kDigitKeys[10] = {
+    MICROWAVE_KEY_0, MICROWAVE_KEY_1, MICROWAVE_KEY_2, MICROWAVE_KEY_3, MICROWAVE_KEY_4,
+    MICROWAVE_KEY_5, MICROWAVE_KEY_6, MICROWAVE_KEY_7, MICROWAVE_KEY_8, MICROWAVE_KEY_9,
+};
+
+struct Candidate {
+    KeystrokePlan plan;
+    bool conventional = true;   // seconds field 0-59
+
+    bool push(int32_t key) {
+        if (plan.count == KeystrokePlan::kMaxKeys) {
+            return false;
+        }
+        plan.keys[plan.count++] = key;
+        return true;
+    }
+};
+
+bool better(const Candidate& a, const Candidate& b) {
+    if (a.plan.predicted_ms != b.plan.predicted_ms) {
+        return a.plan.predicted_ms < b.plan.predicted_ms;
+    }
+    if (a.plan.count != b.plan.count) {
+        return a.plan.count < b.plan.count;
+    }
+    return a.conventional && !b.conventional;
+}
+
+
+uint32_t stops_to_idle(OvenMode mode) {
+    switch (mode) {
+    case OvenMode::kIdle:
+        return 0;
+    case OvenMode::kCooking:
+    case OvenMode::kUnknown:
+        return 2; // pause, then clear
+    default:
+        return 1;
+    }
+}
+
+} // namespace
+
+bool plan_run(uint32_t seconds, uint32_t power_level, bool start, const OvenState& from,
+              const ApplianceModel& model, const KeyTimings& timings, KeystrokePlan& plan) {
+    if (seconds == 0 || seconds > 99 * 60 + 59 || model.power_steps == 0) {
+        return false;
+    }
+    const uint32_t step = 100 / model.power_steps;
+    if (power_level == 0 || power_level > 100 || power_level % step != 0) {
+        power_level = 100;
+    }
+    // One press to show the level, then one per step down; the ring only wraps
+    // back up to 100%, which needs no presses at all
+    const uint32_t power_presses = power_level == 100 ? 0 : 1 + (100 - power_level) / step;
+
+    Candidate best;
+    bool found = false;
+    auto consider = [&](Candidate& candidate) {
+        candidate.plan.cook_seconds = seconds;
+        candidate.plan.power_level = power_level;
+        candidate.plan.starts = start;
+        candidate.plan.predicted_ms = 0;
+        for (size_t i = 0; i < candidate.plan.count; ++i) {
+            const int32_t key = candidate.plan.keys[i];
+            candidate.plan.predicted_ms += timings.press_ms(key) + timings.gap_ms(key);
+        }
+        if (!found || better(candidate, best)) {
+            best = candidate;
+            found = true;
+        }
+    };
+
+    // The time is already entered: only walk the power ring (and start)
+    if ((from.mode == OvenMode::kEnteringTime || from.mode == OvenMode::kPowerSet) && from.seconds == seconds) {
+        uint32_t presses = power_presses;
+        if (from.mode == OvenMode::kPowerSet) {
+            const uint32_t at = (100 - from.power_level) / step;
+            const uint32_t to = (100 - power_level) / step;
+            presses = (to + model.power_steps - at) % model.power_steps;
+        }
+        Candidate candidate;
+        bool fits = true;
+        for (uint32_t i = 0; i < presses && fits; ++i) {
+            fits = candidate.push(MICROWAVE_KEY_POWER);
+        }
+        if (start && fits) {
+            fits = candidate.push(MICROWAVE_KEY_START);
+        }
+        if (fits) {
+            consider(candidate);
+        }
+    }
+
+    // Paused with exactly this run left: resume it
+    if (from.mode == OvenMode::kPaused && start && from.seconds == seconds && from.power_level == power_level) {
+        Candidate candidate;
+        candidate.push(MICROWAVE_KEY_START);
+        consider(candidate);
+    }
+
+    // Otherwise clear the oven and enter the run from scratch
+    Candidate cleared;
+    for (uint32_t i = 0; i < stops_to_idle(from.mode); ++i) {
+        cleared.push(MICROWAVE_KEY_STOP);
+    }
+
+    // Cook Time + digits (+ Power presses) (+ Start), for every minutes/seconds split
+    for (uint32_t minutes = 0; minutes <= 99 && minutes * 60 <= seconds; ++minutes) {
+        uint32_t rest = seconds - minutes * 60;
+        if (rest > model.max_seconds_field || rest > 99) {
+            continue;
+        }
+        char digits[8];
+        if (minutes > 0) {
+            std::snprintf(digits, sizeof(digits), "%u%02u", static_cast<unsigned>(minutes), static_cast<unsigned>(rest));
+        } else {
+            std::snprintf(digits, sizeof(digits), "%u", static_cast<unsigned>(rest));
+        }
+
+        Candidate candidate = cleared;
+        candidate.conventional = rest < 60;
+        bool fits = candidate.push(MICROWAVE_KEY_COOK_TIME);
+        for (const char* d = digits; *d && fits; ++d) {
+            fits = candidate.push(kDigitKeys[*d - '0']);
+        }
+        for (uint32_t i = 0; i < power_presses && fits; ++i) {
+            fits = candidate.push(MICROWAVE_KEY_POWER);
+        }
+        if (start && fits) {
+            fits = candidate.push(MICROWAVE_KEY_START);
+        }
+        if (fits) {
+            consider(candidate);
+        }
+    }
+
+    // Express start: Start alone, express_seconds per press at full power
+    if (start && power_level == 100 && model.express_seconds > 0 && seconds % model.express_seconds == 0 &&
+        cleared.plan.count + seconds / model.express_seconds <= KeystrokePlan::kMaxKeys) {
+        Candidate candidate = cleared;
+        for (uint32_t i = 0; i < seconds / model.express_seconds; ++i) {
+            candidate.push(MICROWAVE_KEY_START);
+        }
+        consider(candidate);
+    }
+
+    if (!found) {
+        return false;
+    }
+    plan = best.plan;
+    return true;
+}
@@ -0,0 +1,50 @@
+//
+// Plans the keystrokes that set up a timed run on the MD1001LB keypad.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_KEYSTROKE_PLANNER_H
+#define MD1001LB_MICROWAVE_CONTROLLER_KEYSTROKE_PLANNER_H
+
+#include "key_timing.h"
+#include "oven_shadow.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A key sequence and what it will do.
+ */
+struct KeystrokePlan {
+    static constexpr size_t kMaxKeys = 24;
+
+    int32_t keys[kMaxKeys];     // MICROWAVE_KEY_*
+    size_t count = 0;
+    uint32_t cook_seconds = 0;
+    uint32_t power_level = 0;
+    bool starts = false;        // ends with the oven cooking
+    uint32_t predicted_ms = 0;  // time to send every key, with the pause after each
+};
+
+/**
+ * @brief Finds the cheapest key sequence for a run, starting from the
+ *        oven's current state.
+ *
+ * Tries every way the model allows to get there: keeping a matching time
+ * that is already entered (only adjusting power), or the "Stop" presses
+ * that clear the oven followed by any digit entry (with and without
+ * seconds overflow) or express start. Keeps the one that takes the least
+ * time to send; ties go to the fewest presses, then to the conventional
+ * MM:SS entry.
+ *
+ * @param seconds Cook time, 1 s to 99:59.
+ * @param power_level Percent, a multiple of 100 / power_steps; anything else means 100.
+ * @param start Whether the plan must end with the oven cooking ("Start"
+ *        pressed); run_microwave leaves the oven ready to start instead.
+ * @param from Where the oven is now; unknown costs the two "Stop" presses
+ *        that clear it whatever it was doing.
+ *
+ * @return false if the time cannot be entered.
+ */
+bool plan_run(uint32_t seconds, uint32_t power_level, bool start, const OvenState& from,
+              const ApplianceModel& model, const KeyTimings& timings, KeystrokePlan& plan);
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_KEYSTROKE_PLANNER_H
@@ -0,0 +1,438 @@
+//
+// Serial runtime benchmark against the pty emulator.
+//
+// Spawns one emulated board per port (each in its own process, so the CPU
+// figures below only cover the DLL), opens them all through the public API and
+// drives a fixed number of commands per port from one thread per port.
+//
+// Build the tree twice (default and -DMD1001LB_USE_IO_URING=ON) and compare:
+//   link_bench [ports=150] [commands_per_port=50] [command=status]
+//
+// syscalls/command counts every syscall entry of the bench process and its
+// threads (the runtime's I/O thread included) on the raw_syscalls:sys_enter
+// tracepoint, so io_uring_enter is counted like any read or write. The reads
+// and writes io_uring performs for a submission are not syscalls and show up
+// only as the io_uring_enter that submitted them. Reading the tracepoint's
+// id needs a mounted tracefs, which is usually root's; without it the figure
+// reads n/a and `strace -f -c` gives the same count per syscall.
+//
+// Latency under a bad link, one board, one profile after another:
+//   link_bench faults [commands=500] [command=status] [timeout_ms=500] [retries=2]
+//
+// Each command is retried up to retries times after a failure. Latency is
+// what the caller saw, retries included; the error breakdown counts every
+// failed attempt. Pick the command timeout and retry count from the p99.9
+// and success columns of the profiles the link in question resembles.
+//
+// Long cooks on a virtual clock, one board and one thread per oven:
+//   link_bench virtual [ovens=4] [cooks=3] [cook_seconds=60]
+//
+// Every oven runs a recipe of back-to-back cooks and then waits for the last
+// one, while the library and the boards share a virtual clock (see
+// set_microwave_virtual_time). Virtual time should match what the recipes
+// ask for, wall time only the key presses in between.
+//
+
+#include "arduino_link.h"
+#include "emulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define API_SUCCESS 0
+#define API_ERROR_SERIAL_FAIL -2
+#define API_ERROR_ARDUINO_ERR -6
+#define API_ERROR_ABORTED -8
+#define API_ERROR_BAD_COMMAND -9
+#define API_ERROR_TIMEOUT -10
+
+struct ProcessCounters {
+    double cpu_seconds = 0;
+    uint64_t syscalls = 0;
+    long voluntary_switches = 0;
+};
+
+/**
+ * @brief Opens a counter of raw_syscalls:sys_enter for this process and every
+ *        thread it starts from now on, or returns -1.
+ *
+ * Open it after forking the emulators, which are not to be counted.
+ */
+static int open_syscall_counter() {
+    uint64_t id = 0;
+    for (const char* path : {"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                             "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"}) {
+        std::ifstream file(path);
+        if (file >> id) {
+            break;
+        }
+    }
+    if (id == 0) {
+        return -1;
+    }
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.config = id;
+    attr.inherit = 1;   // threads started later, such as the runtime's
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static ProcessCounters sample_counters(int syscall_counter) {
+    ProcessCounters c;
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    c.cpu_seconds = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+                    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    c.voluntary_switches = ru.ru_nvcsw;
+    if (syscall_counter >= 0 && read(syscall_counter, &c.syscalls, sizeof(c.syscalls)) != sizeof(c.syscalls)) {
+        c.syscalls = 0;
+    }
+    return c;
+}
+
+struct FaultCase {
+    const char* name;
+    microwave_fault_profile profile; // seed, drop, corrupt, duplicate, spike:ms, stall:ms, disconnect
+};
+
+// Rates are per byte for the first three and per read or write for the rest
+static const FaultCase kFaultCases[] = {
+    {"clean", {}},
+    {"lossy", {1, 2000, 0, 0, 0, 0, 0, 0, 0}},
+    {"noisy", {2, 0, 2000, 0, 0, 0, 0, 0, 0}},
+    {"duplicating", {3, 0, 0, 2000, 0, 0, 0, 0, 0}},
+    {"spiky", {4, 0, 0, 0, 20000, 100, 0, 0, 0}},
+    {"stalling", {5, 0, 0, 0, 0, 0, 2000, 1000, 0}},
+    {"flapping", {6, 0, 0, 0, 0, 0, 0, 0, 1000}},
+    {"bad hub", {7, 500, 500, 500, 10000, 50, 500, 500, 200}},
+};
+
+static const char* error_name(int32_t result) {
+    switch (result) {
+    case API_ERROR_SERIAL_FAIL:
+        return "serial";
+    case API_ERROR_ARDUINO_ERR:
+        return "firmware ERR";
+    case API_ERROR_ABORTED:
+        return "aborted";
+    case API_ERROR_BAD_COMMAND:
+        return "bad command";
+    case API_ERROR_TIMEOUT:
+        return "timeout";
+    default:
+        return "other";
+    }
+}
+
+static double percentile_ms(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size()) + 0.999999);
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+static int run_fault_bench(int argc, char** argv) {
+    const int commands = argc > 2 ? std::atoi(argv[2]) : 500;
+    const std::string command = argc > 3 ? argv[3] : "status";
+    const uint32_t timeout_ms = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 500;
+    const int retries = argc > 5 ? std::atoi(argv[5]) : 2;
+
+    // --- 1. One emulated board ---
+    std::string path;
+    int master = emulator_open_pty(path);
+    if (master < 0) {
+        std::cerr << "Failed to create pty" << std::endl;
+        return 1;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        emulator_run(master);
+    }
+    close(master);
+    MicrowaveHandle handle = child > 0 ? open_microwave_controller(path.c_str(), 115200) : 0;
+    if (handle == 0) {
+        std::cerr << "Failed to open " << path << std::endl;
+        if (child > 0) {
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+        }
+        return 1;
+    }
+    set_microwave_command_timeout(handle, timeout_ms);
+    set_microwave_reconnect_policy(handle, MICROWAVE_RECONNECT_FAIL_INFLIGHT, 2000);
+
+    std::printf("%d x '%s', timeout %u ms, up to %d retries\n", commands, command.c_str(),
+                static_cast<unsigned>(timeout_ms), retries);
+    std::printf("%-12s %8s %8s %8s %8s %9s %9s  %s\n", "profile", "p50 ms", "p99 ms", "p99.9 ms", "max ms",
+                "1st try", "success", "failed attempts");
+
+    // --- 2. Every profile against the same board ---
+    bool clean_ok = true;
+    for (const FaultCase& fault : kFaultCases) {
+        set_microwave_fault_profile(handle, &fault.profile);
+        std::vector<double> latencies;
+        std::map<std::string, int> errors;
+        int first_try = 0;
+        int succeeded = 0;
+        for (int n = 0; n < commands; ++n) {
+            auto start = std::chrono::steady_clock::now();
+            int32_t result = send_microwave_command(handle, command.c_str());
+            first_try += result == API_SUCCESS;
+            // After a timeout the library resyncs before the retry goes out,
+            // so a late reply to one attempt is never taken for the next's
+            for (int attempt = 0; result != API_SUCCESS; ++attempt) {
+                ++errors[error_name(result)];
+                if (attempt == retries) {
+                    break;
+                }
+                result = send_microwave_command(handle, command.c_str());
+            }
+            succeeded += result == API_SUCCESS;
+            latencies.push_back(
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        std::string breakdown;
+        for (const auto& [name, count] : errors) {
+            breakdown += (breakdown.empty() ? "" : ", ") + name + " " + std::to_string(count);
+        }
+        std::printf("%-12s %8.2f %8.2f %8.2f %8.1f %8.1f%% %8.1f%%  %s\n", fault.name, percentile_ms(latencies, 0.5),
+                    percentile_ms(latencies, 0.99), percentile_ms(latencies, 0.999),
+                    latencies.empty() ? 0.0 : latencies.back(), commands ? 100.0 * first_try / commands : 0.0,
+                    commands ? 100.0 * succeeded / commands : 0.0, breakdown.empty() ? "-" : breakdown.c_str());
+        if (fault.profile.seed == 0) {
+            clean_ok = succeeded == commands;
+        }
+
+        set_microwave_fault_profile(handle, nullptr);
+    }
+
+    // --- 3. Tear down ---
+    close_microwave_controller(handle);
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    return clean_ok ? 0 : 1;
+}
+
+static int run_virtual_bench(int argc, char** argv) {
+    const int ovens = argc > 2 ? std::atoi(argv[2]) : 4;
+    const int cooks = argc > 3 ? std::atoi(argv[3]) : 3;
+    const int cook_seconds = argc > 4 ? std::atoi(argv[4]) : 60;
+    const std::string clock_path = "/tmp/md1001lb_bench_clock." + std::to_string(getpid());
+    const std::string recipe_path = "/tmp/md1001lb_bench_recipe." + std::to_string(getpid());
+
+    // --- 1. The recipe: each cook, then a second for the oven to beep ---
+    {
+        std::ofstream recipe(recipe_path);
+        for (int n = 0; n < cooks; ++n) {
+            recipe << "run " << cook_seconds / 60 << ':' << (cook_seconds % 60 < 10 ? "0" : "")
+                   << cook_seconds % 60 << "\nwait " << cook_seconds + 1 << "s\n";
+        }
+    }
+
+    // --- 2. Boards on the clock (they attach it from the environment) ---
+    setenv("MD1001LB_VIRTUAL_CLOCK", clock_path.c_str(), 1);
+    std::vector<std::string> paths;
+    std::vector<pid_t> children;
+    for (int i = 0; i < ovens; ++i) {
+        std::string path;
+        int master = emulator_open_pty(path);
+        if (master < 0) {
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            emulator_run(master);
+        }
+        close(master);
+        if (pid < 0) {
+            break;
+        }
+        paths.push_back(path);
+        children.push_back(pid);
+    }
+    if (set_microwave_virtual_time(clock_path.c_str(), static_cast<uint32_t>(paths.size())) != API_SUCCESS) {
+        std::cerr << "Cannot attach " << clock_path << std::endl;
+        return 1;
+    }
+
+    // --- 3. One thread per oven: open, run the recipe, wait for the end ---
+    std::vector<int32_t> results(paths.size(), API_ERROR_SERIAL_FAIL);
+    std::vector<microwave_recipe_report> reports(paths.size());
+    uint64_t virtual_start = 0;
+    uint64_t virtual_end = 0;
+    get_microwave_clock(&virtual_start);
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            workers.emplace_back([&, i]() {
+                MicrowaveHandle handle = open_microwave_controller(paths[i].c_str(), 115200);
+                if (handle == 0) {
+                    return;
+                }
+                results[i] = run_microwave_recipe(handle, recipe_path.c_str());
+                if (results[i] == API_SUCCESS) {
+                    results[i] = wait_microwave_done(handle, 5000);
+                }
+                get_microwave_recipe_report(handle, &reports[i]);
+                close_microwave_controller(handle);
+            });
+        }
+        for (auto& t : workers) t.join();
+    }
+    get_microwave_clock(&virtual_end);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double simulated = static_cast<double>(virtual_end - virtual_start) / 1e6;
+
+    // --- 4. Report ---
+    int ok = 0;
+    uint32_t max_jitter_us = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        ok += results[i] == API_SUCCESS;
+        max_jitter_us = std::max(max_jitter_us, reports[i].max_jitter_us);
+    }
+    std::printf("ovens                  : %zu (%d finished every cook)\n", paths.size(), ok);
+    std::printf("cooks per oven         : %d x %d s\n", cooks, cook_seconds);
+    std::printf("virtual time           : %.1f s\n", simulated);
+    std::printf("wall time              : %.1f s (%.0fx)\n", wall, wall > 0 ? simulated / wall : 0.0);
+    std::printf("recipe jitter max      : %u us\n", static_cast<unsigned>(max_jitter_us));
+
+    // --- 5. Tear down ---
+    for (pid_t pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    std::remove(recipe_path.c_str());
+    std::remove(clock_path.c_str());
+    return ok == static_cast<int>(paths.size()) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "faults") {
+        return run_fault_bench(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "virtual") {
+        return run_virtual_bench(argc, argv);
+    }
+    const int ports = argc > 1 ? std::atoi(argv[1]) : 150;
+    const int commands_per_port = argc > 2 ? std::atoi(argv[2]) : 50;
+    const std::string command = argc > 3 ? argv[3] : "status";
+#if defined(MD1001LB_USE_IO_URING)
+    const char* backend = "io_uring";
+#else
+    const char* backend = "epoll";
+#endif
+
+    // --- 1. Spawn the emulated boards ---
+    std::vector<std::string> paths;
+    std::vector<pid_t> children;
+    for (int i = 0; i < ports; ++i) {
+        std::string path;
+        int master = emulator_open_pty(path);
+        if (master < 0) {
+            std::cerr << "Failed to create pty " << i << std::endl;
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            emulator_run(master);
+        }
+        close(master);
+        if (pid < 0) {
+            break;
+        }
+        paths.push_back(path);
+        children.push_back(pid);
+    }
+
+    // Before the runtime's thread exists, so that it is counted
+    const int syscall_counter = open_syscall_counter();
+
+    // --- 2. Open every port concurrently ---
+    std::vector<MicrowaveHandle> handles(paths.size(), 0);
+    {
+        std::vector<std::thread> openers;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            openers.emplace_back([&, i]() {
+                handles[i] = open_microwave_controller(paths[i].c_str(), 115200);
+            });
+        }
+        for (auto& t : openers) t.join();
+    }
+
+    // --- 3. Drive commands ---
+    std::vector<int> failures(handles.size(), 0);
+    ProcessCounters before = sample_counters(syscall_counter);
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < handles.size(); ++i) {
+            workers.emplace_back([&, i]() {
+                for (int n = 0; n < commands_per_port; ++n) {
+                    if (send_microwave_command(handles[i], command.c_str()) != API_SUCCESS) {
+                        ++failures[i];
+                    }
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ProcessCounters after = sample_counters(syscall_counter);
+
+    // --- 4. Report ---
+    long total = static_cast<long>(handles.size()) * commands_per_port;
+    long failed = 0;
+    for (size_t i = 0; i < handles.size(); ++i) {
+        failed += handles[i] == 0 ? commands_per_port : failures[i];
+    }
+    double cpu = after.cpu_seconds - before.cpu_seconds;
+    double syscalls = static_cast<double>(after.syscalls - before.syscalls);
+
+    std::printf("backend                : %s\n", backend);
+    std::printf("ports                  : %zu\n", handles.size());
+    std::printf("commands               : %ld (%ld failed) '%s'\n", total, failed, command.c_str());
+    std::printf("throughput             : %.1f commands/s\n", total / wall);
+    std::printf("cpu per 1000 commands  : %.2f ms\n", total ? cpu * 1000.0 / total * 1000.0 : 0.0);
+    std::printf("cpu load @1000 cmd/s   : %.2f %%\n", total ? cpu / total * 1000.0 * 100.0 : 0.0);
+    if (syscall_counter >= 0) {
+        std::printf("syscalls/cmd           : %.2f\n", total ? syscalls / total : 0.0);
+    } else {
+        std::printf("syscalls/cmd           : n/a (no raw_syscalls:sys_enter counter)\n");
+    }
+    std::printf("voluntary ctx sw/cmd   : %.2f\n",
+                total ? static_cast<double>(after.voluntary_switches - before.voluntary_switches) / total : 0.0);
+
+    // --- 5. Tear down ---
+    for (MicrowaveHandle h : handles) {
+        if (h != 0) close_microwave_controller(h);
+    }
+    if (syscall_counter >= 0) {
+        close(syscall_counter);
+    }
+    for (pid_t pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+//
+// Asynchronous log ring, flusher thread and sinks.
+//
+
+#include "link_log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+std::atomic<int32_t> g_link_log_level{MICROWAVE_LOG_WARN};
+
+namespace {
+
+constexpr size_t kRingCapacity = 512; // power of two
+constexpr size_t kMessageLength = 192;
+constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+
+struct LogRecord {
+    int32_t level;
+    MicrowaveHandle handle;
+    int64_t timestamp_ms; // system clock, for the file sink
+    char port[sizeof(LinkLogContext::port)];
+    char message[kMessageLength];
+};
+
+// Bounded MPSC ring (Vyukov). Each cell's sequence says whether it is free for
+// the producer claiming position `pos` (== pos) or holds data for the
+// consumer reading `pos` (== pos + 1).
+struct Cell {
+    std::atomic<size_t> sequence;
+    LogRecord record;
+};
+
+struct LogState {
+    Cell cells[kRingCapacity];
+    std::atomic<size_t> enqueue_pos{0};
+    size_t dequeue_pos = 0;                 // guarded by drain_mutex
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex drain_mutex;                 // single consumer at a time
+
+    std::mutex sink_mutex;
+    microwave_log_callback callback = nullptr;
+    void* callback_user = nullptr;
+    std::FILE* file = nullptr;
+    std::string file_path;
+    uint64_t file_size = 0;
+    uint64_t file_max_bytes = 0;
+    uint32_t file_max_files = 0;
+
+    std::mutex thread_mutex;
+    std::condition_variable wake;
+    bool stop_requested = false;
+    std::thread flusher;
+
+    LogState() {
+        for (size_t i = 0; i < kRingCapacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+};
+
+LogState& log_state() {
+    // Leaked for the same reason as the I/O runtime: nothing here may run
+    // from static destructors.
+    static LogState* state = new LogState();
+    return *state;
+}
+
+const char* level_name(int32_t level) {
+    switch (level) {
+        case MICROWAVE_LOG_TRACE: return "TRACE";
+        case MICROWAVE_LOG_DEBUG: return "DEBUG";
+        case MICROWAVE_LOG_INFO:  return "INFO";
+        case MICROWAVE_LOG_WARN:  return "WARN";
+        case MICROWAVE_LOG_ERROR: return "ERROR";
+        default:                  return "?";
+    }
+}
+
+// Shifts path.N-1 -> path.N ... path -> path.1 and reopens path.
+void rotate_file(LogState& st) {
+    std::fclose(st.file);
+    st.file = nullptr;
+    if (st.file_max_files > 0) {
+        std::string oldest = st.file_path + "." + std::to_string(st.file_max_files);
+        std::remove(oldest.c_str());
+        for (uint32_t i = st.file_max_files; i > 1; --i) {
+            std::string from = st.file_path + "." + std::to_string(i - 1);
+            std::string to = st.file_path + "." + std::to_string(i);
+            std::rename(from.c_str(), to.c_str());
+        }
+        std::rename(st.file_path.c_str(), (st.file_path + ".1").c_str());
+    } else {
+        std::remove(st.file_path.c_str());
+    }
+    st.file = std::fopen(st.file_path.c_str(), "a");
+    st.file_size = 0;
+}
+
+void deliver(LogState& st, const LogRecord& rec) {
+    std::lock_guard<std::mutex> lock(st.sink_mutex);
+    if (st.callback) {
+        st.callback(rec.level, rec.handle, rec.message, st.callback_user);
+    }
+    if (st.file || !st.callback) {
+        char stamp[32];
+        std::time_t secs = static_cast<std::time_t>(rec.timestamp_ms / 1000);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", std::gmtime(&secs));
+
+        char line[kMessageLength + 128];
+        int n = std::snprintf(line, sizeof(line), "%s.%03dZ %-5s [%ld%s%s] %s\n",
+                              stamp, static_cast<int>(rec.timestamp_ms % 1000), level_name(rec.level),
+                              static_cast<long>(rec.handle), rec.port[0] ? " " : "", rec.port, rec.message);
+        if (n < 0) {
+            return;
+        }
+        size_t len = std::strlen(line);
+        if (st.file) {
+            if (st.file_max_bytes > 0 && st.file_size + len > st.file_max_bytes) {
+                rotate_file(st);
+            }
+            if (st.file) {
+                std::fwrite(line, 1, len, st.file);
+                st.file_size += len;
+            }
+        } else {
+            std::fwrite(line, 1, len, stderr);
+        }
+    }
+}
+
+// Delivers everything currently in the ring.
+void drain(LogState& st) {
+    std::lock_guard<std::mutex> lock(st.drain_mutex);
+    bool delivered = false;
+    while (true) {
+        Cell& cell = st.cells[st.dequeue_pos & (kRingCapacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != st.dequeue_pos + 1) {
+            break;
+        }
+        deliver(st, cell.record);
+        cell.sequence.store(st.dequeue_pos + kRingCapacity, std::memory_order_release);
+        ++st.dequeue_pos;
+        delivered = true;
+    }
+
+    uint64_t dropped = st.dropped.exchange(0);
+    if (dropped > 0) {
+        LogRecord note{};
+        note.level = MICROWAVE_LOG_WARN;
+        note.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::snprintf(note.message, sizeof(note.message), "log ring full, %llu record(s) dropped",
+                      static_cast<unsigned long long>(dropped));
+        deliver(st, note);
+        delivered = true;
+    }
+
+    if (delivered) {
+        std::lock_guard<std::mutex> sink_lock(st.sink_mutex);
+        if (st.file) {
+            std::fflush(st.file);
+        }
+    }
+}
+
+} // namespace
+
+void link_log_write(int32_t level, const LinkLogContext* ctx, const char* fmt, ...) {
+    LogState& st = log_state();
+
+    size_t pos = st.enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &st.cells[pos & (kRingCapacity - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (st.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            st.dropped.fetch_add(1, std::memory_order_relaxed); // ring full
+            return;
+        } else {
+            pos = st.enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord& rec = cell->record;
+    rec.level = level;
+    rec.handle = ctx ? ctx->handle : 0;
+    rec.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(rec.port, ctx ? ctx->port : "", ctx ? sizeof(rec.port) : 1);
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(rec.message, sizeof(rec.message), fmt, args);
+    va_end(args);
+
+    cell->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void link_log_start() {
+    LogState& st = log_state();
+    std::lock_guard<std::mutex> lock(st.thread_mutex);
+    if (st.flusher.joinable()) {
+        return;
+    }
+    st.stop_requested = false;
+    st.flusher = std::thread([&st]() {
+        std::unique_lock<std::mutex> lock(st.thread_mutex);
+        while (!st.stop_requested) {
+            st.wake.wait_for(lock, kFlushInterval);
+            lock.unlock();
+            drain(st);
+            lock.lock();
+        }
+    });
+}
+
+void link_log_stop() {
+    LogState& st = log_state();
+    std::thread flusher;
+    {
+        std::lock_guard<std::mutex> lock(st.thread_mutex);
+        st.stop_requested = true;
+        flusher = std::move(st.flusher);
+    }
+    st.wake.notify_one();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    drain(st);
+}
+
+void link_log_flush() {
+    drain(log_state());
+}
+
+void link_log_set_callback(microwave_log_callback callback, void* user_data) {
+    LogState& st = log_state();
+    std::lock_guard<std::mutex> lock(st.sink_mutex);
+    st.callback = callback;
+    st.callback_user = user_data;
+}
+
+bool link_log_set_file(const char* path, uint64_t max_bytes, uint32_t max_files) {
+    LogState& st = log_state();
+    std::lock_guard<std::mutex> lock(st.sink_mutex);
+    if (st.file) {
+        std::fclose(st.file);
+        st.file = nullptr;
+    }
+    if (!path || !*path) {
+        return true;
+    }
+    st.file = std::fopen(path, "a");
+    if (!st.file) {
+        return false;
+    }
+    st.file_path = path;
+    st.file_max_bytes = max_bytes;
+    st.file_max_files = max_files;
+    std::fseek(st.file, 0, SEEK_END);
+    long size = std::ftell(st.file);
+    st.file_size = size > 0 ? static_cast<uint64_t>(size) : 0;
+    return true;
+}
@@ -0,0 +1,74 @@
+//
+// Leveled, asynchronous logging for the DLL.
+//
+// Call sites format into a fixed-size record and push it onto a lock-free
+// ring; a background flusher thread delivers records to the registered C
+// callback and/or a rotating log file (stderr when neither is configured).
+// A disabled level costs one relaxed atomic load and a compare.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_LINK_LOG_H
+#define MD1001LB_MICROWAVE_CONTROLLER_LINK_LOG_H
+
+#include "arduino_link.h"
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Per-session context stamped on every record logged for a session.
+ */
+struct LinkLogContext {
+    MicrowaveHandle handle = 0;
+    char port[48] = "";
+};
+
+extern std::atomic<int32_t> g_link_log_level;
+
+#if defined(__GNUC__)
+#define LINK_LOG_PRINTF(fmt_index) __attribute__((format(printf, fmt_index, fmt_index + 1)))
+#else
+#define LINK_LOG_PRINTF(fmt_index)
+#endif
+
+/**
+ * @brief Formats and enqueues one record (use the LINK_LOG macro instead).
+ *
+ * Never blocks; if the ring is full the record is dropped and counted.
+ */
+void link_log_write(int32_t level, const LinkLogContext* ctx, const char* fmt, ...) LINK_LOG_PRINTF(3);
+
+/**
+ * @brief Starts the flusher thread (called when the I/O runtime starts).
+ */
+void link_log_start();
+
+/**
+ * @brief Flushes outstanding records and joins the flusher thread.
+ */
+void link_log_stop();
+
+/**
+ * @brief Synchronously delivers every queued record.
+ */
+void link_log_flush();
+
+/**
+ * @brief Replaces the callback sink (nullptr to remove it).
+ */
+void link_log_set_callback(microwave_log_callback callback, void* user_data);
+
+/**
+ * @brief Replaces the file sink (nullptr/empty path to remove it).
+ *
+ * @return false if the file could not be opened.
+ */
+bool link_log_set_file(const char* path, uint64_t max_bytes, uint32_t max_files);
+
+#define LINK_LOG(level, ctx, ...)                                                   \
+    do {                                                                            \
+        if ((level) >= g_link_log_level.load(std::memory_order_relaxed)) {          \
+            link_log_write((level), (ctx), __VA_ARGS__);                            \
+        }                                                                           \
+    } while (0)
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_LINK_LOG_H
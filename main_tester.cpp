@@ -20,6 +20,9 @@
 #define API_ERROR_BAD_POWER -5   // Note: Your .cpp file doesn't seem to return this
 #define API_ERROR_ARDUINO_ERR -6
 #define API_ERROR_UNKNOWN -7
+#define API_ERROR_ABORTED -8
+#define API_ERROR_BAD_COMMAND -9
+#define API_ERROR_TIMEOUT -10
 
 // Helper function to translate error codes into human-readable strings
 std::string get_error_string(int32_t code) {
@@ -32,6 +35,9 @@ std::string get_error_string(int32_t code) {
         case API_ERROR_BAD_POWER:   return "API_ERROR_BAD_POWER";
         case API_ERROR_ARDUINO_ERR: return "API_ERROR_ARDUINO_ERR";
         case API_ERROR_UNKNOWN:     return "API_ERROR_UNKNOWN";
+        case API_ERROR_ABORTED:     return "API_ERROR_ABORTED";
+        case API_ERROR_BAD_COMMAND: return "API_ERROR_BAD_COMMAND";
+        case API_ERROR_TIMEOUT:     return "API_ERROR_TIMEOUT";
         default:                    return "Unknown Error Code";
     }
 }
@@ -124,12 +130,14 @@ int main() {
     if (result != API_ERROR_BAD_TIME_STR) {
         std::cerr << "   > Note: Expected API_ERROR_BAD_TIME_STR!" << std::endl;
     }
-    for (int i = 0; i < 2; i++) {
-        result = send_microwave_command(handle, "press stop");
-        check_result(result, "send_microwave_command(\"press stop\")");
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    {
+        // No need to press stop "to be safe": run_microwave clears the oven
+        // itself, as far as the library's model of it says is needed
+        microwave_oven_state oven{};
+        get_microwave_oven_state(handle, &oven);
+        std::cout << "   > Oven state: " << oven.state << " (" << oven.seconds << " s at "
+                  << oven.power_level << "%)" << std::endl;
     }
-    std::this_thread::sleep_for(std::chrono::seconds(1));
 
     std::cout << "\n--- Test 5: Raw Command ('press 1') ---" << std::endl;
     result = send_microwave_command(handle, "press 1");
@@ -137,9 +145,8 @@ int main() {
     std::this_thread::sleep_for(std::chrono::seconds(5));
 
     // Clear the "1" we just pressed
-    result = send_microwave_command(handle, "press stop");
-    check_result(result, "send_microwave_command(\"press stop\")");
-    stop_microwave(handle);
+    result = stop_microwave(handle);
+    check_result(result, "stop_microwave()");
 
 
 cleanup:
@@ -0,0 +1,105 @@
+//
+// C++20 client API: an RAII owner for one controller and coroutine operations
+// on it, built on the same session runtime as the C API.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_MICROWAVE_CONTROLLER_H
+#define MD1001LB_MICROWAVE_CONTROLLER_MICROWAVE_CONTROLLER_H
+
+#include "arduino_link.h"
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#ifndef ASIO_STANDALONE
+#define ASIO_STANDALONE
+#endif
+#include "asio/awaitable.hpp"
+
+/**
+ * @brief Owns one open controller and closes it on destruction.
+ *
+ * Operations are asio coroutines that complete with the same status codes as
+ * the C API (0 on success), e.g.
+ *
+ *     MicrowaveController ctl("/dev/ttyUSB0");
+ *     co_await ctl.run(90s, 50);
+ *     co_await ctl.press("start");
+ *
+ * A suspended operation does not occupy a thread: the calling coroutine
+ * resumes on its own executor once the Arduino has acknowledged the command.
+ * Strings passed in must stay valid until the operation is awaited. Several
+ * coroutines may await operations on one controller at once; commands are
+ * sent one at a time, as with send_microwave_command.
+ */
+class DLL_EXPORT MicrowaveController {
+public:
+    MicrowaveController() = default;
+
+    /**
+     * @brief Opens a port (see open_microwave_controller); check is_open().
+     */
+    explicit MicrowaveController(std::string_view port_name, uint32_t baud_rate = 115200);
+
+    /**
+     * @brief Takes ownership of a handle from open_microwave_controller.
+     */
+    explicit MicrowaveController(MicrowaveHandle handle) noexcept : handle_(handle) {}
+
+    ~MicrowaveController();
+    MicrowaveController(const MicrowaveController&) = delete;
+    MicrowaveController& operator=(const MicrowaveController&) = delete;
+    MicrowaveController(MicrowaveController&& other) noexcept;
+    MicrowaveController& operator=(MicrowaveController&& other) noexcept;
+
+    bool is_open() const noexcept { return handle_ != 0; }
+    explicit operator bool() const noexcept { return is_open(); }
+    MicrowaveHandle handle() const noexcept { return handle_; }
+
+    /**
+     * @brief Gives up ownership without closing.
+     */
+    MicrowaveHandle release() noexcept;
+
+    /**
+     * @brief Closes the controller now (waits for operations in flight).
+     */
+    void close() noexcept;
+
+    /**
+     * @brief Sends one raw firmware command (e.g. "hold 1").
+     */
+    asio::awaitable<int32_t> send(std::string_view command) const;
+
+    /**
+     * @brief Presses one key by name (e.g. "start", "5", "cook_time").
+     */
+    asio::awaitable<int32_t> press(std::string_view key) const;
+
+    /**
+     * @brief Enters a cook time and power level (see run_microwave).
+     *
+     * @param duration 1 s to 99:59.
+     * @param power_level 10-100 in steps of 10; anything else means 100.
+     */
+    asio::awaitable<int32_t> run(std::chrono::seconds duration, uint8_t power_level = 100) const;
+
+    /**
+     * @brief Executes a batch of operations (see execute_microwave_batch).
+     *
+     * @param results Empty, or one entry per op.
+     */
+    asio::awaitable<int32_t> execute(std::span<const microwave_op> ops,
+                                     std::span<microwave_result> results = {}) const;
+
+    /**
+     * @brief Emergency stop (see stop_microwave).
+     */
+    asio::awaitable<int32_t> stop() const;
+
+private:
+    MicrowaveHandle handle_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_MICROWAVE_CONTROLLER_H
@@ -0,0 +1,89 @@
+//
+// Intrusive lock-free multi-producer, single-consumer queue.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_MPSC_QUEUE_H
+#define MD1001LB_MICROWAVE_CONTROLLER_MPSC_QUEUE_H
+
+#include <atomic>
+
+/**
+ * @brief Link field embedded in every queued object.
+ */
+struct MpscNode {
+    std::atomic<MpscNode*> next{nullptr};
+};
+
+/**
+ * @brief Vyukov-style intrusive MPSC queue.
+ *
+ * push() is wait-free and may be called from any thread; pop() must only be
+ * called by the single consumer. Nodes are owned by the producer (typically a
+ * stack object waiting for its own completion), so the queue never allocates.
+ * FIFO order holds per producer.
+ *
+ * @tparam T Node type deriving from MpscNode.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T* node) { push_node(node); }
+
+    /**
+     * @brief Dequeues the oldest node (consumer only).
+     *
+     * May return nullptr while a producer is between its two push steps;
+     * might_have_items() tells the consumer to try again later.
+     */
+    T* pop() {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr; // producer mid-push
+        }
+        push_node(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief True if a pushed node may not have been popped yet (consumer only).
+     */
+    bool might_have_items() const {
+        // Empty means only the stub is linked: it is both the oldest and the
+        // newest node.
+        return tail_ != &stub_ || head_.load(std::memory_order_seq_cst) != &stub_;
+    }
+
+private:
+    void push_node(MpscNode* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    std::atomic<MpscNode*> head_;
+    MpscNode* tail_;
+    MpscNode stub_;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_MPSC_QUEUE_H
@@ -0,0 +1,206 @@
+//
+// Checks what the library keys in against the emulated microwave itself.
+//
+// Runs the emulator in this process, so the appliance model behind its
+// keypad can be read directly, and opens it through the public API. Every
+// run in the table is keyed in with run_microwave and started; the oven
+// must then show the requested time and power, have accepted exactly the
+// planned keys and cook with the magnetron on, and whatever the library
+// believes about the oven must be true. A press that saw too few strobes
+// may be lost; the library then reports the state unknown, which is
+// counted but not a failure. The table is run once with the default key
+// timings and once after calibrate_microwave_timing.
+//
+//   oven_check [--oven]
+//
+// --oven also prints every key the oven accepted. Exits 1 on any mismatch.
+//
+
+#include "arduino_link.h"
+#include "emulator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#define API_SUCCESS 0
+
+namespace {
+
+struct Run {
+    const char* time;
+    uint32_t seconds;
+    uint8_t power_level;
+};
+
+// Chosen so consecutive runs start from cooking, paused and entered states
+const Run kRuns[] = {
+    {"00:05", 5, 100}, {"00:45", 45, 50}, {"01:30", 90, 100}, {"01:30", 90, 70},
+    {"10:00", 600, 10}, {"00:30", 30, 100}, {"99:59", 5999, 20},
+};
+
+int g_failures = 0;
+int g_unknown = 0;
+
+void expect(bool ok, const Run& run, const char* what) {
+    if (!ok) {
+        ++g_failures;
+        std::printf("  FAIL %s %u%%: %s\n", run.time, run.power_level, what);
+    }
+}
+
+const char* mode_name(ApplianceMode mode) {
+    switch (mode) {
+    case ApplianceMode::kIdle:
+        return "idle";
+    case ApplianceMode::kEnteringTime:
+        return "entering";
+    case ApplianceMode::kPowerSet:
+        return "power";
+    case ApplianceMode::kCooking:
+        return "cooking";
+    case ApplianceMode::kPaused:
+        return "paused";
+    }
+    return "?";
+}
+
+// The oven registers a key a few strobes after the firmware reports the
+// press done; wait for it rather than racing the scan
+ApplianceSnapshot settled_oven(uint32_t keys) {
+    ApplianceSnapshot oven = emulator_oven();
+    for (int i = 0; i < 50 && oven.keys < keys; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        oven = emulator_oven();
+    }
+    return oven;
+}
+
+/**
+ * @brief Whether the library claims to know the oven's state, after
+ *        checking that what it claims is what the oven does.
+ *
+ * Unknown is always a correct answer: it is what the library reports when
+ * a press saw too few strobes to be sure the oven took it.
+ */
+bool library_knows(MicrowaveHandle handle, const ApplianceSnapshot& oven, const Run& run, const char* when) {
+    microwave_oven_state state{};
+    get_microwave_oven_state(handle, &state);
+    if (state.state == MICROWAVE_OVEN_UNKNOWN) {
+        ++g_unknown;
+        std::printf("  %s %u%%: library lost track %s (oven %s %s)\n", run.time, run.power_level, when,
+                    mode_name(oven.mode), oven.display);
+        return false;
+    }
+    const bool counting = oven.mode == ApplianceMode::kCooking;
+    const bool has_power = oven.mode != ApplianceMode::kIdle && oven.mode != ApplianceMode::kEnteringTime;
+    const bool agrees = state.state == static_cast<int32_t>(oven.mode) + MICROWAVE_OVEN_IDLE &&
+                        (counting ? state.seconds <= oven.seconds + 1 && state.seconds + 1 >= oven.seconds
+                                  : state.seconds == oven.seconds) &&
+                        (!has_power || state.power_level == oven.power_level);
+    if (!agrees) {
+        ++g_failures;
+        std::printf("  FAIL %s %u%%: library believes state %d %u s %u%% %s, oven is %s %s\n", run.time,
+                    run.power_level, state.state, state.seconds, state.power_level, when, mode_name(oven.mode),
+                    oven.display);
+    }
+    return agrees;
+}
+
+void check_run(MicrowaveHandle handle, const Run& run, bool last) {
+    microwave_plan plan{};
+    if (plan_microwave_run(handle, run.time, run.power_level, &plan) != API_SUCCESS) {
+        expect(false, run, "no plan");
+        return;
+    }
+
+    const uint32_t keys_before = emulator_oven().keys;
+    auto start = std::chrono::steady_clock::now();
+    int32_t result = run_microwave(handle, run.time, run.power_level);
+    double entry_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    expect(result == API_SUCCESS, run, "run_microwave failed");
+
+    const ApplianceSnapshot entered = settled_oven(keys_before + plan.key_count);
+    std::printf("%-6s %3u%%  %2u keys  %5.0f ms (predicted %5u)  oven %-8s %-5s\n", run.time, run.power_level,
+                plan.key_count, entry_ms, plan.predicted_ms, mode_name(entered.mode), entered.display);
+    if (!library_knows(handle, entered, run, "after entry")) {
+        return; // the next run starts from an unknown state
+    }
+    expect(entered.keys - keys_before == plan.key_count, run, "oven accepted a different number of keys");
+    expect(entered.seconds == plan.cook_seconds, run, "wrong time entered");
+    expect(entered.power_level == plan.power_level, run, "wrong power entered");
+
+    // Start it and look at the oven cooking
+    expect(send_microwave_command(handle, "press Start") == API_SUCCESS, run, "Start failed");
+    const ApplianceSnapshot cooking = settled_oven(entered.keys + 1);
+    if (!library_knows(handle, cooking, run, "after Start")) {
+        return;
+    }
+    expect(cooking.mode == ApplianceMode::kCooking, run, "not cooking after Start");
+    expect(cooking.seconds <= plan.cook_seconds && cooking.seconds + 1 >= plan.cook_seconds, run,
+           "countdown does not match the run");
+    expect(cooking.power_level == plan.power_level, run, "cooking at the wrong power");
+    expect(cooking.magnetron_on, run, "magnetron off at the start of a cycle");
+
+    // Leave it paused (or, after the last run, cooking) for the next plan
+    if (!last) {
+        expect(send_microwave_command(handle, "press stop") == API_SUCCESS, run, "Stop failed");
+        const ApplianceSnapshot paused = settled_oven(cooking.keys + 1);
+        if (library_knows(handle, paused, run, "after Stop")) {
+            expect(paused.mode == ApplianceMode::kPaused, run, "not paused after Stop");
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--oven") {
+        emulator_log_oven(stdout);
+    }
+
+    // --- 1. Start the board in this process ---
+    std::string path;
+    int master = emulator_open_pty(path);
+    if (master < 0) {
+        std::fprintf(stderr, "Failed to create pseudo terminal\n");
+        return 1;
+    }
+    std::thread([master]() { emulator_run(master); }).detach();
+
+    MicrowaveHandle handle = open_microwave_controller(path.c_str(), 115200);
+    if (!handle) {
+        std::fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return 1;
+    }
+
+    // --- 2. Default timings, then calibrated ones ---
+    std::printf("default key timings\n");
+    const size_t runs = sizeof(kRuns) / sizeof(kRuns[0]);
+    for (size_t i = 0; i < runs; ++i) {
+        check_run(handle, kRuns[i], i + 1 == runs);
+    }
+    expect(stop_microwave(handle) == API_SUCCESS, kRuns[0], "stop_microwave failed");
+
+    int32_t calibrated = calibrate_microwave_timing(handle, 500);
+    std::printf("calibrated key timings (%d)\n", calibrated);
+    expect(calibrated == API_SUCCESS, kRuns[0], "calibration failed");
+    for (size_t i = 0; i < runs; ++i) {
+        check_run(handle, kRuns[i], i + 1 == runs);
+    }
+    stop_microwave(handle);
+
+    // --- 3. Report ---
+    const ApplianceSnapshot oven = emulator_oven();
+    std::printf("oven: %u keys accepted, %.1f s cooking, %.1f s magnetron\n", oven.keys, oven.cooking_ms / 1000.0,
+                oven.magnetron_ms / 1000.0);
+    std::printf("%s (%d mismatches, library unsure %d times)\n", g_failures ? "FAILED" : "ok", g_failures,
+                g_unknown);
+    close_microwave_controller(handle);
+
+    // The emulator thread never returns; leave without tearing down under it
+    std::fflush(stdout);
+    std::_Exit(g_failures ? 1 : 0);
+}
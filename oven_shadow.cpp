@@ -0,0 +1,142 @@
+//
+// Oven state transitions.
+//
+
+#include "oven_shadow.h"
+
+#include "arduino_link.h"
+
+namespace {
+
+int digit_of(int32_t key) {
+    static constexpr int32_t kDigitKeys[10] = {
+        MICROWAVE_KEY_0, MICROWAVE_KEY_1, MICROWAVE_KEY_2, MICROWAVE_KEY_3, MICROWAVE_KEY_4,
+        MICROWAVE_KEY_5, MICROWAVE_KEY_6, MICROWAVE_KEY_7, MICROWAVE_KEY_8, MICROWAVE_KEY_9,
+    };
+    for (int digit = 0; digit < 10; ++digit) {
+        if (kDigitKeys[digit] == key) {
+            return digit;
+        }
+    }
+    return -1;
+}
+
+uint32_t ceil_seconds(uint64_t ms) {
+    return static_cast<uint32_t>((ms + 999) / 1000);
+}
+
+} // namespace
+
+OvenState OvenShadow::state(uint64_t now_ms, const ApplianceModel& model) const {
+    OvenState state;
+    uint64_t known_since = last_key_ms_;
+    if (mode_ == OvenMode::kCooking) {
+        if (now_ms < ends_ms_) {
+            state.mode = OvenMode::kCooking;
+            state.seconds = ceil_seconds(ends_ms_ - now_ms);
+            state.power_level = power_level_;
+            return state;
+        }
+        state.mode = OvenMode::kIdle;
+        known_since = ends_ms_;
+    } else {
+        state.mode = mode_;
+    }
+    if (now_ms - known_since > uint64_t{model.trust_seconds} * 1000) {
+        return OvenState{};
+    }
+    switch (state.mode) {
+    case OvenMode::kEnteringTime:
+        state.seconds = entry_ / 100 * 60 + entry_ % 100;
+        break;
+    case OvenMode::kPowerSet:
+        state.seconds = entry_ / 100 * 60 + entry_ % 100;
+        state.power_level = power_level_;
+        break;
+    case OvenMode::kPaused:
+        state.seconds = ceil_seconds(paused_ms_);
+        state.power_level = power_level_;
+        break;
+    default:
+        break;
+    }
+    return state;
+}
+
+void OvenShadow::key_pressed(int32_t key, uint64_t now_ms, const ApplianceModel& model) {
+    const OvenState before = state(now_ms, model);
+    const int digit = digit_of(key);
+    OvenMode next = OvenMode::kUnknown;
+
+    if (key == MICROWAVE_KEY_STOP) {
+        switch (before.mode) {
+        case OvenMode::kCooking:
+            paused_ms_ = static_cast<uint32_t>(ends_ms_ - now_ms);
+            next = OvenMode::kPaused;
+            break;
+        case OvenMode::kUnknown:
+            next = OvenMode::kIdleOrPaused; // it may have been cooking
+            break;
+        default:
+            next = OvenMode::kIdle;
+            break;
+        }
+    } else if (key == MICROWAVE_KEY_COOK_TIME) {
+        if (before.mode == OvenMode::kIdle) {
+            entry_ = 0;
+            next = OvenMode::kEnteringTime;
+        }
+    } else if (digit >= 0) {
+        if (before.mode == OvenMode::kEnteringTime) {
+            entry_ = (entry_ * 10 + static_cast<uint32_t>(digit)) % 10000;
+            next = OvenMode::kEnteringTime;
+        }
+    } else if (key == MICROWAVE_KEY_POWER && model.power_steps > 0) {
+        const uint32_t step = 100 / model.power_steps;
+        if (before.mode == OvenMode::kEnteringTime && before.seconds > 0) {
+            power_level_ = 100;
+            next = OvenMode::kPowerSet;
+        } else if (before.mode == OvenMode::kPowerSet) {
+            power_level_ = power_level_ > step ? power_level_ - step : 100;
+            next = OvenMode::kPowerSet;
+        }
+    } else if (key == MICROWAVE_KEY_START) {
+        const bool seconds_ok = entry_ % 100 <= model.max_seconds_field;
+        switch (before.mode) {
+        case OvenMode::kEnteringTime:
+        case OvenMode::kPowerSet:
+            if (before.seconds > 0 && seconds_ok) {
+                if (before.mode == OvenMode::kEnteringTime) {
+                    power_level_ = 100;
+                }
+                ends_ms_ = now_ms + uint64_t{before.seconds} * 1000;
+                next = OvenMode::kCooking;
+            }
+            break;
+        case OvenMode::kPaused:
+            if (paused_ms_ > 0) {
+                ends_ms_ = now_ms + paused_ms_;
+                next = OvenMode::kCooking;
+            }
+            break;
+        case OvenMode::kIdle:
+            if (model.express_seconds > 0) {
+                power_level_ = 100;
+                ends_ms_ = now_ms + uint64_t{model.express_seconds} * 1000;
+                next = OvenMode::kCooking;
+            }
+            break;
+        case OvenMode::kCooking:
+            if (model.express_seconds > 0) {
+                ends_ms_ += uint64_t{model.express_seconds} * 1000;
+                next = OvenMode::kCooking;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    mode_ = next;
+    last_key_ms_ = now_ms;
+}
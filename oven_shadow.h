@@ -0,0 +1,95 @@
+//
+// Host-side model of what the oven is doing, kept from the keys the library
+// has pressed.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_OVEN_SHADOW_H
+#define MD1001LB_MICROWAVE_CONTROLLER_OVEN_SHADOW_H
+
+#include <cstdint>
+
+/**
+ * @brief The oven's keypad rules.
+ *
+ * Time entry: "Cook Time", then up to four digits that shift in from the
+ * right of an MM:SS display, so "1", "3", "0" shows 01:30. The seconds
+ * field accepts up to max_seconds_field, so 90 s can also be typed as "90"
+ * (00:90). Power: the first "Power" press after the time shows the current
+ * level (100%), each further press steps it down by 100 / power_steps
+ * percent, wrapping back to 100% after the lowest level; leaving power alone
+ * means 100%. Express start: with nothing entered, each "Start" press adds
+ * express_seconds at 100% and starts cooking (0 = no such key). "Stop"
+ * pauses a running oven and clears anything else. Below 100% the magnetron
+ * is switched on for that share of every magnetron_cycle_seconds, starting
+ * over at each Start.
+ *
+ * Nothing tells the library about keys pressed by hand, so a state the
+ * library has not touched for trust_seconds is treated as unknown.
+ */
+struct ApplianceModel {
+    uint32_t max_seconds_field = 99;
+    uint32_t power_steps = 10;
+    uint32_t express_seconds = 30;
+    uint32_t trust_seconds = 60;
+    uint32_t magnetron_cycle_seconds = 30;
+};
+
+enum class OvenMode : uint32_t {
+    kUnknown,
+    kIdle,
+    kEnteringTime,  // "Cook Time" and digits pressed
+    kPowerSet,      // ... and at least one "Power"
+    kCooking,
+    kPaused,
+    kIdleOrPaused   // one "Stop" away from idle; reported as unknown
+};
+
+/**
+ * @brief What the oven is doing at one moment.
+ */
+struct OvenState {
+    OvenMode mode = OvenMode::kUnknown;
+    uint32_t seconds = 0;       // entered time, or what is left when cooking or paused
+    uint32_t power_level = 100;
+};
+
+/**
+ * @brief Follows the oven through the keys pressed on it.
+ *
+ * Trivially copyable so a session can publish it through a Seqlock. Times
+ * are steady-clock milliseconds. A key the model cannot account for makes
+ * the state unknown rather than guessed.
+ */
+class OvenShadow {
+public:
+    /**
+     * @brief Applies a key press (MICROWAVE_KEY_*) that took effect at now_ms.
+     */
+    void key_pressed(int32_t key, uint64_t now_ms, const ApplianceModel& model);
+
+    /**
+     * @brief Forgets everything, e.g. after a press that may or may not have landed.
+     */
+    void lost() { mode_ = OvenMode::kUnknown; }
+
+    /**
+     * @brief The state at now_ms: a finished cook counts as idle, and a state
+     *        older than model.trust_seconds as unknown.
+     */
+    OvenState state(uint64_t now_ms, const ApplianceModel& model) const;
+
+    /**
+     * @brief When the cook last started or resumed finishes, or 0 if the
+     *        oven is not cooking as of the last key.
+     */
+    uint64_t cook_ends_ms() const { return mode_ == OvenMode::kCooking ? ends_ms_ : 0; }
+
+private:
+    OvenMode mode_ = OvenMode::kUnknown;
+    uint32_t entry_ = 0;            // digits on the display, as MMSS
+    uint32_t power_level_ = 100;
+    uint32_t paused_ms_ = 0;        // time left when paused
+    uint64_t ends_ms_ = 0;          // when cooking finishes
+    uint64_t last_key_ms_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_OVEN_SHADOW_H
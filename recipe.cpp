@@ -0,0 +1,221 @@
+//
+// Recipe compiler.
+//
+
+#include "recipe.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// Bounds that keep a runaway file from tying up a session
+constexpr size_t kMaxOps = 4096;
+constexpr uint64_t kMaxDurationMs = 24ull * 60 * 60 * 1000;
+constexpr uint32_t kMaxCookSeconds = 99 * 60 + 59;
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+bool parse_number(std::string_view& text, uint64_t& value) {
+    size_t digits = 0;
+    value = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        value = value * 10 + static_cast<uint64_t>(text[digits] - '0');
+        if (value > kMaxDurationMs) {
+            return false;
+        }
+        ++digits;
+    }
+    text.remove_prefix(digits);
+    return digits > 0;
+}
+
+/**
+ * @brief Parses "M:SS" or number-unit pairs ("1m30s", "250ms") into ms,
+ *        ignoring spaces.
+ */
+bool parse_duration_ms(std::string_view text, uint64_t& ms) {
+    std::string compact;
+    for (char c : text) {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            compact.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+    }
+    std::string_view rest = compact;
+    if (rest.empty()) {
+        return false;
+    }
+    if (rest.find(':') != std::string_view::npos) {
+        uint64_t minutes = 0;
+        uint64_t seconds = 0;
+        if (!parse_number(rest, minutes) || rest.empty() || rest.front() != ':') {
+            return false;
+        }
+        rest.remove_prefix(1);
+        if (rest.size() != 2 || !parse_number(rest, seconds) || seconds > 59) {
+            return false;
+        }
+        ms = (minutes * 60 + seconds) * 1000;
+        return ms <= kMaxDurationMs;
+    }
+    ms = 0;
+    while (!rest.empty()) {
+        uint64_t value = 0;
+        if (!parse_number(rest, value)) {
+            return false;
+        }
+        uint64_t unit_ms = 0;
+        if (rest.starts_with("ms")) {
+            unit_ms = 1;
+            rest.remove_prefix(2);
+        } else if (rest.starts_with("s")) {
+            unit_ms = 1000;
+            rest.remove_prefix(1);
+        } else if (rest.starts_with("m")) {
+            unit_ms = 60 * 1000;
+            rest.remove_prefix(1);
+        } else if (rest.starts_with("h")) {
+            unit_ms = 60 * 60 * 1000;
+            rest.remove_prefix(1);
+        } else {
+            return false; // a bare number is too easy to misread
+        }
+        ms += value * unit_ms;
+        if (ms > kMaxDurationMs) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool fail(RecipeError& error, uint32_t line, const char* message) {
+    error.line = line;
+    std::snprintf(error.message, sizeof(error.message), "%s", message);
+    return false;
+}
+
+/**
+ * @brief Compiles "run"/"enter" arguments: a time and an optional "@<power>".
+ */
+bool compile_cook(std::string_view args, const ApplianceModel& model, uint32_t line, RecipeOp& op,
+                  RecipeError& error) {
+    std::string_view time = args;
+    std::string_view power;
+    size_t at = args.find('@');
+    if (at != std::string_view::npos) {
+        time = trim(args.substr(0, at));
+        power = trim(args.substr(at + 1));
+    }
+    uint64_t ms = 0;
+    if (!parse_duration_ms(time, ms) || ms % 1000 != 0 || ms == 0 || ms / 1000 > kMaxCookSeconds) {
+        return fail(error, line, "cook time must be whole seconds, 0:01 to 99:59");
+    }
+    op.arg = static_cast<uint32_t>(ms / 1000);
+    op.power_level = 100;
+    if (at != std::string_view::npos) {
+        if (power.ends_with('%')) {
+            power.remove_suffix(1);
+        }
+        uint64_t level = 0;
+        const uint32_t step = model.power_steps ? 100 / model.power_steps : 100;
+        if (!parse_number(power, level) || !power.empty() || level == 0 || level > 100 || level % step != 0) {
+            return fail(error, line, "power is not a level the oven can set");
+        }
+        op.power_level = static_cast<uint8_t>(level);
+    }
+    return true;
+}
+
+bool compile_statement(std::string_view statement, const ApplianceModel& model,
+                       const std::function<int32_t(std::string_view)>& find_key, uint32_t line,
+                       std::vector<RecipeOp>& code, RecipeError& error) {
+    size_t split = 0;
+    while (split < statement.size() && !std::isspace(static_cast<unsigned char>(statement[split])) &&
+           statement[split] != '@') {
+        ++split;
+    }
+    const std::string_view keyword = statement.substr(0, split);
+    const std::string_view args = trim(statement.substr(split));
+
+    RecipeOp op{};
+    op.line = static_cast<uint16_t>(line);
+    if (iequals(keyword, "run") || iequals(keyword, "enter")) {
+        op.opcode = iequals(keyword, "run") ? RecipeOpcode::kRun : RecipeOpcode::kEnter;
+        if (!compile_cook(args, model, line, op, error)) {
+            return false;
+        }
+    } else if (iequals(keyword, "press")) {
+        int32_t key = args.empty() ? -1 : find_key(args);
+        if (key < 0) {
+            return fail(error, line, "unknown key");
+        }
+        op.opcode = RecipeOpcode::kPress;
+        op.arg = static_cast<uint32_t>(key);
+    } else if (iequals(keyword, "stop")) {
+        if (!args.empty()) {
+            return fail(error, line, "stop takes no arguments");
+        }
+        op.opcode = RecipeOpcode::kStop;
+    } else if (iequals(keyword, "wait") || iequals(keyword, "at")) {
+        uint64_t ms = 0;
+        if (!parse_duration_ms(args, ms)) {
+            return fail(error, line, "bad duration (e.g. 45s, 1m30s, 250ms, 1:30)");
+        }
+        op.opcode = iequals(keyword, "wait") ? RecipeOpcode::kWait : RecipeOpcode::kAt;
+        op.arg = static_cast<uint32_t>(ms);
+    } else {
+        return fail(error, line, "unknown statement");
+    }
+    if (code.size() == kMaxOps) {
+        return fail(error, line, "recipe too long");
+    }
+    code.push_back(op);
+    return true;
+}
+
+} // namespace
+
+bool compile_recipe(std::string_view text, const ApplianceModel& model,
+                    const std::function<int32_t(std::string_view)>& find_key, std::vector<RecipeOp>& code,
+                    RecipeError& error) {
+    code.clear();
+    error = RecipeError{};
+    uint32_t line = 0;
+    while (!text.empty()) {
+        ++line;
+        if (line > UINT16_MAX) {
+            return fail(error, line, "recipe too long");
+        }
+        size_t end = text.find('\n');
+        std::string_view source = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        source = source.substr(0, source.find('#'));
+
+        while (!source.empty()) {
+            size_t semicolon = source.find(';');
+            std::string_view statement = trim(source.substr(0, semicolon));
+            source.remove_prefix(semicolon == std::string_view::npos ? source.size() : semicolon + 1);
+            if (!statement.empty() && !compile_statement(statement, model, find_key, line, code, error)) {
+                code.clear();
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+//
+// Cooking recipes: a small text language compiled to a compact op list that
+// a session executes against absolute deadlines.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_RECIPE_H
+#define MD1001LB_MICROWAVE_CONTROLLER_RECIPE_H
+
+#include "oven_shadow.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+enum class RecipeOpcode : uint8_t {
+    kRun,       // enter arg seconds at power_level and press Start
+    kEnter,     // ... without pressing Start
+    kPress,     // press key arg (MICROWAVE_KEY_*)
+    kStop,      // emergency stop
+    kWait,      // the next step starts arg ms after this point of the timeline
+    kAt,        // the next step starts arg ms after the recipe started
+};
+
+/**
+ * @brief One compiled step: 8 bytes, so a long recipe stays a few cache lines.
+ */
+struct RecipeOp {
+    RecipeOpcode opcode;
+    uint8_t power_level;    // kRun and kEnter
+    uint16_t line;          // source line, for reports
+    uint32_t arg;
+};
+
+static_assert(sizeof(RecipeOp) == 8, "RecipeOp is meant to stay compact");
+
+/**
+ * @brief Where and why a recipe failed to compile.
+ */
+struct RecipeError {
+    uint32_t line = 0;
+    char message[64] = {};
+};
+
+/**
+ * @brief Compiles recipe text.
+ *
+ * Statements are separated by newlines or ';', '#' starts a comment, and
+ * keywords are case-insensitive:
+ *
+ *   run <time> [@<power>]    enter the time and power and press Start
+ *   enter <time> [@<power>]  the same without Start (like run_microwave)
+ *   press <key>              press one key by name
+ *   stop                     emergency stop
+ *   wait <duration>          pause before the next step
+ *   at <duration>            start the next step this long after the recipe began
+ *
+ * A time is M:SS (up to 99:59) or a duration. A duration is one or more
+ * number-unit pairs ("45s", "1m30s", "250ms") or M:SS. Power is a percent
+ * the model can set, optionally followed by '%'. Key names are resolved
+ * through find_key (-1 = unknown).
+ *
+ * @return false (with error filled in) on the first invalid statement.
+ */
+bool compile_recipe(std::string_view text, const ApplianceModel& model,
+                    const std::function<int32_t(std::string_view)>& find_key, std::vector<RecipeOp>& code,
+                    RecipeError& error);
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_RECIPE_H
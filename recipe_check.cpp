@@ -0,0 +1,207 @@
+//
+// Checks the recipe compiler's accept and reject cases.
+//
+// Every statement in the tables is compiled on its own against the default
+// oven model; accepted ones must produce exactly the expected op, rejected
+// ones must fail on the expected line with nothing left in the code. The
+// bounds on ops and lines are checked at their edges.
+//
+//   recipe_check
+//
+// Exits 1 on any mismatch.
+//
+
+#include "recipe.h"
+
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// A stand-in for the firmware's key list
+int32_t find_key(std::string_view name) {
+    if (name == "start") {
+        return 5;
+    }
+    if (name == "cook_time") {
+        return 0;
+    }
+    return -1;
+}
+
+struct Accept {
+    const char* text;
+    RecipeOpcode opcode;
+    uint32_t arg;
+    uint8_t power_level;    // kRun and kEnter only
+};
+
+const Accept kAccepted[] = {
+    {"run 1:30 @50", RecipeOpcode::kRun, 90, 50},
+    {"run 1:30@50", RecipeOpcode::kRun, 90, 50},
+    {"RUN 0:05", RecipeOpcode::kRun, 5, 100},
+    {"run 1m30s @ 70%", RecipeOpcode::kRun, 90, 70},
+    {"run 99:59", RecipeOpcode::kRun, 5999, 100},
+    {"run 0:01 @10", RecipeOpcode::kRun, 1, 10},
+    {"enter 45s", RecipeOpcode::kEnter, 45, 100},
+    {"Enter 2m @100%", RecipeOpcode::kEnter, 120, 100},
+    {"press start", RecipeOpcode::kPress, 5, 0},
+    {"press cook_time", RecipeOpcode::kPress, 0, 0},
+    {"stop", RecipeOpcode::kStop, 0, 0},
+    {"wait 250ms", RecipeOpcode::kWait, 250, 0},
+    {"wait 1:30", RecipeOpcode::kWait, 90000, 0},
+    {"wait 1m 30s", RecipeOpcode::kWait, 90000, 0},
+    {"wait 0s", RecipeOpcode::kWait, 0, 0},
+    {"wait 1h1m1s1ms", RecipeOpcode::kWait, 3661001, 0},
+    {"at 24h", RecipeOpcode::kAt, 86400000, 0},
+    {"AT 10M", RecipeOpcode::kAt, 600000, 0},
+};
+
+const char* const kRejected[] = {
+    "run",              // no time
+    "run 0:00",         // nothing to cook
+    "run 0s",
+    "run 100:00",       // past the display
+    "run 1500ms",       // not whole seconds
+    "run 1:5",          // SS needs two digits
+    "run 1:60",
+    "run :30",
+    "run 90",           // a bare number
+    "run 1:00 @",
+    "run 1:00 @0",
+    "run 1:00 @55",     // not a 10% step
+    "run 1:00 @110",
+    "run 1:00 @50x",
+    "run 1:00 @50%%",
+    "enter @50",
+    "press",
+    "press nosuch",
+    "stop now",
+    "wait",
+    "wait 10",
+    "wait 10x",
+    "wait 1:30s",
+    "wait 24h1ms",      // over a day
+    "at 99999999999999999999ms",
+    "bake 1:00",
+};
+
+int g_failures = 0;
+
+void expect(bool ok, const char* text, const char* what) {
+    if (!ok) {
+        ++g_failures;
+        std::printf("  FAIL \"%s\": %s\n", text, what);
+    }
+}
+
+bool compile(std::string_view text, const ApplianceModel& model, std::vector<RecipeOp>& code, RecipeError& error) {
+    return compile_recipe(text, model, find_key, code, error);
+}
+
+void check_accepted() {
+    const ApplianceModel model{};
+    for (const Accept& accept : kAccepted) {
+        std::vector<RecipeOp> code;
+        RecipeError error;
+        if (!compile(accept.text, model, code, error)) {
+            expect(false, accept.text, error.message);
+            continue;
+        }
+        if (code.size() != 1) {
+            expect(false, accept.text, "not exactly one op");
+            continue;
+        }
+        const RecipeOp& op = code[0];
+        expect(op.opcode == accept.opcode, accept.text, "wrong opcode");
+        expect(op.arg == accept.arg, accept.text, "wrong argument");
+        expect(op.line == 1, accept.text, "wrong line");
+        if (op.opcode == RecipeOpcode::kRun || op.opcode == RecipeOpcode::kEnter) {
+            expect(op.power_level == accept.power_level, accept.text, "wrong power");
+        }
+    }
+}
+
+void check_rejected() {
+    const ApplianceModel model{};
+    for (const char* text : kRejected) {
+        std::vector<RecipeOp> code;
+        RecipeError error;
+        const bool compiled = compile(text, model, code, error);
+        expect(!compiled, text, "accepted");
+        expect(compiled || (error.line == 1 && error.message[0] != '\0'), text, "no line or message");
+    }
+
+    // A failure further down clears what came before and names its line
+    std::vector<RecipeOp> code;
+    RecipeError error;
+    const char* text = "run 0:10\nwait 10s\n\nfry 1:00";
+    expect(!compile(text, model, code, error) && error.line == 4 && code.empty(), "fry on line 4",
+           "wrong line or code left behind");
+}
+
+void check_layout() {
+    const ApplianceModel model{};
+    std::vector<RecipeOp> code;
+    RecipeError error;
+    const char* text = "# warm up\n"
+                       "run 0:10 @50; wait 10s  # then\n"
+                       "\n"
+                       "  press start ;; stop\n"
+                       "at 1m # ; stop\n";
+    const bool compiled = compile(text, model, code, error);
+    expect(compiled, "layout", error.message);
+    const RecipeOpcode opcodes[] = {RecipeOpcode::kRun, RecipeOpcode::kWait, RecipeOpcode::kPress,
+                                    RecipeOpcode::kStop, RecipeOpcode::kAt};
+    const uint16_t lines[] = {2, 2, 4, 4, 5};
+    expect(code.size() == 5, "layout", "comments or separators miscounted");
+    for (size_t i = 0; compiled && i < code.size() && i < 5; ++i) {
+        expect(code[i].opcode == opcodes[i] && code[i].line == lines[i], "layout", "wrong op or line");
+    }
+    expect(compile("", model, code, error) && code.empty(), "empty", "not an empty recipe");
+}
+
+void check_model() {
+    // An oven that sets power in 20% steps, and one that cannot set it at all
+    ApplianceModel fifths{};
+    fifths.power_steps = 5;
+    ApplianceModel fixed{};
+    fixed.power_steps = 0;
+    std::vector<RecipeOp> code;
+    RecipeError error;
+    expect(compile("run 1:00 @40", fifths, code, error), "@40 in 20% steps", "rejected");
+    expect(!compile("run 1:00 @30", fifths, code, error), "@30 in 20% steps", "accepted");
+    expect(compile("run 1:00 @100", fixed, code, error), "@100 without steps", "rejected");
+    expect(!compile("run 1:00 @50", fixed, code, error), "@50 without steps", "accepted");
+}
+
+void check_limits() {
+    const ApplianceModel model{};
+    std::vector<RecipeOp> code;
+    RecipeError error;
+
+    std::string ops;
+    for (int i = 0; i < 4096; ++i) {
+        ops += "stop;";
+    }
+    expect(compile(ops, model, code, error) && code.size() == 4096, "4096 ops", "rejected");
+    ops += "stop";
+    expect(!compile(ops, model, code, error) && error.line == 1 && code.empty(), "4097 ops", "accepted");
+
+    std::string lines(UINT16_MAX, '\n');
+    expect(compile(lines, model, code, error), "65535 lines", "rejected");
+    lines += "\n";
+    expect(!compile(lines, model, code, error) && error.line == UINT16_MAX + 1u, "65536 lines", "accepted");
+}
+
+} // namespace
+
+int main() {
+    check_accepted();
+    check_rejected();
+    check_layout();
+    check_model();
+    check_limits();
+    std::printf("%s (%d mismatches)\n", g_failures ? "FAILED" : "ok", g_failures);
+    return g_failures ? 1 : 0;
+}
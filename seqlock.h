@@ -0,0 +1,76 @@
+//
+// Single-writer sequence lock for publishing small snapshots to any number of
+// readers without blocking either side.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_SEQLOCK_H
+#define MD1001LB_MICROWAVE_CONTROLLER_SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief Publishes copies of a trivially copyable T.
+ *
+ * store() must only be called by one thread at a time; load() may be called
+ * from any thread and retries while a store is in progress. The value is kept
+ * as relaxed atomic words, so a torn read is discarded rather than being a
+ * data race. A load costs a few dozen loads and no locked instructions.
+ *
+ * @tparam T Snapshot type; its size must be a multiple of 4 bytes.
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+    static_assert(sizeof(T) % sizeof(uint32_t) == 0, "Seqlock needs a size that is a multiple of 4");
+
+public:
+    Seqlock() {
+        T empty{};
+        store(empty);
+    }
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    void store(const T& value) {
+        uint32_t raw[kWords];
+        std::memcpy(raw, &value, sizeof(T));
+        uint32_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            words_[i].store(raw[i], std::memory_order_relaxed);
+        }
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint32_t raw[kWords];
+        while (true) {
+            uint32_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < kWords; ++i) {
+                raw[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        T value;
+        std::memcpy(&value, raw, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t kWords = sizeof(T) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<uint32_t> words_[kWords];
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_SEQLOCK_H
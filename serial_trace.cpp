@@ -0,0 +1,458 @@
+//
+// Serial trace file writing and reading.
+//
+
+#include "serial_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'W', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kChunkMagic = 0x4b43574d; // "MWCK"
+constexpr size_t kMaxRecordOverhead = 1 + 10 + 10; // direction and two varints
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunk_size;
+    uint64_t wall_start_us;     // system clock
+    uint64_t index_offset;      // 0 until the writer finished
+    uint32_t index_count;
+    uint8_t reserved[28];
+};
+static_assert(sizeof(FileHeader) == 64, "the first chunk starts at offset 64");
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t used;              // bytes of records after this header
+    uint64_t base_us;           // the first record's delta counts from here
+    uint32_t records;
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkHeader) == 24, "ChunkHeader is part of the file format");
+static_assert(sizeof(TraceChunkEntry) == 32, "TraceChunkEntry is part of the file format");
+
+uint64_t chunk_offset(size_t chunk, uint32_t chunk_size) {
+    return sizeof(FileHeader) + static_cast<uint64_t>(chunk) * chunk_size;
+}
+
+size_t put_varint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes the record at p, advancing p and time_us.
+ */
+bool decode_record(const uint8_t*& p, const uint8_t* end, uint64_t& time_us, TraceRecord& record) {
+    if (p >= end || *p > static_cast<uint8_t>(TraceDirection::kRx)) {
+        return false;
+    }
+    const auto direction = static_cast<TraceDirection>(*p++);
+    uint64_t delta = 0;
+    uint64_t length = 0;
+    if (!get_varint(p, end, delta) || !get_varint(p, end, length) || length > static_cast<uint64_t>(end - p)) {
+        return false;
+    }
+    time_us += delta;
+    record = TraceRecord{time_us, direction, p, static_cast<uint32_t>(length)};
+    p += length;
+    return true;
+}
+
+/**
+ * @brief Mapping offsets must be multiples of this.
+ */
+uint64_t map_granularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+} // namespace
+
+// --- TraceWriter ---
+
+bool TraceWriter::open(const std::string& path, uint64_t now_us) {
+    finish();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file_handle_ = handle;
+#else
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+#endif
+    origin_us_ = now_us;
+    last_us_ = 0;
+    index_.clear();
+    wall_start_us_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.chunk_size = kChunkSize;
+    header.wall_start_us = wall_start_us_;
+    if (!write_at(0, &header, sizeof(header)) || !begin_chunk()) {
+        close_file();
+        return false;
+    }
+    return true;
+}
+
+bool TraceWriter::write_at(uint64_t offset, const void* data, size_t length) {
+#ifdef _WIN32
+    OVERLAPPED at{};
+    at.Offset = static_cast<DWORD>(offset);
+    at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD written = 0;
+    return WriteFile(static_cast<HANDLE>(file_handle_), data, static_cast<DWORD>(length), &written, &at) &&
+           written == length;
+#else
+    return pwrite(fd_, data, length, static_cast<off_t>(offset)) == static_cast<ssize_t>(length);
+#endif
+}
+
+bool TraceWriter::begin_chunk() {
+    const uint64_t offset = chunk_offset(index_.size(), kChunkSize);
+    const uint64_t end = offset + kChunkSize;
+    const uint64_t view_offset = offset - offset % map_granularity();
+    const size_t view_length = static_cast<size_t>(end - view_offset);
+#ifdef _WIN32
+    // Mapping past the end of the file grows it (zero-filled); the view
+    // keeps the mapping alive
+    HANDLE mapping = CreateFileMappingA(static_cast<HANDLE>(file_handle_), nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, static_cast<DWORD>(view_offset >> 32),
+                                         static_cast<DWORD>(view_offset), view_length)
+                         : nullptr;
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (!view) {
+        return false;
+    }
+#else
+    if (ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+        return false;
+    }
+    void* view = mmap(nullptr, view_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, static_cast<off_t>(view_offset));
+    if (view == MAP_FAILED) {
+        return false;
+    }
+#endif
+    view_ = view;
+    view_length_ = view_length;
+    chunk_ = static_cast<uint8_t*>(view) + (offset - view_offset);
+    used_ = 0;
+    ChunkHeader header{kChunkMagic, 0, last_us_, 0, 0};
+    std::memcpy(chunk_, &header, sizeof(header));
+    index_.push_back(TraceChunkEntry{offset, last_us_, last_us_, 0, 0});
+    return true;
+}
+
+void TraceWriter::end_chunk() {
+    if (!chunk_) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(view_);
+#else
+    munmap(view_, view_length_);
+#endif
+    chunk_ = nullptr;
+    view_ = nullptr;
+}
+
+bool TraceWriter::append(TraceDirection direction, uint64_t now_us, const uint8_t* data, size_t length) {
+    if (!chunk_) {
+        return false;
+    }
+    uint64_t time = now_us > origin_us_ ? now_us - origin_us_ : 0;
+    time = std::max(time, last_us_);
+    while (length > 0) {
+        const size_t room = kChunkSize - sizeof(ChunkHeader) - used_;
+        if (room <= kMaxRecordOverhead) {
+            end_chunk();
+            if (!begin_chunk()) {
+                finish();
+                return false;
+            }
+            continue;
+        }
+        // Records never straddle chunks; a long write is split instead
+        const size_t piece = std::min(length, room - kMaxRecordOverhead);
+        uint8_t* const start = chunk_ + sizeof(ChunkHeader) + used_;
+        uint8_t* out = start;
+        *out++ = static_cast<uint8_t>(direction);
+        out += put_varint(out, time - last_us_);
+        out += put_varint(out, piece);
+        std::memcpy(out, data, piece);
+        out += piece;
+
+        used_ += static_cast<uint32_t>(out - start);
+        last_us_ = time;
+        TraceChunkEntry& entry = index_.back();
+        if (entry.records++ == 0) {
+            entry.first_us = time;
+        }
+        entry.last_us = time;
+        entry.bytes = used_;
+        // used goes last, so a reader never sees a record half written
+        auto* header = reinterpret_cast<ChunkHeader*>(chunk_);
+        header->records = entry.records;
+        header->used = used_;
+        data += piece;
+        length -= piece;
+    }
+    return true;
+}
+
+void TraceWriter::finish() {
+#ifdef _WIN32
+    if (!file_handle_) {
+        return;
+    }
+#else
+    if (fd_ < 0) {
+        return;
+    }
+#endif
+    end_chunk();
+    // Cut the unused tail of the last chunk and put the index there
+    const uint64_t index_offset =
+        index_.empty() ? sizeof(FileHeader) : index_.back().offset + sizeof(ChunkHeader) + index_.back().bytes;
+    const size_t index_bytes = index_.size() * sizeof(TraceChunkEntry);
+    bool trimmed = false;
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    size.QuadPart = static_cast<LONGLONG>(index_offset);
+    trimmed = SetFilePointerEx(static_cast<HANDLE>(file_handle_), size, nullptr, FILE_BEGIN) &&
+              SetEndOfFile(static_cast<HANDLE>(file_handle_));
+#else
+    trimmed = ftruncate(fd_, static_cast<off_t>(index_offset)) == 0;
+#endif
+    if (trimmed && write_at(index_offset, index_.data(), index_bytes)) {
+        const uint32_t count = static_cast<uint32_t>(index_.size());
+        // Published last: a reader trusts the index only once this is set
+        write_at(offsetof(FileHeader, index_count), &count, sizeof(count));
+        write_at(offsetof(FileHeader, index_offset), &index_offset, sizeof(index_offset));
+    }
+    close_file();
+}
+
+void TraceWriter::close_file() {
+#ifdef _WIN32
+    CloseHandle(static_cast<HANDLE>(file_handle_));
+    file_handle_ = nullptr;
+#else
+    ::close(fd_);
+    fd_ = -1;
+#endif
+    index_.clear();
+}
+
+// --- TraceReader ---
+
+bool TraceReader::open(const std::string& path, std::string& error) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size{};
+    if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &size)) {
+        if (handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle);
+        }
+        error = "cannot open the file";
+        return false;
+    }
+    file_handle_ = handle;
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ >= sizeof(FileHeader)) {
+        mapping_ = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        file_ = mapping_ ? static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    }
+#else
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info {};
+    if (fd_ < 0 || fstat(fd_, &info) != 0) {
+        close();
+        error = "cannot open the file";
+        return false;
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ >= sizeof(FileHeader)) {
+        void* view = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        file_ = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+    }
+#endif
+    FileHeader header{};
+    if (file_) {
+        std::memcpy(&header, file_, sizeof(header));
+    }
+    if (!file_ || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.chunk_size <= sizeof(ChunkHeader) + kMaxRecordOverhead) {
+        close();
+        error = "not a trace file";
+        return false;
+    }
+    wall_start_us_ = header.wall_start_us;
+
+    const uint64_t index_bytes = uint64_t{header.index_count} * sizeof(TraceChunkEntry);
+    finished_ = header.index_offset != 0 && header.index_offset <= size_ && index_bytes <= size_ - header.index_offset;
+    if (finished_) {
+        index_.resize(header.index_count);
+        std::memcpy(static_cast<void*>(index_.data()), file_ + header.index_offset, index_bytes);
+        for (const TraceChunkEntry& entry : index_) {
+            if (entry.offset > size_ || sizeof(ChunkHeader) + uint64_t{entry.bytes} > size_ - entry.offset) {
+                close();
+                error = "the chunk index points outside the file";
+                return false;
+            }
+        }
+    } else {
+        // Cut short: every chunk but the last is whole, so walk them
+        for (size_t chunk = 0;; ++chunk) {
+            const uint64_t offset = chunk_offset(chunk, header.chunk_size);
+            ChunkHeader chunk_header{};
+            if (offset + sizeof(ChunkHeader) > size_) {
+                break;
+            }
+            std::memcpy(&chunk_header, file_ + offset, sizeof(chunk_header));
+            if (chunk_header.magic != kChunkMagic) {
+                break;
+            }
+            const uint64_t room = std::min<uint64_t>(header.chunk_size, size_ - offset) - sizeof(ChunkHeader);
+            TraceChunkEntry entry{offset, chunk_header.base_us, chunk_header.base_us, 0,
+                                  static_cast<uint32_t>(std::min<uint64_t>(chunk_header.used, room))};
+            const uint8_t* p = file_ + offset + sizeof(ChunkHeader);
+            const uint8_t* end = p + entry.bytes;
+            uint64_t time = chunk_header.base_us;
+            TraceRecord record{};
+            while (decode_record(p, end, time, record)) {
+                if (entry.records++ == 0) {
+                    entry.first_us = time;
+                }
+                entry.last_us = time;
+            }
+            index_.push_back(entry);
+        }
+    }
+    seek(0);
+    return true;
+}
+
+void TraceReader::close() {
+#ifdef _WIN32
+    if (file_) {
+        UnmapViewOfFile(file_);
+    }
+    if (mapping_) {
+        CloseHandle(static_cast<HANDLE>(mapping_));
+    }
+    if (file_handle_) {
+        CloseHandle(static_cast<HANDLE>(file_handle_));
+    }
+    mapping_ = nullptr;
+    file_handle_ = nullptr;
+#else
+    if (file_) {
+        munmap(const_cast<uint8_t*>(file_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+#endif
+    file_ = nullptr;
+    size_ = 0;
+    index_.clear();
+    finished_ = false;
+    cursor_ = end_ = nullptr;
+}
+
+void TraceReader::load_chunk(size_t chunk) {
+    chunk_ = chunk;
+    if (chunk >= index_.size()) {
+        cursor_ = end_ = nullptr;
+        return;
+    }
+    ChunkHeader header{};
+    std::memcpy(&header, file_ + index_[chunk].offset, sizeof(header));
+    cursor_ = file_ + index_[chunk].offset + sizeof(ChunkHeader);
+    end_ = cursor_ + index_[chunk].bytes;
+    time_us_ = header.base_us;
+}
+
+void TraceReader::seek(uint64_t time_us) {
+    auto chunk = std::partition_point(index_.begin(), index_.end(),
+                                      [time_us](const TraceChunkEntry& entry) { return entry.last_us < time_us; });
+    load_chunk(static_cast<size_t>(chunk - index_.begin()));
+    // Decode up to the first record that is due, then step back over it
+    for (;;) {
+        const size_t chunk_before = chunk_;
+        const uint8_t* cursor_before = cursor_;
+        const uint64_t time_before = time_us_;
+        TraceRecord record{};
+        if (!next(record) || record.time_us >= time_us) {
+            chunk_ = chunk_before;
+            cursor_ = cursor_before;
+            end_ = chunk_ < index_.size() ? file_ + index_[chunk_].offset + sizeof(ChunkHeader) + index_[chunk_].bytes
+                                          : nullptr;
+            time_us_ = time_before;
+            return;
+        }
+    }
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    while (chunk_ < index_.size()) {
+        if (cursor_ < end_ && decode_record(cursor_, end_, time_us_, record)) {
+            return true;
+        }
+        load_chunk(chunk_ + 1);
+    }
+    return false;
+}
@@ -0,0 +1,162 @@
+//
+// Append-only binary trace of every byte on a serial link, written through
+// a memory mapping, and a reader for it.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_SERIAL_TRACE_H
+#define MD1001LB_MICROWAVE_CONTROLLER_SERIAL_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TraceDirection : uint8_t {
+    kTx = 0,    // host to board
+    kRx = 1,    // board to host
+};
+
+/**
+ * @brief One decoded record; data points into the reader's mapping.
+ */
+struct TraceRecord {
+    uint64_t time_us;           // since recording started
+    TraceDirection direction;
+    const uint8_t* data;
+    uint32_t length;
+};
+
+/**
+ * @brief Where a chunk is and what it covers, as kept in the index.
+ */
+struct TraceChunkEntry {
+    uint64_t offset;
+    uint64_t first_us;
+    uint64_t last_us;
+    uint32_t records;
+    uint32_t bytes;             // of encoded records
+};
+
+/**
+ * @brief Writes a trace file.
+ *
+ * The file is a 64-byte header followed by fixed-size chunks. A chunk
+ * starts with the time of its first record; each record is a direction
+ * byte, the microseconds since the previous record as a varint, the length
+ * as a varint and the bytes, so a typical serial read costs three bytes of
+ * overhead and every chunk decodes on its own. Chunks are mapped one at a
+ * time and appended with memcpy, so recording makes no system call except
+ * when a chunk fills. finish() appends the chunk index and trims the file;
+ * a trace cut short by a crash is still readable by scanning the chunks.
+ *
+ * Not thread-safe: the owner serializes every call.
+ */
+class TraceWriter {
+public:
+    static constexpr uint32_t kChunkSize = 64 * 1024;
+
+    TraceWriter() = default;
+    ~TraceWriter() { finish(); }
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    /**
+     * @brief Creates (or truncates) path; now_us is the steady clock time
+     *        later records are counted from.
+     */
+    bool open(const std::string& path, uint64_t now_us);
+
+    /**
+     * @brief Records bytes that crossed the link at now_us (steady clock).
+     *
+     * @return false if the file could not grow; the trace is then finished
+     *         as far as it got.
+     */
+    bool append(TraceDirection direction, uint64_t now_us, const uint8_t* data, size_t length);
+
+    /**
+     * @brief Writes the index and closes the file (no-op if not open).
+     */
+    void finish();
+
+    bool is_open() const { return chunk_ != nullptr; }
+
+private:
+    bool begin_chunk();
+    void end_chunk();
+    bool write_at(uint64_t offset, const void* data, size_t length);
+    void close_file();
+
+    uint64_t origin_us_ = 0;
+    uint64_t last_us_ = 0;              // of the previous record, since origin
+    uint8_t* chunk_ = nullptr;          // mapping of the current chunk
+    void* view_ = nullptr;              // ... as mapped, from a page boundary
+    size_t view_length_ = 0;
+    uint32_t used_ = 0;                 // bytes of the current chunk written
+    std::vector<TraceChunkEntry> index_;
+    uint64_t wall_start_us_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/**
+ * @brief Reads a trace file written by TraceWriter, through a read-only
+ *        mapping of the whole file.
+ */
+class TraceReader {
+public:
+    TraceReader() = default;
+    ~TraceReader() { close(); }
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    /**
+     * @brief Maps path and loads its index, rebuilding it from the chunks
+     *        if the writer never finished.
+     *
+     * @param error Receives why the file was rejected.
+     */
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    /**
+     * @brief Positions before the first record at or after time_us, using
+     *        the index to skip whole chunks.
+     */
+    void seek(uint64_t time_us);
+
+    /**
+     * @brief Decodes the next record.
+     *
+     * @return false at the end of the trace.
+     */
+    bool next(TraceRecord& record);
+
+    const std::vector<TraceChunkEntry>& chunks() const { return index_; }
+    bool was_finished() const { return finished_; }
+    uint64_t wall_start_us() const { return wall_start_us_; }   // system clock, for matching field reports
+    uint64_t duration_us() const { return index_.empty() ? 0 : index_.back().last_us; }
+
+private:
+    void load_chunk(size_t chunk);
+
+    const uint8_t* file_ = nullptr;
+    size_t size_ = 0;
+    std::vector<TraceChunkEntry> index_;
+    bool finished_ = false;
+    uint64_t wall_start_us_ = 0;
+    size_t chunk_ = 0;                  // being decoded
+    const uint8_t* cursor_ = nullptr;
+    const uint8_t* end_ = nullptr;
+    uint64_t time_us_ = 0;              // of the previous record in the chunk
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_SERIAL_TRACE_H
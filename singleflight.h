@@ -0,0 +1,110 @@
+//
+// Coalesces identical read-only device queries into one exchange.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_SINGLEFLIGHT_H
+#define MD1001LB_MICROWAVE_CONTROLLER_SINGLEFLIGHT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "virtual_clock.h"
+
+/**
+ * @brief Shares one in-flight or recent result among every caller of a query.
+ *
+ * A caller that arrives while the query is in flight waits for that call and
+ * gets its result. A caller that arrives within the freshness TTL of a
+ * successful call gets the cached result at once. Otherwise the caller runs
+ * the query itself. Results are tagged with an epoch that the owner bumps on
+ * every state-changing command, so nothing issued before a change is reused
+ * after it.
+ */
+class SingleFlight {
+public:
+    SingleFlight() = default;
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    /**
+     * @param epoch The owner's state epoch when the caller arrived.
+     * @param ttl How long a successful result may be reused (0 = only join in-flight calls).
+     * @param reply Receives the shared reply text (may be nullptr).
+     * @param fetch int32_t(std::string& reply): performs the query.
+     *
+     * @return The status of the call whose result was used.
+     */
+    template <typename Fetch>
+    int32_t run(uint32_t epoch, std::chrono::milliseconds ttl, std::string* reply, Fetch&& fetch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            if (in_flight_) {
+                uint64_t generation = generation_;
+                bool same_epoch = in_flight_epoch_ == epoch;
+                cv_.wait(lock, [this, generation]() { return generation_ != generation; });
+                if (same_epoch) {
+                    ++hits_;
+                    return take(reply);
+                }
+                continue; // the state changed since that call started; look again
+            }
+            if (has_result_ && result_epoch_ == epoch && LinkClock::now() - completed_ < ttl) {
+                ++hits_;
+                return take(reply);
+            }
+            break;
+        }
+
+        in_flight_ = true;
+        in_flight_epoch_ = epoch;
+        ++misses_;
+        lock.unlock();
+
+        std::string fresh;
+        int32_t result = fetch(fresh);
+
+        lock.lock();
+        result_ = result;
+        reply_ = std::move(fresh);
+        result_epoch_ = epoch;
+        has_result_ = result == 0;
+        completed_ = LinkClock::now();
+        in_flight_ = false;
+        ++generation_;
+        cv_.notify_all();
+        return take(reply);
+    }
+
+    void stats(uint64_t& hits, uint64_t& misses) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hits = hits_;
+        misses = misses_;
+    }
+
+private:
+    int32_t take(std::string* reply) const {
+        if (reply) {
+            *reply = reply_;
+        }
+        return result_;
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool in_flight_ = false;
+    uint32_t in_flight_epoch_ = 0;
+    uint64_t generation_ = 0;
+
+    bool has_result_ = false;
+    int32_t result_ = 0;
+    std::string reply_;
+    uint32_t result_epoch_ = 0;
+    LinkClock::time_point completed_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_SINGLEFLIGHT_H
@@ -0,0 +1,170 @@
+//
+// Timing wheel implementation.
+//
+
+#include "timing_wheel.h"
+
+#include <bit>
+
+namespace {
+
+constexpr uint64_t kSlotMask = TimingWheel::kSlots - 1;
+
+constexpr unsigned shift_of(unsigned level) {
+    return level * TimingWheel::kSlotBits;
+}
+
+} // namespace
+
+TimingWheel::TimingWheel() = default;
+
+void TimingWheel::link(unsigned level, unsigned slot, TimerNode* node) {
+    // Circular list per slot; prev of the head is the tail
+    node->level = static_cast<uint8_t>(level);
+    node->slot = static_cast<uint8_t>(slot);
+    TimerNode*& head = slots_[level][slot];
+    if (!head) {
+        node->prev = node;
+        node->next = nullptr;
+        head = node;
+        occupied_[level] |= uint64_t{1} << slot;
+        return;
+    }
+    TimerNode* tail = head->prev;
+    tail->next = node;
+    node->prev = tail;
+    node->next = nullptr;
+    head->prev = node;
+}
+
+void TimingWheel::place(TimerNode* node) {
+    // Ticks in the past go to the current slot; ticks beyond the wheel's
+    // reach are parked in the top level's furthest slot
+    uint64_t tick = node->expires < now_ ? now_ : node->expires;
+    const uint64_t horizon = now_ + (uint64_t{1} << shift_of(kLevels)) - 1;
+    if (tick > horizon) {
+        tick = horizon;
+    }
+    unsigned level = 0;
+    while (level + 1 < kLevels && (tick >> shift_of(level + 1)) != (now_ >> shift_of(level + 1))) {
+        ++level;
+    }
+    link(level, static_cast<unsigned>((tick >> shift_of(level)) & kSlotMask), node);
+}
+
+void TimingWheel::schedule(TimerNode* node, uint64_t tick) {
+    cancel(node);
+    node->expires = tick;
+    place(node);
+    ++size_;
+}
+
+void TimingWheel::cancel(TimerNode* node) {
+    if (!node->linked()) {
+        return;
+    }
+    TimerNode*& head = slots_[node->level][node->slot];
+    if (node == head) {
+        head = node->next;
+        if (head) {
+            head->prev = node->prev;
+        } else {
+            occupied_[node->level] &= ~(uint64_t{1} << node->slot);
+        }
+    } else {
+        node->prev->next = node->next;
+        (node->next ? node->next : head)->prev = node->prev;
+    }
+    node->prev = nullptr;
+    node->next = nullptr;
+    --size_;
+}
+
+TimerNode* TimingWheel::take(unsigned level, unsigned slot) {
+    TimerNode* head = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~(uint64_t{1} << slot);
+    return head;
+}
+
+void TimingWheel::cascade(unsigned level) {
+    if (level >= kLevels) {
+        return;
+    }
+    const unsigned slot = static_cast<unsigned>((now_ >> shift_of(level)) & kSlotMask);
+    if (slot == 0) {
+        cascade(level + 1);
+    }
+    TimerNode* node = take(level, slot);
+    while (node) {
+        TimerNode* next = node->next;
+        place(node);
+        node = next;
+    }
+}
+
+TimerNode* TimingWheel::advance(uint64_t now) {
+    if (size_ == 0) {
+        now_ = now > now_ ? now : now_;
+        return nullptr;
+    }
+    TimerNode* expired = nullptr;
+    TimerNode** expired_tail = &expired;
+    for (;;) {
+        TimerNode* node = take(0, static_cast<unsigned>(now_ & kSlotMask));
+        while (node) {
+            TimerNode* next = node->next;
+            if (node->expires > now_) {
+                place(node); // parked beyond the horizon; not due yet
+            } else {
+                node->prev = nullptr;
+                node->next = nullptr;
+                *expired_tail = node;
+                expired_tail = &node->next;
+                --size_;
+            }
+            node = next;
+        }
+        if (now_ >= now) {
+            break;
+        }
+        // Jump to the next occupied slot of this rotation, or to the next
+        // rotation, where the level above cascades
+        const unsigned position = static_cast<unsigned>(now_ & kSlotMask);
+        const uint64_t ahead = position == kSlotMask ? 0 : occupied_[0] & (~uint64_t{0} << (position + 1));
+        const uint64_t next_tick = ahead ? (now_ & ~kSlotMask) + static_cast<uint64_t>(std::countr_zero(ahead))
+                                         : (now_ | kSlotMask) + 1;
+        if (next_tick > now) {
+            now_ = now;
+            continue;
+        }
+        now_ = next_tick;
+        if ((now_ & kSlotMask) == 0) {
+            cascade(1);
+        }
+    }
+    return expired;
+}
+
+uint64_t TimingWheel::next_expiry() const {
+    if (size_ == 0) {
+        return kNever;
+    }
+    uint64_t best = kNever;
+    for (unsigned level = 0; level < kLevels; ++level) {
+        const unsigned shift = shift_of(level);
+        const unsigned position = static_cast<unsigned>((now_ >> shift) & kSlotMask);
+        // Bit k: the slot k steps ahead. Level 0 may hold the current tick;
+        // above it the current slot has already been cascaded.
+        uint64_t ahead = std::rotr(occupied_[level], static_cast<int>(position));
+        if (level > 0) {
+            ahead &= ~uint64_t{1};
+        }
+        if (!ahead) {
+            continue;
+        }
+        const uint64_t tick = ((now_ >> shift) + static_cast<uint64_t>(std::countr_zero(ahead))) << shift;
+        best = tick < best ? tick : best;
+    }
+    return best;
+}
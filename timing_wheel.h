@@ -0,0 +1,93 @@
+//
+// Hierarchical timing wheel for many long-running timers.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_TIMING_WHEEL_H
+#define MD1001LB_MICROWAVE_CONTROLLER_TIMING_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Link fields embedded in every timer; owner is left to the user.
+ */
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;       // tick
+    void* owner = nullptr;
+    uint8_t level = 0;          // where the wheel keeps it, for cancel()
+    uint8_t slot = 0;
+
+    bool linked() const { return prev != nullptr; }
+};
+
+/**
+ * @brief Four levels of 64 slots, each level 64 times coarser than the one
+ *        below (like the Linux kernel's timer wheel).
+ *
+ * schedule() and cancel() are O(1): a node goes into the slot of the
+ * lowest level whose range still covers its tick, and is moved down a
+ * level each time the wheel reaches that slot. advance() skips empty
+ * stretches using a per-level bitmap of occupied slots, so its cost
+ * grows with the timers that expire plus one cascade per 64 ticks of
+ * elapsed time, never with the number of timers pending. Timers further
+ * out than 64^4 ticks are parked in the top level and re-placed when it
+ * reaches them.
+ *
+ * Intrusive and never allocates. Not thread-safe: the owner serializes
+ * every call.
+ */
+class TimingWheel {
+public:
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr unsigned kSlots = 1u << kSlotBits;
+    static constexpr unsigned kLevels = 4;
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    TimingWheel();
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    /**
+     * @brief (Re)schedules node for tick; a tick already passed expires on
+     *        the next advance().
+     */
+    void schedule(TimerNode* node, uint64_t tick);
+
+    /**
+     * @brief Unlinks node if it is scheduled.
+     */
+    void cancel(TimerNode* node);
+
+    /**
+     * @brief Moves the wheel to now and unlinks every node that expired.
+     *
+     * @return The expired nodes, chained through next (nullptr if none).
+     */
+    TimerNode* advance(uint64_t now);
+
+    /**
+     * @brief The earliest tick at which advance() may have work: exact for
+     *        timers on the lowest level, otherwise when a timer's slot
+     *        cascades down a level.
+     *
+     * @return kNever if nothing is scheduled.
+     */
+    uint64_t next_expiry() const;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    void place(TimerNode* node);
+    void link(unsigned level, unsigned slot, TimerNode* node);
+    TimerNode* take(unsigned level, unsigned slot);
+    void cascade(unsigned level);
+
+    TimerNode* slots_[kLevels][kSlots] = {};
+    uint64_t occupied_[kLevels] = {};
+    uint64_t now_ = 0;
+    size_t size_ = 0;
+};
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_TIMING_WHEEL_H
@@ -0,0 +1,405 @@
+//
+// Plays back a serial trace recorded by set_microwave_trace_file or
+// $MD1001LB_TRACE_DIR.
+//
+//   trace_replay <trace> [--fast] [--from <seconds>] dump
+//   trace_replay <trace> [--fast] [--from <seconds>] board
+//   trace_replay <trace> [--fast] [--from <seconds>] [--exact] host [<port>]
+//
+// dump  prints every record.
+// board plays the recorded board on a pty (its path is printed first):
+//       each recorded reply is sent once the host has sent the bytes that
+//       preceded it, so the library can be run against production traffic.
+// host  plays the recorded host against <port>, or against an emulator it
+//       spawns, and compares every reply with the recorded one, so a
+//       firmware change can be measured against production traffic.
+//
+// Gaps are kept as recorded unless --fast is given: then board replies go
+// out at once, and the host sends its next bytes as soon as the recorded
+// number of reply lines is in. --from skips to a time within the trace
+// using its chunk index. Replies are compared with every number masked,
+// since they carry board clocks and serial numbers, unless --exact is
+// given. Exits with 1 if anything differed.
+//
+
+#include "emulator.h"
+#include "serial_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Longest a fast replay waits for the recorded reply lines
+constexpr int kFastReplyTimeoutMs = 2000;
+// Longest the board waits for the host's next bytes
+constexpr int kHostQuietTimeoutMs = 30000;
+
+/**
+ * @brief Bytes the host sent and what the board answered until the host
+ *        sent again.
+ */
+struct Exchange {
+    uint64_t tx_us = 0;
+    std::string tx;                                     // empty for output before the first send
+    std::vector<std::pair<uint64_t, std::string>> rx;   // with when each read arrived
+    size_t reply_lines = 0;
+    int64_t latency_us = -1;                            // to the first complete reply line
+};
+
+std::vector<Exchange> load_exchanges(TraceReader& reader) {
+    std::vector<Exchange> exchanges;
+    TraceRecord record{};
+    while (reader.next(record)) {
+        const std::string bytes(reinterpret_cast<const char*>(record.data), record.length);
+        if (record.direction == TraceDirection::kTx || exchanges.empty()) {
+            exchanges.emplace_back();
+            exchanges.back().tx_us = record.time_us;
+        }
+        Exchange& exchange = exchanges.back();
+        if (record.direction == TraceDirection::kTx) {
+            exchange.tx = bytes;
+            continue;
+        }
+        if (exchange.latency_us < 0 && !exchange.tx.empty() && bytes.find('\n') != std::string::npos) {
+            exchange.latency_us = static_cast<int64_t>(record.time_us - exchange.tx_us);
+        }
+        exchange.reply_lines += static_cast<size_t>(std::count(bytes.begin(), bytes.end(), '\n'));
+        exchange.rx.emplace_back(record.time_us, bytes);
+    }
+    return exchanges;
+}
+
+std::string joined_rx(const Exchange& exchange) {
+    std::string text;
+    for (const auto& piece : exchange.rx) {
+        text += piece.second;
+    }
+    return text;
+}
+
+std::string escaped(const std::string& bytes) {
+    std::string text;
+    for (unsigned char c : bytes) {
+        if (c == '\n') {
+            text += "\\n";
+        } else if (c == '\r') {
+            text += "\\r";
+        } else if (c < 0x20 || c >= 0x7f) {
+            char hex[5];
+            std::snprintf(hex, sizeof(hex), "\\x%02x", c);
+            text += hex;
+        } else {
+            text += static_cast<char>(c);
+        }
+    }
+    return text;
+}
+
+/**
+ * @brief The text with every run of digits replaced by '#'.
+ */
+std::string masked(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        const bool digit = c >= '0' && c <= '9';
+        if (!digit) {
+            out += c;
+        } else if (out.empty() || out.back() != '#') {
+            out += '#';
+        }
+    }
+    return out;
+}
+
+int64_t elapsed_us(Clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count();
+}
+
+/**
+ * @brief Reads whatever arrives within timeout_ms (-1 = until something does).
+ */
+bool read_some(int fd, std::string& out, int timeout_ms) {
+    pollfd p{fd, POLLIN, 0};
+    if (poll(&p, 1, timeout_ms) <= 0) {
+        return false;
+    }
+    char buffer[512];
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) {
+        return false;
+    }
+    out.append(buffer, static_cast<size_t>(n));
+    return true;
+}
+
+bool write_all(int fd, const std::string& bytes) {
+    size_t done = 0;
+    while (done < bytes.size()) {
+        ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+        if (n < 0) {
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void print_percentiles(const char* label, std::vector<int64_t> values) {
+    if (values.empty()) {
+        std::printf("%-22s: no replies\n", label);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&](double q) { return values[static_cast<size_t>(q * static_cast<double>(values.size() - 1))] / 1000.0; };
+    std::printf("%-22s: p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms\n", label, at(0.5), at(0.9), at(0.99),
+                values.back() / 1000.0);
+}
+
+int dump(TraceReader& reader) {
+    TraceRecord record{};
+    while (reader.next(record)) {
+        std::printf("%12.6f %s %4u %s\n", static_cast<double>(record.time_us) / 1e6,
+                    record.direction == TraceDirection::kTx ? "tx" : "rx", record.length,
+                    escaped(std::string(reinterpret_cast<const char*>(record.data), record.length)).c_str());
+    }
+    return 0;
+}
+
+int play_board(const std::vector<Exchange>& exchanges, bool fast) {
+    std::string slave_path;
+    int master = emulator_open_pty(slave_path);
+    if (master < 0) {
+        std::fprintf(stderr, "Failed to create pseudo terminal\n");
+        return 2;
+    }
+    std::printf("%s\n", slave_path.c_str());
+    std::fflush(stdout);
+
+    size_t mismatched = 0;
+    int64_t worst_late_us = 0;
+    std::string pending; // host bytes read ahead of the exchange they belong to
+    for (const Exchange& exchange : exchanges) {
+        while (pending.size() < exchange.tx.size()) {
+            if (!read_some(master, pending, kHostQuietTimeoutMs)) {
+                std::fprintf(stderr, "Host went quiet at %.3f s\n", exchange.tx_us / 1e6);
+                return 1;
+            }
+        }
+        const Clock::time_point sent = Clock::now();
+        if (pending.compare(0, exchange.tx.size(), exchange.tx) != 0) {
+            if (++mismatched <= 5) {
+                std::printf("host sent   %s\nrecorded    %s\n", escaped(pending.substr(0, exchange.tx.size())).c_str(),
+                            escaped(exchange.tx).c_str());
+            }
+        }
+        pending.erase(0, exchange.tx.size());
+        for (const auto& [time_us, bytes] : exchange.rx) {
+            if (!fast) {
+                const auto due = sent + std::chrono::microseconds(time_us - exchange.tx_us);
+                std::this_thread::sleep_until(due);
+                worst_late_us = std::max<int64_t>(worst_late_us, elapsed_us(due));
+            }
+            if (!write_all(master, bytes)) {
+                std::fprintf(stderr, "Write to the host failed\n");
+                return 1;
+            }
+        }
+    }
+    // Stay up until the host is done, so it reads the last reply
+    while (read_some(master, pending, 1000)) {
+    }
+    std::printf("exchanges             : %zu (%zu where the host sent something else)\n", exchanges.size(),
+                mismatched);
+    if (!pending.empty()) {
+        std::printf("after the recording   : host sent %s\n", escaped(pending).c_str());
+    }
+    if (!fast) {
+        std::printf("latest reply          : %.2f ms behind the recording\n", worst_late_us / 1000.0);
+    }
+    return mismatched == 0 ? 0 : 1;
+}
+
+int open_port(const char* path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    termios tio{};
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+int play_host(std::vector<Exchange>& exchanges, bool fast, bool exact, const char* port) {
+    pid_t emulator = -1;
+    std::string path = port ? port : "";
+    if (!port) {
+        int master = emulator_open_pty(path);
+        if (master < 0) {
+            std::fprintf(stderr, "Failed to create pseudo terminal\n");
+            return 2;
+        }
+        emulator = fork();
+        if (emulator == 0) {
+            emulator_run(master);
+        }
+        close(master);
+    }
+    int fd = open_port(path.c_str());
+    if (fd < 0) {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return 2;
+    }
+    // Let the board finish its banner
+    std::string banner;
+    while (read_some(fd, banner, 300)) {
+    }
+
+    const uint64_t first_tx_us = exchanges.empty() ? 0 : exchanges.front().tx_us;
+    const Clock::time_point start = Clock::now();
+    std::vector<std::string> replies(exchanges.size());
+    std::vector<int64_t> recorded_latency;
+    std::vector<int64_t> replayed_latency;
+    for (size_t i = 0; i < exchanges.size(); ++i) {
+        Exchange& exchange = exchanges[i];
+        if (exchange.tx.empty()) {
+            continue; // board output from before the recording's first send
+        }
+        if (!fast) {
+            // Replies still coming in until then belong to the previous send
+            const auto due = start + std::chrono::microseconds(exchange.tx_us - first_tx_us);
+            std::string& late = i > 0 ? replies[i - 1] : banner;
+            for (auto now = Clock::now(); now < due; now = Clock::now()) {
+                read_some(fd, late, static_cast<int>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count()));
+            }
+        }
+        const Clock::time_point sent = Clock::now();
+        if (!write_all(fd, exchange.tx)) {
+            std::fprintf(stderr, "Write to %s failed\n", path.c_str());
+            return 2;
+        }
+        int64_t latency_us = -1;
+        std::string& reply = replies[i];
+        // Collect the recorded number of lines; in real time, the rest comes in
+        // while waiting for the next send
+        while (static_cast<size_t>(std::count(reply.begin(), reply.end(), '\n')) < exchange.reply_lines) {
+            const int64_t left_ms = kFastReplyTimeoutMs - elapsed_us(sent) / 1000;
+            if (left_ms <= 0 || !read_some(fd, reply, static_cast<int>(left_ms))) {
+                break;
+            }
+            if (latency_us < 0 && reply.find('\n') != std::string::npos) {
+                latency_us = elapsed_us(sent);
+            }
+        }
+        if (exchange.latency_us >= 0 && latency_us >= 0) {
+            recorded_latency.push_back(exchange.latency_us);
+            replayed_latency.push_back(latency_us);
+        }
+    }
+    const double wall_s = static_cast<double>(elapsed_us(start)) / 1e6;
+
+    size_t compared = 0;
+    size_t differing = 0;
+    for (size_t i = 0; i < exchanges.size(); ++i) {
+        if (exchanges[i].tx.empty()) {
+            continue;
+        }
+        ++compared;
+        const std::string recorded = joined_rx(exchanges[i]);
+        const bool same = exact ? recorded == replies[i] : masked(recorded) == masked(replies[i]);
+        if (!same && ++differing <= 5) {
+            std::printf("sent      %s\nrecorded  %s\nreplayed  %s\n", escaped(exchanges[i].tx).c_str(),
+                        escaped(recorded).c_str(), escaped(replies[i]).c_str());
+        }
+    }
+    close(fd);
+    if (emulator > 0) {
+        kill(emulator, SIGKILL);
+        waitpid(emulator, nullptr, 0);
+    }
+
+    uint64_t last_us = first_tx_us;
+    if (!exchanges.empty()) {
+        last_us = exchanges.back().rx.empty() ? exchanges.back().tx_us : exchanges.back().rx.back().first;
+    }
+    const double recorded_s = static_cast<double>(last_us - first_tx_us) / 1e6;
+    std::printf("exchanges             : %zu (%zu with different replies)\n", compared, differing);
+    std::printf("duration              : %.3f s (recorded %.3f s)\n", wall_s, recorded_s);
+    print_percentiles("recorded reply latency", recorded_latency);
+    print_percentiles("replayed reply latency", replayed_latency);
+    return differing == 0 ? 0 : 1;
+}
+
+int usage() {
+    std::fprintf(stderr, "usage: trace_replay <trace> [--fast] [--from <seconds>] [--exact] dump | board | host [<port>]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        return usage();
+    }
+    bool fast = false;
+    bool exact = false;
+    double from_s = 0;
+    int arg = 2;
+    for (; arg < argc && std::strncmp(argv[arg], "--", 2) == 0; ++arg) {
+        if (std::strcmp(argv[arg], "--fast") == 0) {
+            fast = true;
+        } else if (std::strcmp(argv[arg], "--exact") == 0) {
+            exact = true;
+        } else if (std::strcmp(argv[arg], "--from") == 0 && arg + 1 < argc) {
+            from_s = std::atof(argv[++arg]);
+        } else {
+            return usage();
+        }
+    }
+    if (arg >= argc) {
+        return usage();
+    }
+    const std::string mode = argv[arg];
+
+    TraceReader reader;
+    std::string error;
+    if (!reader.open(argv[1], error)) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 2;
+    }
+    std::fprintf(stderr, "%s: %.3f s in %zu chunks%s\n", argv[1], reader.duration_us() / 1e6, reader.chunks().size(),
+                 reader.was_finished() ? "" : " (not finished; index rebuilt)");
+    reader.seek(static_cast<uint64_t>(from_s * 1e6));
+
+    if (mode == "dump") {
+        return dump(reader);
+    }
+    std::vector<Exchange> exchanges = load_exchanges(reader);
+    if (mode == "board") {
+        return play_board(exchanges, fast);
+    }
+    if (mode == "host") {
+        return play_host(exchanges, fast, exact, arg + 1 < argc ? argv[arg + 1] : nullptr);
+    }
+    return usage();
+}
@@ -0,0 +1,240 @@
+//
+// LinkClock and the virtual clock file.
+//
+
+#include "virtual_clock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr uint64_t kMagic = 0x314b434f4c435755; // "UWCLOCK1"
+constexpr int kSlots = 64;
+constexpr int64_t kBusy = std::numeric_limits<int64_t>::min();
+constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+/**
+ * @brief The clock file, mapped by every process sharing it. All-zero is
+ *        a valid empty clock, so a new file needs no initialisation
+ *        beyond its magic.
+ */
+struct SharedClock {
+    std::atomic<uint64_t> magic;
+    std::atomic<int64_t> skipped_ns;        // virtual time minus steady time
+    struct Slot {
+        std::atomic<int64_t> pid;           // owner, 0 = free, -1 = being claimed
+        std::atomic<int64_t> idle_until_ns; // virtual; kBusy, or kNoDeadline
+    } slots[kSlots];
+};
+static_assert(std::atomic<int64_t>::is_always_lock_free, "the clock is shared between processes");
+
+std::atomic<SharedClock*> g_clock{nullptr};
+std::mutex g_attach_mutex;
+std::string g_path;
+
+int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t own_pid() {
+#ifdef _WIN32
+    return static_cast<int64_t>(GetCurrentProcessId());
+#else
+    return static_cast<int64_t>(::getpid());
+#endif
+}
+
+bool process_alive(int64_t pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, static_cast<DWORD>(pid));
+    if (!process) {
+        return false;
+    }
+    DWORD code = 0;
+    const bool alive = GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+}
+
+SharedClock* map_clock(const char* path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    // Mapping past the end of the file grows it, zero-filled
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, sizeof(SharedClock), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(SharedClock)) : nullptr;
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return static_cast<SharedClock*>(view);
+#else
+    const int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    if (size < static_cast<off_t>(sizeof(SharedClock)) && ::ftruncate(fd, sizeof(SharedClock)) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* view = ::mmap(nullptr, sizeof(SharedClock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    return view == MAP_FAILED ? nullptr : static_cast<SharedClock*>(view);
+#endif
+}
+
+void unmap_clock(SharedClock* clock) {
+#ifdef _WIN32
+    UnmapViewOfFile(clock);
+#else
+    ::munmap(clock, sizeof(SharedClock));
+#endif
+}
+
+} // namespace
+
+LinkClock::time_point LinkClock::now() noexcept {
+    const SharedClock* clock = g_clock.load(std::memory_order_acquire);
+    const int64_t skipped = clock ? clock->skipped_ns.load(std::memory_order_acquire) : 0;
+    return time_point(duration(steady_ns() + skipped));
+}
+
+LinkClock::duration LinkWaitTraits::to_wait_duration(const LinkClock::duration& d) {
+    if (g_clock.load(std::memory_order_relaxed)) {
+        return std::min<LinkClock::duration>(d, kVirtualPoll);
+    }
+    return d;
+}
+
+bool attach_virtual_clock(const char* path) {
+    if (!path || !*path) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_attach_mutex);
+    if (g_clock.load()) {
+        return g_path == path;
+    }
+    SharedClock* clock = map_clock(path);
+    if (!clock) {
+        return false;
+    }
+    uint64_t magic = 0;
+    if (!clock->magic.compare_exchange_strong(magic, kMagic) && magic != kMagic) {
+        unmap_clock(clock);
+        return false;
+    }
+    g_path = path;
+    g_clock.store(clock, std::memory_order_release);
+    return true;
+}
+
+bool virtual_clock_attached() {
+    return g_clock.load(std::memory_order_acquire) != nullptr;
+}
+
+int join_virtual_clock() {
+    SharedClock* clock = g_clock.load(std::memory_order_acquire);
+    if (!clock) {
+        return -1;
+    }
+    for (int i = 0; i < kSlots; ++i) {
+        SharedClock::Slot& slot = clock->slots[i];
+        int64_t owner = slot.pid.load();
+        if (owner > 0 && !process_alive(owner)) {
+            slot.pid.compare_exchange_strong(owner, 0); // left behind by a process that died
+            owner = slot.pid.load();
+        }
+        if (owner == 0 && slot.pid.compare_exchange_strong(owner, -1)) {
+            slot.idle_until_ns.store(kBusy);
+            slot.pid.store(own_pid());
+            return i;
+        }
+    }
+    return -1;
+}
+
+void leave_virtual_clock(int slot) {
+    if (SharedClock* clock = g_clock.load(std::memory_order_acquire); clock && slot >= 0 && slot < kSlots) {
+        clock->slots[slot].idle_until_ns.store(kBusy);
+        clock->slots[slot].pid.store(0);
+    }
+}
+
+void virtual_clock_idle(int slot, LinkClock::time_point deadline) {
+    if (SharedClock* clock = g_clock.load(std::memory_order_acquire); clock && slot >= 0 && slot < kSlots) {
+        const int64_t ns = deadline == LinkClock::time_point::max() ? kNoDeadline
+                                                                     : deadline.time_since_epoch().count();
+        clock->slots[slot].idle_until_ns.store(std::max(ns, kBusy + 1));
+    }
+}
+
+void virtual_clock_busy(int slot) {
+    if (SharedClock* clock = g_clock.load(std::memory_order_acquire); clock && slot >= 0 && slot < kSlots) {
+        clock->slots[slot].idle_until_ns.store(kBusy);
+    }
+}
+
+bool advance_virtual_clock() {
+    SharedClock* clock = g_clock.load(std::memory_order_acquire);
+    if (!clock) {
+        return false;
+    }
+    int64_t skipped = clock->skipped_ns.load();
+    int64_t earliest = kNoDeadline;
+    const int64_t self = own_pid();
+    for (SharedClock::Slot& slot : clock->slots) {
+        int64_t owner = slot.pid.load();
+        if (owner == 0) {
+            continue;
+        }
+        if (owner < 0) {
+            return false; // being claimed: it starts busy
+        }
+        if (owner != self && !process_alive(owner)) {
+            slot.pid.compare_exchange_strong(owner, 0); // its last state no longer holds
+            continue;
+        }
+        const int64_t until = slot.idle_until_ns.load();
+        if (until == kBusy) {
+            return false;
+        }
+        earliest = std::min(earliest, until);
+    }
+    const int64_t now = steady_ns() + skipped;
+    if (earliest == kNoDeadline || earliest <= now) {
+        return false;
+    }
+    // Another process may have jumped meanwhile; then its jump stands
+    if (!clock->skipped_ns.compare_exchange_strong(skipped, skipped + (earliest - now))) {
+        return false;
+    }
+    return true;
+}
+
+LinkClock::duration virtual_clock_skipped() {
+    const SharedClock* clock = g_clock.load(std::memory_order_acquire);
+    return LinkClock::duration(clock ? clock->skipped_ns.load() : 0);
+}
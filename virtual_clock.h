@@ -0,0 +1,95 @@
+//
+// The clock shared by the library, the emulator and the native firmware
+// build, with an optional discrete-event virtual mode.
+//
+#ifndef MD1001LB_MICROWAVE_CONTROLLER_VIRTUAL_CLOCK_H
+#define MD1001LB_MICROWAVE_CONTROLLER_VIRTUAL_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Steady time, plus whatever the virtual clock has skipped.
+ *
+ * Until a process attaches a virtual clock this is std::chrono::steady_clock
+ * (CLOCK_MONOTONIC, so readings agree across processes). Once attached,
+ * every process sharing the clock file reads the same virtual time: real
+ * time keeps flowing, and whenever every participant is idle the clock
+ * jumps to the earliest deadline any of them waits for. Nothing scheduled
+ * is ever skipped over, so events keep their order and every duration
+ * measured on this clock is what it would have been in real time, minus
+ * the idle stretches.
+ */
+struct LinkClock {
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<LinkClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept;
+};
+
+/**
+ * @brief asio wait traits for LinkClock timers.
+ *
+ * In virtual time the reactor is never told to sleep more than
+ * kVirtualPoll of real time, so timers notice a jump promptly.
+ */
+struct LinkWaitTraits {
+    static constexpr std::chrono::milliseconds kVirtualPoll{1};
+
+    static LinkClock::duration to_wait_duration(const LinkClock::duration& d);
+    static LinkClock::duration to_wait_duration(const LinkClock::time_point& t) {
+        return to_wait_duration(t - LinkClock::now());
+    }
+};
+
+/**
+ * @brief Maps the virtual clock kept in path (created if missing) and
+ *        makes LinkClock follow it. Attaching again to the same path is a
+ *        no-op.
+ *
+ * @return false if the file cannot be mapped, is not a clock file, another
+ *         clock is already attached, or the platform has no virtual clock.
+ */
+bool attach_virtual_clock(const char* path);
+
+bool virtual_clock_attached();
+
+/**
+ * @brief Takes a participant slot in the attached clock; the slot starts
+ *        busy. Slots of processes that have exited are reclaimed.
+ *
+ * @return The slot, or -1 if no clock is attached or every slot is taken.
+ */
+int join_virtual_clock();
+
+void leave_virtual_clock(int slot);
+
+/**
+ * @brief Declares the participant idle until deadline (time_point::max()
+ *        for no deadline of its own): nothing will happen on its side
+ *        before then unless another participant acts first.
+ */
+void virtual_clock_idle(int slot, LinkClock::time_point deadline);
+
+/**
+ * @brief Declares the participant busy: the clock must run in real time.
+ */
+void virtual_clock_busy(int slot);
+
+/**
+ * @brief Jumps the clock to the earliest deadline if every participant is
+ *        idle and that deadline is still ahead.
+ *
+ * @return true if the clock jumped.
+ */
+bool advance_virtual_clock();
+
+/**
+ * @brief Real time the clock has skipped so far (0 unless attached).
+ */
+LinkClock::duration virtual_clock_skipped();
+
+#endif //MD1001LB_MICROWAVE_CONTROLLER_VIRTUAL_CLOCK_H
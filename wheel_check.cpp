@@ -0,0 +1,216 @@
+//
+// Checks the timing wheel's schedule, cancel and expiry order.
+//
+// Fixed cases put timers on either side of every level's rotation boundary
+// and past the wheel's horizon and step the wheel one tick at a time; a
+// seeded random run then schedules, reschedules and cancels timers at every
+// level while the wheel jumps ahead by all kinds of steps, against a plain
+// list of what should be pending. Each advance() must return exactly the
+// timers that are due, in tick order (first scheduled first within a tick,
+// checked in the fixed cases), and next_expiry() must never be later than
+// the earliest pending timer.
+//
+//   wheel_check
+//
+// Exits 1 on any mismatch.
+//
+
+#include "timing_wheel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t kLevel1 = uint64_t{1} << TimingWheel::kSlotBits;
+constexpr uint64_t kLevel2 = kLevel1 << TimingWheel::kSlotBits;
+constexpr uint64_t kLevel3 = kLevel2 << TimingWheel::kSlotBits;
+constexpr uint64_t kHorizon = kLevel3 << TimingWheel::kSlotBits;
+
+int g_failures = 0;
+
+void expect(bool ok, const char* what, uint64_t at) {
+    if (!ok) {
+        ++g_failures;
+        std::printf("  FAIL at tick %llu: %s\n", static_cast<unsigned long long>(at), what);
+    }
+}
+
+/**
+ * @brief Collects an advance() chain as node indices.
+ */
+std::vector<size_t> expired(TimerNode* chain, const std::vector<TimerNode>& nodes) {
+    std::vector<size_t> out;
+    for (TimerNode* node = chain; node; node = node->next) {
+        out.push_back(static_cast<size_t>(node - nodes.data()));
+    }
+    return out;
+}
+
+void check_boundaries() {
+    const uint64_t ticks[] = {0,           1,           kLevel1 - 1, kLevel1,     kLevel1 + 1,
+                              kLevel2 - 1, kLevel2,     kLevel2 + 1, kLevel3 - 1, kLevel3,
+                              kLevel3 + 1, kHorizon - 1, kHorizon,   kHorizon + 1, 2 * kHorizon + 5};
+    const size_t count = sizeof(ticks) / sizeof(ticks[0]);
+    std::vector<TimerNode> nodes(count);
+    TimingWheel wheel;
+    for (size_t i = 0; i < count; ++i) {
+        wheel.schedule(&nodes[i], ticks[i]);
+    }
+    expect(wheel.size() == count, "size after scheduling", 0);
+
+    // One tick at a time near each boundary, in jumps between them
+    size_t next = 0;
+    uint64_t now = 0;
+    while (next < count) {
+        const uint64_t due = ticks[next];
+        const uint64_t from = due > 2 ? due - 2 : 0;
+        if (now < from) {
+            expect(wheel.advance(from - 1) == nullptr || from == 0, "expired early", from - 1);
+            now = from;
+        }
+        for (; now <= due + 1; ++now) {
+            std::vector<size_t> got = expired(wheel.advance(now), nodes);
+            std::vector<size_t> want;
+            while (next < count && ticks[next] == now) {
+                want.push_back(next++);
+            }
+            expect(got == want, "wrong timers at a boundary", now);
+            expect(next == count || wheel.next_expiry() <= ticks[next], "next_expiry past a pending timer", now);
+        }
+    }
+    expect(wheel.empty() && wheel.next_expiry() == TimingWheel::kNever, "timers left over", now);
+}
+
+void check_cancel_and_order() {
+    std::vector<TimerNode> nodes(8);
+    TimingWheel wheel;
+
+    // Cancelled on every level (and twice): never expires
+    const uint64_t ticks[] = {3, kLevel1 + 3, kLevel2 + 3, kLevel3 + 3, kHorizon + 3};
+    for (size_t i = 0; i < 5; ++i) {
+        wheel.schedule(&nodes[i], ticks[i]);
+        wheel.cancel(&nodes[i]);
+        wheel.cancel(&nodes[i]);
+        expect(!nodes[i].linked(), "still linked after cancel", ticks[i]);
+    }
+    expect(wheel.empty() && wheel.next_expiry() == TimingWheel::kNever, "cancelled timers counted", 0);
+    expect(wheel.advance(2 * kHorizon) == nullptr, "cancelled timer expired", 2 * kHorizon);
+
+    // Same tick, from different levels after cascading: first scheduled first
+    const uint64_t base = 2 * kHorizon;
+    const uint64_t due = base + kLevel2 + 7;
+    wheel.schedule(&nodes[0], due);
+    wheel.advance(base + kLevel2 - 1);   // on the lower levels now
+    wheel.schedule(&nodes[1], due);
+    wheel.schedule(&nodes[2], due);
+    wheel.advance(due - 1);
+    wheel.schedule(&nodes[3], due);
+    std::vector<size_t> got = expired(wheel.advance(due), nodes);
+    expect(got == std::vector<size_t>({0, 1, 2, 3}), "same-tick timers out of order", due);
+
+    // Rescheduling moves a timer, both later and earlier
+    wheel.schedule(&nodes[4], due + kLevel1 * 3);
+    wheel.schedule(&nodes[4], due + 10);
+    wheel.schedule(&nodes[5], due + 5);
+    wheel.schedule(&nodes[5], due + kLevel2 * 2);
+    expect(wheel.size() == 2, "a rescheduled timer counted twice", due);
+    got = expired(wheel.advance(due + kLevel1 * 3), nodes);
+    expect(got == std::vector<size_t>({4}), "rescheduled earlier timer", due + kLevel1 * 3);
+    got = expired(wheel.advance(due + kLevel2 * 2), nodes);
+    expect(got == std::vector<size_t>({5}), "rescheduled later timer", due + kLevel2 * 2);
+
+    // A tick already passed expires on the next advance, without time moving
+    const uint64_t now = due + kLevel2 * 2;
+    wheel.schedule(&nodes[6], now - 100);
+    wheel.schedule(&nodes[7], now);
+    got = expired(wheel.advance(now), nodes);
+    expect(got == std::vector<size_t>({6, 7}), "past timers not expired at once", now);
+}
+
+void check_random() {
+    std::mt19937_64 random(20261018);
+    constexpr size_t kNodes = 2000;
+    std::vector<TimerNode> nodes(kNodes);
+    std::vector<uint64_t> due(kNodes, 0); // a tick already passed is due at once
+    TimingWheel wheel;
+    uint64_t now = 0;
+
+    auto random_tick = [&]() {
+        const uint64_t spans[] = {kLevel1, kLevel2, kLevel3, kHorizon, 3 * kHorizon};
+        const uint64_t span = spans[random() % 5];
+        return now + random() % span - (random() % 8 == 0 ? std::min<uint64_t>(now, 10) : 0);
+    };
+    auto random_step = [&]() -> uint64_t {
+        switch (random() % 6) {
+        case 0:
+            return 1;
+        case 1:
+            return random() % kLevel1;
+        case 2:
+            return kLevel1 - now % kLevel1; // onto a level 1 boundary
+        case 3:
+            return kLevel2 - now % kLevel2;
+        case 4:
+            return random() % kLevel3;
+        default:
+            return random() % (2 * kHorizon);
+        }
+    };
+
+    for (int round = 0; round < 3000 && g_failures == 0; ++round) {
+        for (int n = 0; n < 8; ++n) {
+            TimerNode* node = &nodes[random() % kNodes];
+            if (random() % 4 == 0) {
+                wheel.cancel(node);
+            } else {
+                const uint64_t tick = random_tick();
+                wheel.schedule(node, tick);
+                due[static_cast<size_t>(node - nodes.data())] = std::max(tick, now);
+            }
+        }
+        size_t pending = 0;
+        uint64_t earliest = TimingWheel::kNever;
+        for (const TimerNode& node : nodes) {
+            if (node.linked()) {
+                ++pending;
+                earliest = std::min(earliest, node.expires);
+            }
+        }
+        expect(wheel.size() == pending, "size disagrees with the timers linked", now);
+        expect(wheel.next_expiry() <= std::max(earliest, now) || earliest == TimingWheel::kNever,
+               "next_expiry past a pending timer", now);
+
+        now += random_step();
+        std::vector<size_t> want;
+        for (size_t i = 0; i < kNodes; ++i) {
+            if (nodes[i].linked() && nodes[i].expires <= now) {
+                want.push_back(i);
+            }
+        }
+        std::vector<size_t> got = expired(wheel.advance(now), nodes);
+        std::vector<size_t> got_sorted = got;
+        std::sort(got_sorted.begin(), got_sorted.end());
+        expect(got_sorted == want, "expired the wrong timers", now);
+        bool ascending = true;
+        for (size_t i = 1; i < got.size(); ++i) {
+            ascending = ascending && due[got[i - 1]] <= due[got[i]];
+        }
+        expect(ascending, "expired out of tick order", now);
+        for (size_t i : got) {
+            expect(!nodes[i].linked(), "expired timer still linked", now);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    check_boundaries();
+    check_cancel_and_order();
+    check_random();
+    std::printf("%s (%d mismatches)\n", g_failures ? "FAILED" : "ok", g_failures);
+    return g_failures ? 1 : 0;
+}